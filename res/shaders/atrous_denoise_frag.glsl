@@ -0,0 +1,108 @@
+#version 440
+in vec2 texCoord;
+out vec4 FragColor;
+
+uniform sampler2D uInput;          // indirect diffuse.rgb + ambient occlusion
+uniform sampler2D gBufferDepth;
+uniform sampler2D gBufferNormal;   // octahedral normal.xy + metallic + smoothness
+uniform mat4 uInverseViewProj;     // of the prepass, for the world positions
+uniform int uStepWidth;            // distance between kernel taps, 2^iteration
+uniform float uSigmaNormal;
+uniform float uSigmaPosition;
+uniform float uSigmaLuminance;
+
+/*
+    One iteration of an edge avoiding a-trous wavelet filter (Dammertz et al. 2010),
+    with the luminance edge-stopping function scaled by the local standard deviation as in SVGF.
+    There is no temporal accumulation, so the variance is estimated spatially from a 3x3 window.
+*/
+
+const float KERNEL[3] = float[](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0); // 1D B3 spline
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv, float depth) {
+    vec4 pos = uInverseViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return pos.xyz / pos.w;
+}
+
+bool isSky(float depth) {
+    return depth >= 1.0;
+}
+
+vec3 positionAt(ivec2 p, float depth, ivec2 size) {
+    return reconstructPosition((vec2(p) + 0.5) / vec2(size), depth);
+}
+
+float localLuminanceVariance(ivec2 p, ivec2 size) {
+    const float gaussian[2] = float[](0.25, 0.125);
+    float sum = 0.0;
+    float sumSq = 0.0;
+    float weightSum = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            ivec2 q = clamp(p + ivec2(x, y), ivec2(0), size - 1);
+            float w = gaussian[abs(x)] * gaussian[abs(y)];
+            float l = luminance(texelFetch(uInput, q, 0).rgb);
+            sum += l * w;
+            sumSq += l * l * w;
+            weightSum += w;
+        }
+    }
+    float mean = sum / weightSum;
+    return max(sumSq / weightSum - mean * mean, 0.0);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(uInput, 0);
+
+    vec4 centre = texelFetch(uInput, p, 0);
+    float depth = texelFetch(gBufferDepth, p, 0).r;
+    if (isSky(depth)) { FragColor = centre; return; }
+    vec3 normal = octDecode(texelFetch(gBufferNormal, p, 0).xy);
+    vec3 position = positionAt(p, depth, size);
+
+    float centreLum = luminance(centre.rgb);
+    float lumPhi = uSigmaLuminance * sqrt(localLuminanceVariance(p, size)) + 1e-4;
+    float posPhi = uSigmaPosition * uSigmaPosition * float(uStepWidth);
+
+    float weightSum = KERNEL[0] * KERNEL[0];
+    vec4 sum = centre * weightSum;
+
+    for (int y = -2; y <= 2; ++y) {
+        for (int x = -2; x <= 2; ++x) {
+            if (x == 0 && y == 0) continue;
+            ivec2 q = p + ivec2(x, y) * uStepWidth;
+            if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) continue;
+
+            float sampleDepth = texelFetch(gBufferDepth, q, 0).r;
+            if (isSky(sampleDepth)) continue;
+            vec3 sampleNormal = octDecode(texelFetch(gBufferNormal, q, 0).xy);
+            vec3 samplePosition = positionAt(q, sampleDepth, size);
+            vec4 sampleValue = texelFetch(uInput, q, 0);
+
+            // edge-stopping functions
+            float wNormal = pow(max(dot(normal, sampleNormal), 0.0), uSigmaNormal);
+            vec3 d = position - samplePosition;
+            float wPosition = exp(-dot(d, d) / posPhi);
+            float wLuminance = exp(-abs(centreLum - luminance(sampleValue.rgb)) / lumPhi);
+
+            float w = KERNEL[abs(x)] * KERNEL[abs(y)] * wNormal * wPosition * wLuminance;
+            sum += sampleValue * w;
+            weightSum += w;
+        }
+    }
+
+    FragColor = sum / weightSum;
+}
@@ -1,20 +1,30 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 layout (points) in;
 layout (triangle_strip, max_vertices = 12) out;
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-uniform int uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int uRenderMode; // 0 = write voxels, 1 = write to gbuffer
 
 in vec3 inWorldPos[];
 in vec3 inNormal[];
+in mat4 modelMatrix[]; // uModelMatrix, or the arena draw's
+flat in ivec2 inMaterialLayers[];
 out vec3 worldPos;
 out vec3 normal;
 out vec2 uvCoord;
+flat out ivec2 materialLayers;
 
 
 // uniform mat4 projection;
@@ -32,7 +42,7 @@ uniform float lineRadius = 0.1;
 void main() {
 	// Get start and end points of the line
 	vec4 pt = gl_in[0].gl_Position;
-	mat4 mvp = uProjectionMatrix * uViewMatrix * uModelMatrix;
+	mat4 mvp = uProjectionMatrix * uViewMatrix * modelMatrix[0];
 
 	vec3 right = normalize(cross(inNormal[0], vec3(0,1,0)));
 	vec3 up = normalize(cross(right, inNormal[0]));
@@ -48,6 +58,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.1; dy = 0; dz = 0;
@@ -55,6 +66,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.1; dy = 0.1; dz = 0;
@@ -62,6 +74,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.0; dy = 0; dz = -0.1;
@@ -69,6 +82,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.0; dy = 0; dz = 0.1;
@@ -76,6 +90,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.0; dy = 0.1; dz = 0;
@@ -83,6 +98,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.2; dy = 0.2; dz = 0.3;
@@ -90,6 +106,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.2; dy = 0.0; dz = 0.1;
@@ -97,6 +114,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.2; dy = 0.3; dz = 0.1;
@@ -104,6 +122,7 @@ void main() {
 	uvCoord = vec2(0.5 + dx, 0.5 + dy);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	// Close the triangle strip
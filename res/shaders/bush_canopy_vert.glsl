@@ -1,23 +1,47 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-uniform int uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int uRenderMode; // 0 = write voxels, 1 = write to gbuffer
+uniform bool uMultiDraw; // drawn from the shared mesh arena, the model matrix comes from the draw's record
+layout(location = 5) in uint aDrawIndex;
+uniform bool uInstanced; // hardware instanced plants, the model matrix is per instance
+layout(location = 6) in mat4 aInstanceModel;
+struct ObjectRecord {
+    mat4 model;
+    ivec4 material; // colour layer, normal layer
+};
+layout(std430, binding = 7) readonly buffer ObjectRecords {
+    ObjectRecord objects[];
+};
+uniform int uColourLayer; // layers in the material array when not drawn from the arena
+uniform int uNormalLayer;
 
 out vec3 inNormal;
+out mat4 modelMatrix;
+flat out ivec2 inMaterialLayers;
 out vec3 inWorldPos;
 out vec3 realInside;
 
 void main() {
-    inWorldPos = (uModelMatrix * vec4(aPosition, 1.0)).xyz;
-    mat3 normalMatrix = transpose(inverse(mat3(uModelMatrix)));
+    modelMatrix = uMultiDraw ? objects[aDrawIndex].model : (uInstanced ? aInstanceModel : uModelMatrix);
+    inMaterialLayers = uMultiDraw ? objects[aDrawIndex].material.xy : ivec2(uColourLayer, uNormalLayer);
+    inWorldPos = (modelMatrix * vec4(aPosition, 1.0)).xyz;
+    mat3 normalMatrix = transpose(inverse(mat3(modelMatrix)));
     inNormal = normalize(normalMatrix * aNormal); 
 
     gl_Position = /*uProjectionMatrix * uViewMatrix * uModelMatrix */ vec4(aPosition, 1.0);
@@ -0,0 +1,60 @@
+#version 440
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+/*
+    Injects the shadowed direct light of the primary light into a volume over the voxel grid, one invocation
+    per cell. The light itself is left out of the voxels when this is used, so the cones gathering this volume
+    only return bounced light and the direct part is evaluated analytically in the lighting pass.
+*/
+
+layout(rgba16f, binding = 0) uniform writeonly image3D uDirectOut;
+uniform sampler3D voxelTex1;     // Normal.xyz + Smoothness
+uniform sampler3D voxelTex2;     // Albedo.rgb + EmissiveFactor
+uniform samplerCube uShadowMap;  // distance from the light to the closest surface
+uniform int uResolution;
+uniform float uMipOffset;        // log2(voxel res / injection res)
+uniform float uVoxelWorldSize;
+uniform vec3 uVoxelCenter;
+uniform vec3 uLightPos;
+uniform vec3 uLightColor;        // color * intensity
+uniform float uLightRadius;
+uniform float uShadowBias;
+uniform float uDiffuseBrightnessMultiplier;
+
+const float PI = 3.14159265359;
+
+float lightFalloff(float dist, float radius) {
+    float x = dist / radius;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return window * window / (dist * dist + 1.0);
+}
+
+void main() {
+    ivec3 cell = ivec3(gl_GlobalInvocationID);
+    if (any(greaterThanEqual(cell, ivec3(uResolution)))) return;
+
+    vec3 coord = (vec3(cell) + 0.5) / float(uResolution);
+    vec3 averageNormal = textureLod(voxelTex1, coord, uMipOffset).xyz;
+    float occlusion = length(averageNormal);
+    if (occlusion < 0.01) {
+        imageStore(uDirectOut, cell, vec4(0.0));
+        return;
+    }
+    vec3 normal = averageNormal / occlusion;
+    vec3 albedo = textureLod(voxelTex2, coord, uMipOffset).rgb;
+
+    vec3 pos = uVoxelCenter + (coord - 0.5) * uVoxelWorldSize;
+    vec3 toLight = uLightPos - pos;
+    float dist = length(toLight);
+    float NdotL = dot(normal, toLight / max(dist, 1e-4));
+    // a cell is as large as the shadow bias often, so it gets a cell sized allowance
+    float cellSize = uVoxelWorldSize / float(uResolution);
+    bool lit = NdotL > 0.0 && dist < uLightRadius
+        && texture(uShadowMap, -toLight).r + uShadowBias + cellSize >= dist;
+
+    vec3 irradiance = lit ? uLightColor * NdotL * lightFalloff(dist, uLightRadius) : vec3(0.0);
+    // in the units of the voxel emission, the cones are scaled by uDiffuseBrightnessMultiplier afterwards. The
+    // multiplier can be set to 0 (nothing to inject then) and tiny ones must not overflow the half floats
+    vec3 radiance = uDiffuseBrightnessMultiplier > 0.0 ? albedo / PI * irradiance / uDiffuseBrightnessMultiplier : vec3(0.0);
+    imageStore(uDirectOut, cell, vec4(min(radiance, vec3(65504.0)), 1.0));
+}
@@ -0,0 +1,32 @@
+#version 440
+out vec4 FragColor; // closest depth, farthest depth
+
+uniform sampler2D uDepth;     // G-buffer depth, only read for level 0
+uniform sampler2D uPrevLevel; // the pyramid with its base level set to the previous level
+uniform int uLevel;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if (uLevel == 0) {
+        float d = texelFetch(uDepth, p, 0).r;
+        FragColor = vec4(d, d, 0.0, 0.0);
+        return;
+    }
+
+    ivec2 size = textureSize(uPrevLevel, 0);
+    ivec2 base = p * 2;
+    // odd sized levels fold their last row / column into the last texel so nothing is skipped
+    int extentX = (base.x + 2 == size.x - 1) ? 2 : 1;
+    int extentY = (base.y + 2 == size.y - 1) ? 2 : 1;
+
+    float closest = 1.0;
+    float farthest = 0.0;
+    for (int y = 0; y <= extentY; ++y) {
+        for (int x = 0; x <= extentX; ++x) {
+            vec2 d = texelFetch(uPrevLevel, min(base + ivec2(x, y), size - 1), 0).rg;
+            closest = min(closest, d.r);
+            farthest = max(farthest, d.g);
+        }
+    }
+    FragColor = vec4(closest, farthest, 0.0, 0.0);
+}
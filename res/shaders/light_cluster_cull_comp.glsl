@@ -0,0 +1,77 @@
+#version 440
+layout(local_size_x = 128) in;
+
+/*
+    Clustered light culling, one work group per froxel (screen tile x exponential depth slice).
+    Builds the view space AABB of the cluster and tests every light's sphere of influence against it,
+    the surviving light indices are written to a fixed size list per cluster.
+*/
+
+struct PointLight {
+    vec4 positionRadius; // world position.xyz + radius of influence
+    vec4 color;          // color * intensity
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer { PointLight lights[]; };
+layout(std430, binding = 1) writeonly buffer ClusterCountBuffer { uint clusterCounts[]; };
+layout(std430, binding = 2) writeonly buffer ClusterIndexBuffer { uint clusterIndices[]; };
+
+uniform mat4 uViewMatrix;
+uniform mat4 uInverseProjection;
+uniform uvec3 uClusterGrid;
+uniform float uClusterNear;
+uniform float uClusterFar;
+uniform uint uNumLights;
+uniform uint uMaxLightsPerCluster;
+
+shared uint sharedCount;
+
+// point on the near plane in view space
+vec3 ndcToView(vec2 ndc) {
+    vec4 v = uInverseProjection * vec4(ndc, -1.0, 1.0);
+    return v.xyz / v.w;
+}
+
+// intersection of the ray from the eye through p with the plane z = -depth
+vec3 atDepth(vec3 p, float depth) {
+    return p * (depth / -p.z);
+}
+
+float sliceDepth(uint slice) {
+    return uClusterNear * pow(uClusterFar / uClusterNear, float(slice) / float(uClusterGrid.z));
+}
+
+void main() {
+    uvec3 cluster = gl_WorkGroupID;
+    uint clusterIndex = cluster.x + cluster.y * uClusterGrid.x + cluster.z * uClusterGrid.x * uClusterGrid.y;
+
+    if (gl_LocalInvocationIndex == 0) sharedCount = 0;
+    barrier();
+
+    // the tile is axis aligned in NDC, so its extremes are at the min / max corners on the near and far planes
+    vec3 tileMin = ndcToView(vec2(cluster.xy) / vec2(uClusterGrid.xy) * 2.0 - 1.0);
+    vec3 tileMax = ndcToView(vec2(cluster.xy + 1u) / vec2(uClusterGrid.xy) * 2.0 - 1.0);
+    float nearDepth = sliceDepth(cluster.z);
+    float farDepth = sliceDepth(cluster.z + 1u);
+    vec3 minNear = atDepth(tileMin, nearDepth);
+    vec3 maxNear = atDepth(tileMax, nearDepth);
+    vec3 minFar = atDepth(tileMin, farDepth);
+    vec3 maxFar = atDepth(tileMax, farDepth);
+    vec3 aabbMin = min(min(minNear, maxNear), min(minFar, maxFar));
+    vec3 aabbMax = max(max(minNear, maxNear), max(minFar, maxFar));
+
+    for (uint i = gl_LocalInvocationIndex; i < uNumLights; i += gl_WorkGroupSize.x) {
+        vec3 lightPos = (uViewMatrix * vec4(lights[i].positionRadius.xyz, 1.0)).xyz;
+        float radius = lights[i].positionRadius.w;
+        vec3 d = lightPos - clamp(lightPos, aabbMin, aabbMax);
+        if (dot(d, d) <= radius * radius) {
+            uint slot = atomicAdd(sharedCount, 1u);
+            if (slot < uMaxLightsPerCluster)
+                clusterIndices[clusterIndex * uMaxLightsPerCluster + slot] = i;
+        }
+    }
+
+    barrier();
+    if (gl_LocalInvocationIndex == 0)
+        clusterCounts[clusterIndex] = min(sharedCount, uMaxLightsPerCluster);
+}
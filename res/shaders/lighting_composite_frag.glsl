@@ -0,0 +1,28 @@
+#version 440
+in vec2 texCoord;
+out vec4 FragColor; // HDR scene colour, alpha = 1 if the resolve should tone map it
+
+uniform sampler2D uRadiance;      // radiance.rgb + resolve flag (0 = pass through, eg. sky, emissives, debug views)
+uniform sampler2D uIrradiance;    // (filtered) indirect diffuse.rgb, scaled and with the near field, + ambient occlusion
+uniform sampler2D uDiffuseColour; // kD * albedo
+uniform sampler2D gBufferAlbedo;  // albedo.rgb + emissiveFactor
+uniform bool uSplitDiffuse;
+uniform vec3 uAmbientColor;
+uniform float uAO;
+
+// Adds the (filtered) indirect diffuse back onto the radiance at render resolution. The result is kept
+// for a frame so screen space reflections can sample the lit scene.
+void main() {
+    vec4 radiance = texture(uRadiance, texCoord);
+    if (radiance.a < 0.5) { FragColor = vec4(radiance.rgb, 0.0); return; }
+
+    vec3 finalColor = radiance.rgb;
+    if (uSplitDiffuse) {
+        vec4 irradiance = texture(uIrradiance, texCoord);
+        vec3 diffuseColour = texture(uDiffuseColour, texCoord).rgb;
+        vec3 albedo = texture(gBufferAlbedo, texCoord).rgb;
+        finalColor += diffuseColour * irradiance.rgb;
+        finalColor += uAmbientColor * albedo * irradiance.a * uAO;
+    }
+    FragColor = vec4(finalColor, 1.0);
+}
@@ -1,43 +1,126 @@
 #version 440
 in vec2 texCoord;
-out vec4 FragColor;
-
-uniform sampler2D gBufferPosition;
-uniform sampler2D gBufferNormal;
+layout(location = 0) out vec4 FragColor;         // HDR radiance, alpha = 1 if the resolve should tone map it
+layout(location = 1) out vec4 IrradianceOut;     // indirect diffuse.rgb + ambient occlusion (only when uSplitDiffuse, scaled into
+                                                  // the scene's units then, baking keeps the cones' units)
+layout(location = 2) out vec4 DiffuseColourOut;  // kD * albedo (only when uSplitDiffuse)
+
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode;
+};
+
+// the tracing parameters, uploaded once per trace (see gBufferLightingPass::lighting_block)
+layout(std140, binding = 1) uniform LightingParams {
+    mat4 uInverseViewProj; // of the prepass
+    mat4 uProjMatrix;
+    mat4 uPrevViewProj;
+    vec3 uAmbientColor;
+    float uConeAperture;
+    vec3 uHorizonColor;
+    float uStepMultiplier;
+    vec3 uZenithColor;
+    float uMaxSteps;
+    float VOXEL_SIZE;
+    float uMipLevelCount;
+    float uEmissiveThreshold;
+    int uNumDiffuseCones;
+    float uDiffuseBrightnessMultiplier;
+    float uTransmittanceNeededForConeTermination;
+    int uDebugIndex;
+    float uReflectionBlendLowerBound;
+    float uReflectionBlendUpperBound;
+    float uReflectionAperture;
+    float uConeOffset;
+    float uAO;
+    int uHiZLevels;
+    bool uSSREnabled;
+    int uSSRMaxIterations;
+    float uSSRMaxDistance;
+    float uSSRThickness; // how far (view space) a ray may be behind the depth buffer and still count as a hit
+    bool uSSGIEnabled;
+    float uSSGIDistance;
+    bool uBounceEnabled;
+    float uBounceMipOffset; // log2(voxel res / bounce res)
+    bool uSplitDiffuse; // write indirect diffuse to its own target so it can be denoised before the resolve
+    bool uUseBakedGI; // use the baked irradiance instead of tracing diffuse cones where available
+    bool uBakeMode; // the G-buffer is in lightmap space, only the indirect diffuse is needed
+};
+
+uniform sampler2D gBufferNormal;   // octahedral normal.xy + metallic + smoothness
+uniform sampler2D gBufferDepth;    // the world position is reconstructed from it with uInverseViewProj
+uniform sampler2D gBufferPosition; // explicit world position, only in lightmap space (uBakeMode)
 uniform sampler2D gBufferAlbedo;
 uniform sampler2D gBufferEmissive;
+uniform sampler2D gBufferBakedIrradiance; // baked indirect diffuse.rgb + ambient occlusion, valid where the spare channel is set
 uniform sampler3D voxelTex0; // Pos.xyz + Metallic
 uniform sampler3D voxelTex1; // Normal.xyz + Smoothness
 uniform sampler3D voxelTex2; // Albedo.rgb + EmissiveFactor
-uniform vec3 cameraPos;
-uniform mat4 uViewMatrix;
-uniform int uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform vec3 uVoxelCenter;
-uniform float VOXEL_SIZE;
-uniform float uMipLevelCount;
-uniform float uConeAperture; 
-uniform float uStepMultiplier;
-uniform float uMaxSteps;
-uniform float uEmissiveThreshold;
-uniform int   uNumDiffuseCones; 
-uniform float uDiffuseBrightnessMultiplier;
-uniform float uTransmittanceNeededForConeTermination;
-uniform vec3  uAmbientColor;
-uniform int uDebugIndex;
-uniform float uReflectionBlendLowerBound;
-uniform float uReflectionBlendUpperBound;
-uniform vec3 uHorizonColor;
-uniform vec3 uZenithColor;
-uniform bool uToneMapEnable;
-uniform float uReflectionAperture;
-uniform float uConeOffset;
-uniform float uAO;
-uniform float uContrast;
+
+// clustered analytic point lights, see light_cluster_cull_comp.glsl
+struct PointLight {
+    vec4 positionRadius; // world position.xyz + radius of influence
+    vec4 color;          // color * intensity
+};
+layout(std430, binding = 0) readonly buffer LightBuffer { PointLight lights[]; };
+layout(std430, binding = 1) readonly buffer ClusterCountBuffer { uint clusterCounts[]; };
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer { uint clusterIndices[]; };
+uniform bool uClusteredLightsEnabled;
+
+// the primary light, shadowed with a cube map and left out of the voxels, see shadowedLightPass.hpp
+uniform bool uShadowedLightEnabled;
+uniform vec3 uShadowedLightPos;
+uniform vec3 uShadowedLightColor; // color * intensity
+uniform float uShadowedLightRadius;
+uniform float uShadowBias;
+uniform samplerCube uShadowMap;   // distance from the light to the closest surface
+uniform sampler3D uDirectTex;     // its shadowed direct light * albedo, in the units of the voxel emission
+uniform float uDirectMipOffset;   // log2(voxel res / injection res)
+
+// screen space reflections
+uniform sampler2D uHiZ;            // closest / farthest window depth pyramid of this frame
+uniform sampler2D uPrevSceneColor; // last frame's HDR scene colour
+
+// screen space near field GI
+uniform sampler2D uNearFieldGI; // near field irradiance.rgb + hemisphere fraction not occluded within uSSGIDistance
+
+// multi-bounce
+uniform sampler3D uBounceTex;   // re-injected irradiance * albedo, coarser than the voxels
+uniform uvec3 uClusterGrid;
+uniform float uClusterNear;
+uniform float uClusterFar;
+uniform uint uMaxLightsPerCluster;
+
+// tracer statistics, steps and termination reasons of every cone traced by a pixel
+uniform bool uTracerStats;
+uniform bool uTracerHeatmap;
+uniform float uHeatmapMaxSteps; // steps per pixel shown as full red
+layout(std430, binding = 3) buffer TracerStatsBuffer {
+    uint statPixels;
+    uint statCones;
+    uint statStepsLow;              // a frame can take more than 2^32 steps, the carry goes to the high word
+    uint statStepsHigh;
+    uint statTerminatedOccluded;    // transmittance threshold or the first hit
+    uint statTerminatedLeftVolume;
+    uint statTerminatedMaxSteps;
+    uint statPadding;
+    uint statStepHistogram[32];     // pixels by mean steps per cone, buckets of uMaxSteps / 32
+    uint statMipHistogram[16];      // pixels by the highest mip any of their cones sampled
+};
 
 const float PI = 3.14159265359;
 #define APERTURE_SCALE 1.0
 #define REFLECTION_RANDOM_STR 0.05
+#define TERMINATED_OCCLUDED 0
+#define TERMINATED_LEFT_VOLUME 1
+#define TERMINATED_MAX_STEPS 2
 /*
     FEATURES:                                                                                                                                                                                                                       
     Emissive based specular for rough materials, geometry based reflections for smooth, with smooth blending between the two
@@ -50,12 +133,22 @@ const float PI = 3.14159265359;
 
     Metallics
 
-    Filmic tone mapping
-*/  
+    Filmic tone mapping (lighting_resolve_frag.glsl)
 
-vec3 adjustContrast(vec3 color) {
-    return (color - 0.5) * uContrast + 0.5;
-}
+    Static GI bake, the diffuse term is traced once per lightmap texel and read back from the G-buffer for static geometry
+
+    Optional multi-bounce, light gathered by the voxels in earlier frames is added to their emission
+
+    Screen space near field diffuse GI, the diffuse cones start at the handoff distance and only fill what it leaves open
+
+    Tracer statistics and a steps per pixel heatmap for tuning the cone parameters
+
+    Hi-Z screen space reflections for smooth surfaces, the geometry cone is only traced for rays the screen can't resolve
+
+    Analytic direct light from many point lights, culled into clusters by a compute pass, cones are only used for the indirect part
+
+    Cube shadow mapped direct light for the primary light, its shadowed light is injected into the voxels so the cones only carry its bounce
+*/  
 
 
 float fastRand(float seed) {
@@ -63,9 +156,17 @@ float fastRand(float seed) {
 }
 
 
-vec3 toneMapFilmic(vec3 color) {
-    color = max(vec3(0.0), color - 0.004);
-    return (color * (6.2 * color + 0.5)) / (color * (6.2 * color + 1.7) + 0.06);
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv, float depth) {
+    vec4 pos = uInverseViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return pos.xyz / pos.w;
 }
 
 vec3 worldToVoxel(vec3 pos) {
@@ -114,21 +215,67 @@ vec3 cosineSampleHemisphere(float u1, float u2) {
     return vec3(r * cos(phi), r * sin(phi), sqrt(max(0.0, 1.0 - u1)));
 }
 
+// per pixel totals of the cones traced so far
+int pixelCones = 0;
+int pixelSteps = 0;
+float pixelMaxMip = 0.0;
+int pixelTerminations[3] = int[](0, 0, 0);
+
+void recordCone(int steps, float maxMip, int reason) {
+    pixelCones++;
+    pixelSteps += steps;
+    pixelMaxMip = max(pixelMaxMip, maxMip);
+    pixelTerminations[reason]++;
+}
+
+void writeTracerStats() {
+    if (!uTracerStats) return;
+    atomicAdd(statPixels, 1u);
+    atomicAdd(statCones, uint(pixelCones));
+    uint previous = atomicAdd(statStepsLow, uint(pixelSteps));
+    if (previous + uint(pixelSteps) < previous)
+        atomicAdd(statStepsHigh, 1u);
+    atomicAdd(statTerminatedOccluded, uint(pixelTerminations[TERMINATED_OCCLUDED]));
+    atomicAdd(statTerminatedLeftVolume, uint(pixelTerminations[TERMINATED_LEFT_VOLUME]));
+    atomicAdd(statTerminatedMaxSteps, uint(pixelTerminations[TERMINATED_MAX_STEPS]));
+
+    float meanSteps = pixelCones > 0 ? float(pixelSteps) / float(pixelCones) : 0.0;
+    atomicAdd(statStepHistogram[clamp(int(meanSteps / max(uMaxSteps, 1.0) * 32.0), 0, 31)], 1u);
+    atomicAdd(statMipHistogram[clamp(int(pixelMaxMip), 0, 15)], 1u);
+}
+
+// blue -> green -> yellow -> red over the steps taken by the pixel, on a darkened albedo so the scene stays readable
+vec3 heatmapOverlay(vec3 albedo) {
+    float t = clamp(float(pixelSteps) / uHeatmapMaxSteps, 0.0, 1.0);
+    vec3 heat = t < 0.5 ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), t * 2.0)
+        : t < 0.75 ? mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), t * 4.0 - 2.0)
+        : mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), t * 4.0 - 3.0);
+    return mix(vec3(dot(albedo, vec3(0.2126, 0.7152, 0.0722)) * 0.3), heat, 0.75);
+}
+
 // standard trace cone function, traces against emissives
 vec4 traceCone(vec3 origin, vec3 direction, float aperture, bool stopAtFirstHit) {
     vec3 accumulatedColor = vec3(0.0);
     float accumulatedAlpha = 0.0;
     float distance = VOXEL_SIZE * 2.0;
 
+    int steps = 0;
+    float maxMip = 0.0;
+    int termination = TERMINATED_MAX_STEPS;
+
     for (int i = 0; i < int(uMaxSteps); ++i) {
         vec3 samplePos = origin + direction * distance;
         vec3 sampleCoord = worldToVoxel(samplePos);
 
-        if (any(lessThan(sampleCoord, vec3(0.0))) || any(greaterThan(sampleCoord, vec3(1.0))))
+        if (any(lessThan(sampleCoord, vec3(0.0))) || any(greaterThan(sampleCoord, vec3(1.0)))) {
+            termination = TERMINATED_LEFT_VOLUME;
             break;
+        }
 
         float coneDiameter = max(VOXEL_SIZE, distance * aperture);
         float mipLevel = clamp(log2(coneDiameter / VOXEL_SIZE), 0.0, uMipLevelCount);
+        steps++;
+        maxMip = max(maxMip, mipLevel);
 
         vec4 voxelData1 = textureLod(voxelTex1, sampleCoord, mipLevel);
         vec4 voxelData2 = textureLod(voxelTex2, sampleCoord, mipLevel);
@@ -138,6 +285,10 @@ vec4 traceCone(vec3 origin, vec3 direction, float aperture, bool stopAtFirstHit)
             vec3 voxelColor = voxelData2.rgb;
             float emissiveFactor = voxelData2.a;
             vec3 emissiveLight = voxelColor * emissiveFactor;
+            if (uBounceEnabled)
+                emissiveLight += textureLod(uBounceTex, sampleCoord, max(mipLevel - uBounceMipOffset, 0.0)).rgb;
+            if (uShadowedLightEnabled)
+                emissiveLight += textureLod(uDirectTex, sampleCoord, max(mipLevel - uDirectMipOffset, 0.0)).rgb;
 
             float transmittance = 1.0 - accumulatedAlpha;
             accumulatedColor += emissiveLight * occlusion * transmittance;
@@ -147,16 +298,20 @@ vec4 traceCone(vec3 origin, vec3 direction, float aperture, bool stopAtFirstHit)
             if (stopAtFirstHit) {
                 accumulatedColor = emissiveLight; // Return just the color of the first hit
                 accumulatedAlpha = 1.0; // Mark as fully occluded
+                termination = TERMINATED_OCCLUDED;
                 break;
             }
         }
 
-        if (accumulatedAlpha > (1.0 - uTransmittanceNeededForConeTermination))
+        if (accumulatedAlpha > (1.0 - uTransmittanceNeededForConeTermination)) {
+            termination = TERMINATED_OCCLUDED;
             break;
+        }
 
         distance += coneDiameter * uStepMultiplier;
     }
 
+    recordCone(steps, maxMip, termination);
     return vec4(accumulatedColor, 1.0 - accumulatedAlpha);
 }
 
@@ -171,15 +326,23 @@ vec4 traceConeAgainstGeometry(vec3 origin, vec3 direction, float aperture) {
     float accumulatedAlpha = 0.0;
     float distance = VOXEL_SIZE * 2.0;
 
+    int steps = 0;
+    float maxMip = 0.0;
+    int termination = TERMINATED_MAX_STEPS;
+
     for (int i = 0; i < int(uMaxSteps); ++i) {
         vec3 samplePos = origin + direction * distance;
         vec3 sampleCoord = worldToVoxel(samplePos);
 
-        if (any(lessThan(sampleCoord, vec3(0.0))) || any(greaterThan(sampleCoord, vec3(1.0))))
+        if (any(lessThan(sampleCoord, vec3(0.0))) || any(greaterThan(sampleCoord, vec3(1.0)))) {
+            termination = TERMINATED_LEFT_VOLUME;
             break;
+        }
 
         float coneDiameter = max(VOXEL_SIZE, distance * aperture);
         float mipLevel = clamp(log2(coneDiameter / VOXEL_SIZE), 0.0, uMipLevelCount);
+        steps++;
+        maxMip = max(maxMip, mipLevel);
 
         vec4 voxelData1 = textureLod(voxelTex1, sampleCoord, mipLevel);
         vec4 voxelData2 = textureLod(voxelTex2, sampleCoord, mipLevel);
@@ -196,19 +359,167 @@ vec4 traceConeAgainstGeometry(vec3 origin, vec3 direction, float aperture) {
 
             accumulatedColor = voxelRadiance;
             accumulatedAlpha = 1.0;
+            recordCone(steps, maxMip, TERMINATED_OCCLUDED);
             return vec4(accumulatedColor, 1.0 - accumulatedAlpha);
         }
 
-        if (accumulatedAlpha > (1.0 - uTransmittanceNeededForConeTermination))
+        if (accumulatedAlpha > (1.0 - uTransmittanceNeededForConeTermination)) {
+            termination = TERMINATED_OCCLUDED;
             break;
+        }
 
         distance += coneDiameter * uStepMultiplier;
     }
 
+    recordCone(steps, maxMip, termination);
     return vec4(getSkyColor(direction), 0);
 }
 
 
+float projNear() { return uProjMatrix[3][2] / (uProjMatrix[2][2] - 1.0); }
+float projFar() { return uProjMatrix[3][2] / (uProjMatrix[2][2] + 1.0); }
+
+// window space depth to view space distance
+float linearDepth(float depth) {
+    float near = projNear();
+    float far = projFar();
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * near * far / (far + near - z * (far - near));
+}
+
+// uv + window space depth
+vec3 worldToScreen(vec3 pos) {
+    vec4 clip = uProjMatrix * uViewMatrix * vec4(pos, 1.0);
+    return (clip.xyz / clip.w) * 0.5 + 0.5;
+}
+
+// Hi-Z ray march (min depth pyramid), cells the ray stays in front of are skipped at the coarsest level possible.
+// Returns last frame's colour at the hit with alpha 1, or alpha 0 if the ray leaves the screen, runs out of
+// iterations / distance, or passes behind geometry (a depth discontinuity the screen has no data for).
+vec4 traceScreenSpaceReflection(vec3 origin, vec3 direction) {
+    // shorten the ray so it stays in front of the near plane and projects to a valid segment
+    vec3 viewOrigin = (uViewMatrix * vec4(origin, 1.0)).xyz;
+    vec3 viewDirection = mat3(uViewMatrix) * direction;
+    float rayLength = uSSRMaxDistance;
+    if (viewOrigin.z + viewDirection.z * rayLength > -projNear())
+        rayLength = (-projNear() - viewOrigin.z) / viewDirection.z * 0.99;
+
+    vec3 start = worldToScreen(origin);
+    vec3 delta = worldToScreen(origin + direction * rayLength) - start;
+    vec2 safeDelta = mix(delta.xy, vec2(1e-7), lessThan(abs(delta.xy), vec2(1e-7)));
+
+    // start a texel along the ray so it doesn't hit the pixel it starts in
+    vec2 fullSize = vec2(textureSize(uHiZ, 0));
+    float t = 1.0 / max(max(abs(delta.x) * fullSize.x, abs(delta.y) * fullSize.y), 1.0);
+    int level = 0;
+
+    for (int i = 0; i < uSSRMaxIterations && t < 1.0; ++i) {
+        vec3 p = start + delta * t;
+        if (any(lessThan(p.xy, vec2(0.0))) || any(greaterThanEqual(p.xy, vec2(1.0))))
+            return vec4(0.0);
+
+        vec2 cellCount = vec2(textureSize(uHiZ, level));
+        vec2 cell = floor(p.xy * cellCount);
+        vec2 boundary = (cell + step(0.0, safeDelta)) / cellCount;
+        vec2 tBoundary = (boundary - start.xy) / safeDelta;
+        float tExit = min(tBoundary.x, tBoundary.y) + 1e-5;
+
+        float closest = texelFetch(uHiZ, ivec2(cell), level).r;
+        float rayDepthMax = max(p.z, start.z + delta.z * min(tExit, 1.0));
+        if (rayDepthMax < closest) { // in front of everything in this cell, skip it and go coarser
+            t = tExit;
+            level = min(level + 1, uHiZLevels - 1);
+            continue;
+        }
+        if (level > 0) { // might hit something in here, refine
+            level--;
+            continue;
+        }
+
+        // move to where the ray reaches the surface in this pixel
+        if (p.z < closest && delta.z > 0.0)
+            p = start + delta * max(t, (closest - start.z) / delta.z);
+        if (linearDepth(p.z) - linearDepth(closest) > uSSRThickness)
+            return vec4(0.0);
+
+        // reproject the hit into last frame
+        vec3 hitPos = reconstructPosition((cell + 0.5) / cellCount, texelFetch(gBufferDepth, ivec2(cell), 0).r);
+        vec4 prevClip = uPrevViewProj * vec4(hitPos, 1.0);
+        vec2 prevUv = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+        if (prevClip.w <= 0.0 || any(lessThan(prevUv, vec2(0.0))) || any(greaterThan(prevUv, vec2(1.0))))
+            return vec4(0.0);
+        return vec4(texture(uPrevSceneColor, prevUv).rgb, 1.0);
+    }
+    return vec4(0.0);
+}
+
+// smooth window so the light reaches exactly zero at its radius (the cluster culling relies on it)
+float lightFalloff(float dist, float radius) {
+    float x = dist / radius;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return window * window / (dist * dist + 1.0);
+}
+
+// direct diffuse + normalised blinn-phong specular from one point light
+vec3 evaluatePointLight(vec3 pos, vec3 normal, vec3 viewDir, vec3 albedo, float metallic, float roughness, vec3 F0,
+                        vec3 lightPos, float radius, vec3 color) {
+    vec3 toLight = lightPos - pos;
+    float dist = length(toLight);
+    vec3 L = toLight / max(dist, 1e-4);
+    float NdotL = dot(normal, L);
+    if (NdotL <= 0.0 || dist >= radius) return vec3(0.0);
+
+    float shininess = 2.0 / max(pow(roughness, 4.0), 1e-4) - 2.0;
+    float specularNorm = (shininess + 8.0) / (8.0 * PI);
+    vec3 H = normalize(viewDir + L);
+    vec3 F = fresnelSchlickRoughness(max(dot(H, viewDir), 0.0), F0, roughness);
+    vec3 kD = (1.0 - F) * (1.0 - metallic);
+    vec3 specular = F * specularNorm * pow(max(dot(normal, H), 0.0), shininess);
+    return (kD * albedo / PI + specular) * color * NdotL * lightFalloff(dist, radius);
+}
+
+// fraction of the primary light reaching pos, 3x3x3 PCF on the shadow cube with a normal offset
+float shadowVisibility(vec3 pos, vec3 normal) {
+    vec3 offsetPos = pos + normal * uShadowBias;
+    vec3 fromLight = offsetPos - uShadowedLightPos;
+    float dist = length(fromLight);
+    float filterRadius = 0.002 * dist;
+    float visible = 0.0;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            for (int z = -1; z <= 1; ++z) {
+                float closest = texture(uShadowMap, fromLight + vec3(x, y, z) * filterRadius).r;
+                visible += closest + uShadowBias >= dist ? 1.0 : 0.0;
+            }
+    return visible / 27.0;
+}
+
+// the primary light, the only direct light that is shadowed
+vec3 shadowedDirectLight(vec3 pos, vec3 normal, vec3 viewDir, vec3 albedo, float metallic, float roughness, vec3 F0) {
+    vec3 light = evaluatePointLight(pos, normal, viewDir, albedo, metallic, roughness, F0,
+                                    uShadowedLightPos, uShadowedLightRadius, uShadowedLightColor);
+    if (light == vec3(0.0)) return light;
+    return light * shadowVisibility(pos, normal);
+}
+
+// direct light from the point lights in this pixel's cluster
+vec3 clusteredDirectLight(vec3 pos, vec3 normal, vec3 viewDir, vec3 albedo, float metallic, float roughness, vec3 F0) {
+    float viewDepth = -(uViewMatrix * vec4(pos, 1.0)).z;
+    float slice = log(max(viewDepth, uClusterNear) / uClusterNear) / log(uClusterFar / uClusterNear) * float(uClusterGrid.z);
+    uvec3 cluster = uvec3(min(uvec2(texCoord * vec2(uClusterGrid.xy)), uClusterGrid.xy - 1u),
+                          min(uint(slice), uClusterGrid.z - 1u));
+    uint clusterIndex = cluster.x + cluster.y * uClusterGrid.x + cluster.z * uClusterGrid.x * uClusterGrid.y;
+
+    vec3 result = vec3(0.0);
+    uint count = clusterCounts[clusterIndex];
+    for (uint i = 0u; i < count; ++i) {
+        PointLight light = lights[clusterIndices[clusterIndex * uMaxLightsPerCluster + i]];
+        result += evaluatePointLight(pos, normal, viewDir, albedo, metallic, roughness, F0,
+                                     light.positionRadius.xyz, light.positionRadius.w, light.color.rgb);
+    }
+    return result;
+}
+
 // Monte carlo approach
 vec4 indirectDiffuseLight(vec3 pos, vec3 normal) {
     vec3 tangent, bitangent;
@@ -239,29 +550,33 @@ vec4 indirectDiffuseLight(vec3 pos, vec3 normal) {
 
 void main() {
     // read g buffer
-    vec3 worldPos = texture(gBufferPosition, texCoord).xyz;
-    float metallic = texture(gBufferPosition, texCoord).w;
-    vec3 worldNormal = texture(gBufferNormal, texCoord).xyz;
-    float smoothness = texture(gBufferNormal, texCoord).w;
+    float depth = texture(gBufferDepth, texCoord).r;
+    vec3 worldPos = uBakeMode ? texture(gBufferPosition, texCoord).xyz : reconstructPosition(texCoord, depth);
+    vec4 normalMaterial = texture(gBufferNormal, texCoord);
+    vec3 worldNormal = octDecode(normalMaterial.xy);
+    float metallic = normalMaterial.z;
+    float smoothness = normalMaterial.w;
     vec3 albedo = texture(gBufferAlbedo, texCoord).xyz;
     float emissiveFactor = texture(gBufferAlbedo, texCoord).w;
     vec3 emissiveRgb = texture(gBufferEmissive, texCoord).xyz;
     float spare = texture(gBufferEmissive, texCoord).w;
 
-    // debug and early exit cases
-    if (debugPass(worldPos, metallic, worldNormal, smoothness, albedo, emissiveFactor, emissiveRgb, spare) == 1) return;
-    if (length(worldNormal) < 0.1) { // SKY CASE, no geometry hit, so fragment = sky color
+    IrradianceOut = vec4(0);
+    DiffuseColourOut = vec4(0);
+
+    // debug and early exit cases, alpha 0 so the resolve passes them through untouched
+    if (debugPass(worldPos, metallic, worldNormal, smoothness, albedo, emissiveFactor, emissiveRgb, spare) == 1) { FragColor.a = 0; return; }
+    if (depth >= 1.0) { // SKY CASE, no geometry hit, so fragment = sky color
         // reconstruct view ray from screen space
         vec2 ndc = texCoord * 2.0 - 1.0; // convert from 0 : 1  to -1 : 1
         vec3 viewRayDir = normalize(vec3(ndc.x, ndc.y, -1.0));
         // transform from view space to world space
         vec3 worldViewDir = normalize(mat3(inverse(uViewMatrix)) * viewRayDir);
-        FragColor = vec4(getSkyColor(worldViewDir), 1); return;
+        FragColor = vec4(getSkyColor(worldViewDir), 0); return;
     }
-    if (emissiveFactor > uEmissiveThreshold) { FragColor = vec4(emissiveRgb * emissiveFactor, 1.0); return; }
+    if (emissiveFactor > uEmissiveThreshold) { FragColor = vec4(emissiveRgb * emissiveFactor, 0); return; }
 
     // setup vars
-    worldNormal = normalize(worldNormal);
     vec3 viewDir = normalize(cameraPos - worldPos);
     float roughness = 1.0 - smoothness;
     vec3 F0 = mix(vec3(0.04), albedo, metallic);
@@ -270,9 +585,27 @@ void main() {
     vec3 kD = (1.0 - F) * (1.0 - metallic);
     vec3 traceOrigin = worldPos + worldNormal * VOXEL_SIZE * uConeOffset;
 
-    // calculate indirect lighting
-    vec4 indirectDiffuseResult = indirectDiffuseLight(traceOrigin, worldNormal);
-    vec3 indirectDiffuse = indirectDiffuseResult.rgb;
+    // calculate indirect lighting, static geometry with a lightmap only needs the view dependent part traced
+    vec4 indirectDiffuseResult;
+    vec3 nearFieldIrradiance = vec3(0); // from the scene colour, already in its units unlike the cone result
+    if (uUseBakedGI && spare > 0.5)
+        indirectDiffuseResult = texture(gBufferBakedIrradiance, texCoord);
+    else if (uSSGIEnabled) {
+        vec4 nearField = texture(uNearFieldGI, texCoord);
+        vec3 diffuseOrigin = worldPos + worldNormal * max(VOXEL_SIZE * uConeOffset, uSSGIDistance);
+        indirectDiffuseResult = indirectDiffuseLight(diffuseOrigin, worldNormal);
+        // the cones only fill the part of the hemisphere the near field left open
+        nearFieldIrradiance = nearField.rgb;
+        indirectDiffuseResult *= nearField.a;
+    }
+    else
+        indirectDiffuseResult = indirectDiffuseLight(traceOrigin, worldNormal);
+    if (uBakeMode) {
+        IrradianceOut = indirectDiffuseResult;
+        FragColor = vec4(0);
+        return;
+    }
+    vec3 indirectDiffuse = indirectDiffuseResult.rgb * uDiffuseBrightnessMultiplier + nearFieldIrradiance;
     float ambientOcclusion = indirectDiffuseResult.a * uAO;     // the average transmittance from the diffuse cones gives a plausable ambient occlusion term
 
     // calculate specular and reflections
@@ -282,21 +615,38 @@ void main() {
     specularAperture = clamp(specularAperture, 0.001, 0.5);
     vec3 indirectGeometryResult = vec3(0);
     vec3 indirectSpecularResult = traceCone(traceOrigin, reflectDir, specularAperture, false).xyz;
-    if (smoothness >= uReflectionBlendLowerBound) // optimization for when the result is not used
-        indirectGeometryResult = traceConeAgainstGeometry(traceOrigin, reflectDir, uReflectionAperture + fastRand(traceOrigin.x + traceOrigin.y + traceOrigin.z) * REFLECTION_RANDOM_STR).xyz; // randomness to avoid blocky reflections
+    if (smoothness >= uReflectionBlendLowerBound) { // optimization for when the result is not used
+        // resolve from the screen when possible, the voxel geometry cone is the fallback
+        vec4 screenReflection = uSSREnabled ? traceScreenSpaceReflection(traceOrigin, reflectDir) : vec4(0);
+        if (screenReflection.a > 0.5)
+            indirectGeometryResult = screenReflection.rgb;
+        else
+            indirectGeometryResult = traceConeAgainstGeometry(traceOrigin, reflectDir, uReflectionAperture + fastRand(traceOrigin.x + traceOrigin.y + traceOrigin.z) * REFLECTION_RANDOM_STR).xyz * 1.5; // randomness to avoid blocky reflections, 1.5 is a bit of a hack
+    }
     float blendFactor = smoothstep(uReflectionBlendLowerBound, uReflectionBlendUpperBound, smoothness);
-    vec3 indirectSpecular = mix(indirectSpecularResult.rgb, indirectGeometryResult.rgb * 1.5, blendFactor); // blends between specular highlight and reflection, bit of a hack
+    vec3 indirectSpecular = mix(indirectSpecularResult.rgb, indirectGeometryResult.rgb, blendFactor); // blends between specular highlight and reflection
     if (smoothness < 0.3) // specular - smoothness cuttoff
 	indirectSpecular = vec3(0);  
 
+    vec3 direct = vec3(0);
+    if (uClusteredLightsEnabled)
+        direct = clusteredDirectLight(worldPos, worldNormal, viewDir, albedo, metallic, roughness, F0);
+    if (uShadowedLightEnabled && !uBakeMode)
+        direct += shadowedDirectLight(worldPos, worldNormal, viewDir, albedo, metallic, roughness, F0);
+
     // calculate resulting fragment
-    vec3 diffuseGI = kD * albedo * indirectDiffuse;
+    writeTracerStats();
+    if (uTracerHeatmap) { FragColor = vec4(heatmapOverlay(albedo), 0); return; }
     vec3 specularGI = F * indirectSpecular;     
-    vec3 globalIllumination = (diffuseGI * uDiffuseBrightnessMultiplier) + specularGI;
+    if (uSplitDiffuse) { // diffuse and ambient are added back by the resolve after filtering
+        IrradianceOut = vec4(indirectDiffuse, indirectDiffuseResult.a);
+        DiffuseColourOut = vec4(kD * albedo, 1.0);
+        FragColor = vec4(specularGI + indirectSpecular + direct, 1.0);
+        return;
+    }
+    vec3 diffuseGI = kD * albedo * indirectDiffuse;
+    vec3 globalIllumination = diffuseGI + specularGI;
     vec3 ambient = uAmbientColor * albedo * ambientOcclusion;
-    vec3 finalColor = globalIllumination + ambient + indirectSpecular;
-    if (uToneMapEnable)
-        finalColor = toneMapFilmic(finalColor);
-    finalColor = adjustContrast(finalColor);
+    vec3 finalColor = globalIllumination + ambient + indirectSpecular + direct;
     FragColor = vec4(finalColor, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#version 440
+in vec2 texCoord;
+out vec4 FragColor;
+
+uniform sampler2D uSceneColor; // HDR scene colour + tone map flag (0 = pass through, eg. debug views)
+uniform bool uToneMapEnable;
+uniform float uContrast;
+uniform float uSharpness;      // strength of the sharpen after temporal upscaling, 0 = off
+
+vec3 adjustContrast(vec3 color) {
+    return (color - 0.5) * uContrast + 0.5;
+}
+
+vec3 toneMapFilmic(vec3 color) {
+    color = max(vec3(0.0), color - 0.004);
+    return (color * (6.2 * color + 0.5)) / (color * (6.2 * color + 1.7) + 0.06);
+}
+
+vec3 displayColor(vec4 scene) {
+    if (scene.a < 0.5) return scene.rgb;
+    vec3 finalColor = scene.rgb;
+    if (uToneMapEnable)
+        finalColor = toneMapFilmic(finalColor);
+    return adjustContrast(finalColor);
+}
+
+void main() {
+    vec4 scene = texture(uSceneColor, texCoord);
+    vec3 finalColor = displayColor(scene);
+
+    // unsharp mask against the 4 neighbours, gives back the detail the history blend softens
+    if (uSharpness > 0.0 && scene.a >= 0.5) {
+        vec3 neighbours = displayColor(textureOffset(uSceneColor, texCoord, ivec2(1, 0)))
+            + displayColor(textureOffset(uSceneColor, texCoord, ivec2(-1, 0)))
+            + displayColor(textureOffset(uSceneColor, texCoord, ivec2(0, 1)))
+            + displayColor(textureOffset(uSceneColor, texCoord, ivec2(0, -1)));
+        finalColor = clamp(finalColor + uSharpness * (4.0 * finalColor - neighbours), 0.0, 1.0);
+    }
+    FragColor = vec4(finalColor, 1.0);
+}
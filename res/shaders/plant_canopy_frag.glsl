@@ -1,33 +1,47 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 layout(binding = 0, rgba16f) uniform image3D voxelTex0; // Pos.xyz + Metallic
 layout(binding = 1, rgba16f) uniform image3D voxelTex1; // Normal.xyz + Smoothness
 layout(binding = 2, rgba16f) uniform image3D voxelTex2; // Albedo.rgb + EmissiveFactor
 
-uniform int   uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int   uRenderMode; // 0 = voxelize, 1 = gbuffer
-uniform vec3 uVoxelCenter;
-uniform int uVoxelSplatRadius;
 
-layout(location = 0) out vec4 gPosition; // world position.xyz + metallic
-layout(location = 1) out vec4 gNormal;   // world normal.xyz + smoothness
-layout(location = 2) out vec4 gAlbedo;   // albedo.rgb + emissiveFactor
-layout(location = 3) out vec4 gEmissive; // emissive.rgb + spare channel
+layout(location = 0) out vec4 gNormal;   // octahedral normal.xy + metallic + smoothness
+layout(location = 1) out vec4 gAlbedo;   // albedo.rgb + emissiveFactor
+layout(location = 2) out vec4 gEmissive; // emissive.rgb + spare channel
+layout(location = 4) out vec4 gPosition; // world position.xyz, only for lightmap space G-buffers (no depth to reconstruct from)
 
 in vec3 worldPos;
 in vec3 normal; // must be world space
 in vec2 uvCoord;
+flat in ivec2 materialLayers; // colour layer, normal layer
 out vec4 fragColor;
 
-uniform sampler2D colourTexture;
-uniform sampler2D normalTexture;
+uniform sampler2DArray uMaterialArray; // see vct/materialTextures.hpp
 
 struct MaterialData {
     vec3 pos, nrm, alb, emi; // world position, world normal, albedo, emissive color
     float mtl, smoothness, emiFac; // metalic, smoothness, emissive factor (strength of emission)
 };
 
+// unit normal to the [0,1]^2 octahedral encoding of the G-buffer
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
 void writeRenderInfo(MaterialData m) {
     if (uRenderMode == 0) { // voxel
         // center the voxel grid around uVoxelCenter
@@ -52,8 +66,8 @@ void writeRenderInfo(MaterialData m) {
         }
     }
     else { // gbuffer
-        gPosition = vec4(m.pos, m.mtl);
-        gNormal = vec4(normalize(m.nrm), m.smoothness);
+        gNormal = vec4(octEncode(normalize(m.nrm)), m.mtl, m.smoothness);
+        gPosition = vec4(m.pos, 1.0);
         gAlbedo = vec4(m.alb, m.emiFac);
         gEmissive = vec4(m.emi * m.emiFac, 0);
     }
@@ -63,7 +77,7 @@ void main() {
     MaterialData m;
     m.pos = worldPos;
     m.nrm = normal;
-    m.alb = texture2D(colourTexture, uvCoord).rgb;
+    m.alb = texture(uMaterialArray, vec3(uvCoord, materialLayers.x)).rgb;
     m.emi = vec3(0.0);		
     m.mtl = 0.0;		// 0 for non-metalic surfaces
     m.smoothness = 0.15;	// can be thought of as shinyness, eg concrete has a low value
@@ -1,20 +1,30 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 layout (points) in;
 layout (triangle_strip, max_vertices = 6) out;
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-uniform int uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int uRenderMode; // 0 = write voxels, 1 = write to gbuffer
 
 in vec3 inWorldPos[];
 in vec3 inNormal[];
+in mat4 modelMatrix[]; // uModelMatrix, or the arena draw's
+flat in ivec2 inMaterialLayers[];
 out vec3 worldPos;
 out vec3 normal;
 out vec2 uvCoord;
+flat out ivec2 materialLayers;
 
 
 // uniform mat4 projection;
@@ -32,7 +42,7 @@ uniform float lineRadius = 0.1;
 void main() {
 	// Get start and end points of the line
 	vec4 pt = gl_in[0].gl_Position;
-	mat4 mvp = uProjectionMatrix * uViewMatrix * uModelMatrix;
+	mat4 mvp = uProjectionMatrix * uViewMatrix * modelMatrix[0];
 
 	vec3 right = normalize(cross(inNormal[0], vec3(0,1,0)));
 	vec3 up = normalize(cross(right, inNormal[0]));
@@ -45,6 +55,7 @@ void main() {
 	uvCoord = vec2(0.4340277777777778, 0.8796296296296297);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = -0.08796296296296297; dy = 0.10763888888888895;
@@ -52,6 +63,7 @@ void main() {
 	uvCoord = vec2(0.3460648148148148, 0.7719907407407407);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.15625; dy = 0.12037037037037035;
@@ -59,6 +71,7 @@ void main() {
 	uvCoord = vec2(0.5902777777777778, 0.7592592592592593);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = -0.10532407407407407; dy = 0.3784722222222222;
@@ -66,6 +79,7 @@ void main() {
 	uvCoord = vec2(0.3287037037037037, 0.5011574074074074);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.14120370370370372; dy = 0.4502314814814815;
@@ -73,6 +87,7 @@ void main() {
 	uvCoord = vec2(0.5752314814814815, 0.42939814814814814);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	dx = 0.00694444444444442; dy = 0.7337962962962963;
@@ -80,6 +95,7 @@ void main() {
 	uvCoord = vec2(0.4409722222222222, 0.14583333333333334);
 	worldPos = inWorldPos[0];
 	normal = norm;
+	materialLayers = inMaterialLayers[0];
 	EmitVertex();
 
 	// Close the triangle strip
@@ -1,21 +1,31 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 layout (lines) in;
 layout (triangle_strip, max_vertices = 24) out;
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-uniform int uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int uRenderMode; // 0 = write voxels, 1 = write to gbuffer
 
 in vec3 inWorldPos[];
 in vec3 inNormal[];
+in mat4 modelMatrix[]; // uModelMatrix, or the arena draw's
+flat in ivec2 inMaterialLayers[];
 in float sizes[];
 out vec3 worldPos;
 out vec3 normal;
 out vec2 uvCoord;
+flat out ivec2 materialLayers;
 
 
 // uniform mat4 projection;
@@ -54,19 +64,21 @@ void main() {
         vec3 offset = lineRadius * (right * cos(angle) + up * sin(angle));
 
         // Bottom circle
-        gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * vec4(start.xyz + (offset * startMult), 1.0);
+        gl_Position = uProjectionMatrix * uViewMatrix * modelMatrix[0] * vec4(start.xyz + (offset * startMult), 1.0);
 		uvCoord = vec2((angle / 6.283185308)/8, 0);
 		worldPos = inWorldPos[0];
 		normal = normalize(offset);
+        materialLayers = inMaterialLayers[0];
         EmitVertex();
 	
 	uvpos += 1;
 
         // Top circle
-        gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * vec4(end.xyz + (offset * endMult), 1.0);
+        gl_Position = uProjectionMatrix * uViewMatrix * modelMatrix[0] * vec4(end.xyz + (offset * endMult), 1.0);
 		worldPos = inWorldPos[1];
 		uvCoord = vec2((angle / 6.283185308)/8, 1);
 		normal = normalize(offset);
+        materialLayers = inMaterialLayers[0];
         EmitVertex();
     }
 
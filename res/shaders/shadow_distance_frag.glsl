@@ -0,0 +1,14 @@
+#version 440
+in vec2 texCoord;
+out float Distance; // distance from the light to the closest surface, written to one face of the shadow cube
+
+uniform sampler2D gBufferDepth; // the face rendered from the light
+uniform mat4 uInverseViewProj;
+uniform vec3 uLightPos;
+
+void main() {
+    float depth = texture(gBufferDepth, texCoord).r;
+    if (depth >= 1.0) { Distance = 1e30; return; } // nothing in this direction
+    vec4 pos = uInverseViewProj * vec4(vec3(texCoord, depth) * 2.0 - 1.0, 1.0);
+    Distance = length(pos.xyz / pos.w - uLightPos);
+}
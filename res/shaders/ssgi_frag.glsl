@@ -0,0 +1,100 @@
+#version 440
+in vec2 texCoord;
+out vec4 FragColor; // near field irradiance.rgb + fraction of the hemisphere left to the voxel cones
+
+uniform sampler2D gBufferDepth;
+uniform sampler2D gBufferNormal;   // octahedral normal.xy + metallic + smoothness
+uniform mat4 uInverseViewProj;     // of the prepass, for the world positions
+uniform sampler2D uPrevSceneColor; // last frame's HDR scene colour, the radiance of the occluders
+uniform mat4 uViewMatrix;
+uniform mat4 uProjMatrix;
+uniform mat4 uPrevViewProj;
+uniform float uRadius;             // world space handoff distance to the voxel cones
+uniform int uDirections;
+uniform int uSteps;
+uniform float uStrength;
+
+/*
+    Horizon based screen space diffuse GI for the near field. For a few screen space directions the
+    G-buffer is marched out to the handoff radius, every sample that raises the horizon covers a new
+    slice of the cosine weighted hemisphere and contributes last frame's radiance for that slice.
+    What remains above the horizons is returned in alpha, the lighting pass fills it with voxel cones
+    that start at the handoff radius, so small contact detail doesn't depend on the voxel resolution.
+*/
+
+const float PI = 3.14159265359;
+
+float interleavedGradientNoise(vec2 p) {
+    return fract(52.9829189 * fract(dot(p, vec2(0.06711056, 0.00583715))));
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv, float depth) {
+    vec4 pos = uInverseViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return pos.xyz / pos.w;
+}
+
+vec3 previousRadiance(vec3 worldPos) {
+    vec4 clip = uPrevViewProj * vec4(worldPos, 1.0);
+    vec2 uv = (clip.xy / clip.w) * 0.5 + 0.5;
+    if (clip.w <= 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        return vec3(0.0);
+    return texture(uPrevSceneColor, uv).rgb;
+}
+
+void main() {
+    float depth = texture(gBufferDepth, texCoord).r;
+    if (depth >= 1.0) { FragColor = vec4(0.0, 0.0, 0.0, 1.0); return; } // sky
+    vec3 worldPos = reconstructPosition(texCoord, depth);
+    vec3 normal = octDecode(texture(gBufferNormal, texCoord).xy);
+
+    // screen space length of the radius at this depth, nothing to do if it is below a pixel
+    vec2 size = vec2(textureSize(gBufferDepth, 0));
+    float viewDepth = max(-(uViewMatrix * vec4(worldPos, 1.0)).z, 1e-3);
+    float radiusPixels = min(uRadius * uProjMatrix[1][1] * 0.5 * size.y / viewDepth, 0.25 * size.y);
+    if (radiusPixels < 1.0) { FragColor = vec4(0.0, 0.0, 0.0, 1.0); return; }
+
+    float noise = interleavedGradientNoise(gl_FragCoord.xy);
+    vec3 irradiance = vec3(0.0);
+    float occluded = 0.0;
+    for (int d = 0; d < uDirections; ++d) {
+        float angle = (float(d) + noise) / float(uDirections) * 2.0 * PI;
+        vec2 direction = vec2(cos(angle), sin(angle)) * radiusPixels / size;
+        float horizon = 0.0; // sine of the highest elevation seen so far, 0 = tangent plane
+
+        for (int s = 1; s <= uSteps; ++s) {
+            vec2 uv = texCoord + direction * (float(s) - 0.5 * noise) / float(uSteps);
+            if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+                break;
+
+            float sampleDepth = texture(gBufferDepth, uv).r;
+            if (sampleDepth >= 1.0) continue;
+            vec3 samplePos = reconstructPosition(uv, sampleDepth);
+            vec3 toSample = samplePos - worldPos;
+            float dist = length(toSample);
+            if (dist > uRadius || dist < 1e-4) continue;
+
+            float elevation = dot(normal, toSample / dist);
+            if (elevation > horizon) {
+                // cosine weighted share of the slice between the old and the new horizon
+                float coverage = elevation * elevation - horizon * horizon;
+                vec3 sampleNormal = octDecode(texture(gBufferNormal, uv).xy);
+                float facing = clamp(dot(sampleNormal, -toSample / dist), 0.0, 1.0);
+                irradiance += previousRadiance(samplePos) * coverage * facing;
+                occluded += coverage;
+                horizon = elevation;
+            }
+        }
+    }
+
+    irradiance *= uStrength / float(uDirections);
+    occluded /= float(uDirections);
+    FragColor = vec4(irradiance, clamp(1.0 - occluded, 0.0, 1.0));
+}
@@ -0,0 +1,82 @@
+#version 440
+in vec2 texCoord;
+out vec4 FragColor; // HDR colour at output resolution + tone map flag
+
+uniform sampler2D uCurrent;        // HDR scene colour at render resolution + tone map flag
+uniform sampler2D uHistory;        // last output, output resolution
+uniform sampler2D gBufferDepth;
+uniform mat4 uInverseViewProj;     // this frame's G-buffer, with jitter
+uniform mat4 uPrevViewProj;        // last frame, without jitter
+uniform vec2 uJitter;              // sub pixel offset of this frame's samples, in render pixels
+uniform float uFeedback;           // history weight where the current sample lies on the output pixel
+uniform float uClampGamma;         // width of the history clamp in standard deviations
+uniform bool uHistoryValid;
+
+/*
+    Temporal upscaling. Every frame the G-buffer and lighting are rendered at a lower resolution with a
+    different sub pixel jitter, each output pixel takes the render sample closest to it, weighted by how
+    close it is, and accumulates it onto the reprojected history. The history is clamped to the variance
+    box of the current neighbourhood (in YCoCg) so disocclusions and lighting changes don't ghost.
+    Motion comes from the (reconstructed) G-buffer world position and the camera matrices, the scene geometry is static.
+*/
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// blending in a compressed space keeps single bright samples from dominating
+vec3 compress(vec3 c) { return c / (1.0 + luminance(c)); }
+vec3 uncompress(vec3 c) { return c / max(1.0 - luminance(c), 1e-4); }
+
+vec3 rgbToYCoCg(vec3 c) {
+    return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 yCoCgToRgb(vec3 c) {
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+void main() {
+    vec2 renderSize = vec2(textureSize(uCurrent, 0));
+    vec2 outputSize = vec2(textureSize(uHistory, 0));
+    ivec2 maxPixel = ivec2(renderSize) - 1;
+
+    // the render pixel whose (jittered) sample is closest to this output pixel
+    ivec2 pixel = clamp(ivec2(floor(texCoord * renderSize - uJitter)), ivec2(0), maxPixel);
+    vec4 current = texelFetch(uCurrent, pixel, 0);
+    vec2 sampleOffset = ((vec2(pixel) + 0.5 + uJitter) / renderSize - texCoord) * outputSize;
+    float confidence = exp(-2.29 * dot(sampleOffset, sampleOffset)); // gaussian fit of a Blackman-Harris window
+
+    // motion, sky pixels are reprojected as if on the far plane
+    float depth = texelFetch(gBufferDepth, pixel, 0).r; // cleared to 1, the far plane
+    vec4 world = uInverseViewProj * vec4(vec3((vec2(pixel) + 0.5) / renderSize, depth) * 2.0 - 1.0, 1.0);
+    vec3 worldPos = world.xyz / world.w;
+    vec4 prevClip = uPrevViewProj * vec4(worldPos, 1.0);
+    vec2 prevUv = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+
+    if (!uHistoryValid || prevClip.w <= 0.0 || any(lessThan(prevUv, vec2(0.0))) || any(greaterThan(prevUv, vec2(1.0)))) {
+        FragColor = texture(uCurrent, texCoord);
+        return;
+    }
+
+    // variance of the 3x3 render neighbourhood
+    vec3 m1 = vec3(0.0);
+    vec3 m2 = vec3(0.0);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec3 c = rgbToYCoCg(compress(texelFetch(uCurrent, clamp(pixel + ivec2(x, y), ivec2(0), maxPixel), 0).rgb));
+            m1 += c;
+            m2 += c * c;
+        }
+    }
+    vec3 mean = m1 / 9.0;
+    vec3 sigma = sqrt(max(m2 / 9.0 - mean * mean, 0.0));
+    vec3 boxMin = mean - uClampGamma * sigma;
+    vec3 boxMax = mean + uClampGamma * sigma;
+
+    vec3 history = clamp(rgbToYCoCg(compress(texture(uHistory, prevUv).rgb)), boxMin, boxMax);
+    vec3 currentColor = rgbToYCoCg(compress(current.rgb));
+    float currentWeight = max((1.0 - uFeedback) * confidence, 0.01);
+    vec3 result = uncompress(yCoCgToRgb(mix(history, currentColor, currentWeight)));
+    FragColor = vec4(max(result, 0.0), current.a);
+}
@@ -1,21 +1,29 @@
 #version 440
 
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
+
 // Voxel stuff
 layout(binding = 0, rgba16f) uniform image3D voxelTex0; // Pos.xyz + Metallic
 layout(binding = 1, rgba16f) uniform image3D voxelTex1; // Normal.xyz + Smoothness
 layout(binding = 2, rgba16f) uniform image3D voxelTex2; // Albedo.rgb + EmissiveFactor
 
-uniform int   uVoxelRes;
-uniform float uVoxelWorldSize;
-uniform int   uRenderMode; // 0 = voxelize, 1 = gbuffer
-uniform vec3 uVoxelCenter;
-uniform int uVoxelSplatRadius;
 
 
-layout(location = 0) out vec4 gPosition; // world position.xyz + metallic
-layout(location = 1) out vec4 gNormal;   // world normal.xyz + smoothness
-layout(location = 2) out vec4 gAlbedo;   // albedo.rgb + emissiveFactor
-layout(location = 3) out vec4 gEmissive; // emissive.rgb + spare channel
+layout(location = 0) out vec4 gNormal;   // octahedral normal.xy + metallic + smoothness
+layout(location = 1) out vec4 gAlbedo;   // albedo.rgb + emissiveFactor
+layout(location = 2) out vec4 gEmissive; // emissive.rgb + spare channel (1 = baked irradiance is valid)
+layout(location = 3) out vec4 gBakedIrradiance; // baked indirect diffuse.rgb + ambient occlusion
+layout(location = 4) out vec4 gPosition; // world position.xyz, only for lightmap space G-buffers (no depth to reconstruct from)
 
 struct MaterialData {
 	vec3 pos, nrm, alb, emi; // world position, world normal, albedo, emissive color
@@ -24,9 +32,7 @@ struct MaterialData {
 
 // regular stuff
 
-uniform mat4 uProjectionMatrix;
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
 uniform vec3 uColor;
 
 // viewspace data
@@ -41,13 +47,17 @@ out vec4 fb_color;
 
 uniform sampler2D heightMap;
 
-uniform sampler2D water_texture;
-uniform sampler2D sand_texture;
-uniform sampler2D grass_texture;
-uniform sampler2D rock_texture;
-uniform sampler2D snow_texture;
+// the material textures are layers of one array, see vct/materialTextures.hpp
+uniform sampler2DArray uMaterialArray;
+uniform int water_layer;
+uniform int sand_layer;
+uniform int grass_layer;
+uniform int rock_layer;
+uniform int snow_layer;
 uniform bool useTexturing; // whether or not to use texturing or just display the heightmap
 uniform bool useFakedLighting; // whether to use faked lighting, just until proper lighting is implemented
+uniform sampler2D lightmap; // baked indirect diffuse.rgb + ambient occlusion
+uniform bool useLightmap;
 
 // Slope texturing parameters
 uniform float min_rock_slope;
@@ -57,6 +67,13 @@ uniform float tex_base_scalar;
 uniform float triplanar_sharpness; // Controls blend sharpness between projections
 uniform bool use_triplanar_mapping;
 
+// unit normal to the [0,1]^2 octahedral encoding of the G-buffer
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
 void writeRenderInfo(MaterialData m) {
     if (uRenderMode == 0) { // voxel
         // center the voxel grid around uVoxelCenter
@@ -81,10 +98,12 @@ void writeRenderInfo(MaterialData m) {
         }
     }
     else { // gbuffer
-        gPosition = vec4(m.pos, m.mtl);
-        gNormal = vec4(normalize(m.nrm), m.smoothness);
+        gNormal = vec4(octEncode(normalize(m.nrm)), m.mtl, m.smoothness);
+        gPosition = vec4(m.pos, 1.0);
         gAlbedo = vec4(m.alb, m.emiFac);
-        gEmissive = vec4(m.emi * m.emiFac, 0);
+        bool baked = uRenderMode == 1 && useLightmap;
+        gEmissive = vec4(m.emi * m.emiFac, baked ? 1.0 : 0.0);
+        gBakedIrradiance = baked ? texture(lightmap, f_in.textureCoord) : vec4(0.0);
     }
 }
 
@@ -100,11 +119,11 @@ vec3 getTerrainColor(vec2 uv, float height) {
 	const float blend_range = 0.25;
 
 	// Sample all textures
-	vec3 water_color = texture(water_texture, uv).rgb;
-	vec3 sand_color = texture(sand_texture, uv).rgb;
-	vec3 grass_color = texture(grass_texture, uv).rgb;
-	vec3 rock_color = texture(rock_texture, uv).rgb;
-	vec3 snow_color = texture(snow_texture, uv).rgb;
+	vec3 water_color = texture(uMaterialArray, vec3(uv, water_layer)).rgb;
+	vec3 sand_color = texture(uMaterialArray, vec3(uv, sand_layer)).rgb;
+	vec3 grass_color = texture(uMaterialArray, vec3(uv, grass_layer)).rgb;
+	vec3 rock_color = texture(uMaterialArray, vec3(uv, rock_layer)).rgb;
+	vec3 snow_color = texture(uMaterialArray, vec3(uv, snow_layer)).rgb;
 
 	vec3 final_color;
 
@@ -132,16 +151,16 @@ vec3 getTerrainColor(vec2 uv, float height) {
 	return final_color;
 }
 
-vec3 triplanarSample(sampler2D tex, vec3 worldPos, vec3 normal) {
+vec3 triplanarSample(int layer, vec3 worldPos, vec3 normal) {
 	// Calculate blend weights based on normal
 	vec3 blendWeights = abs(normal);
 	blendWeights = pow(blendWeights, vec3(triplanar_sharpness));
 	blendWeights /= (blendWeights.x + blendWeights.y + blendWeights.z);
 
 	// Sample texture from each projection plane
-	vec3 xProjection = texture(tex, worldPos.zy).rgb;
-	vec3 yProjection = texture(tex, worldPos.xz).rgb;
-	vec3 zProjection = texture(tex, worldPos.xy).rgb;
+	vec3 xProjection = texture(uMaterialArray, vec3(worldPos.zy, layer)).rgb;
+	vec3 yProjection = texture(uMaterialArray, vec3(worldPos.xz, layer)).rgb;
+	vec3 zProjection = texture(uMaterialArray, vec3(worldPos.xy, layer)).rgb;
 
 	// Blend the three projections
 	return xProjection * blendWeights.x +
@@ -151,8 +170,8 @@ vec3 triplanarSample(sampler2D tex, vec3 worldPos, vec3 normal) {
 
 // Get slope texture with triplanar mapping
 vec3 getTerrainColorSlopeTriplanar(vec3 worldPos, vec3 normal) {
-	vec3 grass_col = triplanarSample(grass_texture, worldPos, normal);
-	vec3 rock_col = triplanarSample(rock_texture, worldPos, normal);
+	vec3 grass_col = triplanarSample(grass_layer, worldPos, normal);
+	vec3 rock_col = triplanarSample(rock_layer, worldPos, normal);
 
 	float rock_grass_weight = normal.y;
 	
@@ -167,8 +186,8 @@ vec3 getTerrainColorSlopeTriplanar(vec3 worldPos, vec3 normal) {
 
 // Get slope texture without triplanar mapping
 vec3 getTerrainColorSlope(vec2 uv, vec3 normal) {
-	vec3 grass_col = texture(grass_texture, uv).rgb;
-	vec3 rock_col = texture(rock_texture, uv).rgb;
+	vec3 grass_col = texture(uMaterialArray, vec3(uv, grass_layer)).rgb;
+	vec3 rock_col = texture(uMaterialArray, vec3(uv, rock_layer)).rgb;
 
 	float rock_grass_weight = normal.y;
 	
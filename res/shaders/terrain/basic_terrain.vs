@@ -1,8 +1,18 @@
-#version 400 core
+#version 440
+
+// per frame constants, see vct/frameConstants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 uViewMatrix;
+    mat4 uProjectionMatrix;
+    vec3 cameraPos;
+    float uVoxelWorldSize;
+    vec3 uVoxelCenter;
+    int uVoxelRes;
+    int uVoxelSplatRadius;
+    int uRenderMode; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+};
 
-uniform mat4 uProjectionMatrix;
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
 uniform vec3 uColor;
 
 // Mesh stuff
@@ -86,4 +96,9 @@ void main() {
 
 	// set the screenspace position (needed for converting to fragment data)
 	gl_Position = uProjectionMatrix * modelView * vec4(pos, 1);
+
+	// static GI bake, rasterise in lightmap space so every texel gets its world position and normal
+	if (uRenderMode == 2) {
+		gl_Position = vec4(aTexCoord * 2.0 - 1.0, 0.0, 1.0);
+	}
 }
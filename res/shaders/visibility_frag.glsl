@@ -0,0 +1,9 @@
+#version 440 core
+
+uniform uint uDrawIndex;
+
+out uint visibilityId; // (draw + 1) << 20 | triangle, 0 = nothing
+
+void main() {
+    visibilityId = ((uDrawIndex + 1u) << 20) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,114 @@
+#version 440 core
+
+/*
+    Visibility buffer resolve. Every pixel covered by a captured triangle fetches that triangle from the arena,
+    intersects the pixel's view ray with it for the barycentrics, and writes the interpolated material to the
+    G-buffer just like the material shaders would. The depth was written by the visibility pass already.
+*/
+
+in vec2 texCoord;
+
+layout(location = 0) out vec4 gNormal;          // octahedral normal.xy + metallic + smoothness
+layout(location = 1) out vec4 gAlbedo;          // albedo.rgb + emissiveFactor
+layout(location = 2) out vec4 gEmissive;        // emissive.rgb + spare channel
+layout(location = 3) out vec4 gBakedIrradiance; // baked indirect diffuse.rgb + ambient occlusion
+
+uniform usampler2D uVisibility;
+uniform sampler2DArray uMaterialArray; // see vct/materialTextures.hpp
+uniform mat4 uInverseViewProj;
+
+const int FLOATS_PER_VERTEX = 9; // gl_Position.xyzw, normal.xyz, uvCoord.xy
+
+layout(std430, binding = 4) readonly buffer Arena {
+    float arena[];
+};
+
+layout(std430, binding = 5) readonly buffer Draws {
+    uvec4 draws[]; // first vertex, material, unused, unused
+};
+
+struct Material {
+    vec4 baseSmoothness; // base colour.rgb + smoothness
+    vec4 weights;        // texture rgb weight, texture green weight, metallic, material texture layer (-1 = none)
+};
+
+layout(std430, binding = 6) readonly buffer Materials {
+    Material materials[];
+};
+
+struct Vertex {
+    vec3 pos, nrm;
+    vec2 uv;
+};
+
+Vertex fetchVertex(uint index) {
+    int base = int(index) * FLOATS_PER_VERTEX;
+    Vertex v;
+    v.pos = vec3(arena[base], arena[base + 1], arena[base + 2]);
+    v.nrm = vec3(arena[base + 4], arena[base + 5], arena[base + 6]);
+    v.uv = vec2(arena[base + 7], arena[base + 8]);
+    return v;
+}
+
+// unit normal to the [0,1]^2 octahedral encoding of the G-buffer
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+// barycentrics (of v1 and v2) where the view ray through uv crosses the triangle's plane, Moller-Trumbore
+vec2 rayBarycentrics(vec2 uv, vec3 p0, vec3 p1, vec3 p2) {
+    vec4 nearPoint = uInverseViewProj * vec4(uv * 2.0 - 1.0, -1.0, 1.0);
+    vec4 farPoint = uInverseViewProj * vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+    vec3 origin = nearPoint.xyz / nearPoint.w;
+    vec3 direction = farPoint.xyz / farPoint.w - origin;
+
+    vec3 e1 = p1 - p0;
+    vec3 e2 = p2 - p0;
+    vec3 p = cross(direction, e2);
+    float det = dot(e1, p);
+    if (abs(det) < 1e-12) return vec2(1.0 / 3.0);
+    vec3 t = origin - p0;
+    vec3 q = cross(t, e1);
+    return vec2(dot(t, p), dot(direction, q)) / det;
+}
+
+vec4 sampleMaterialTexture(int layer, vec2 uv, vec2 dx, vec2 dy) {
+    // the layer is a texture coordinate, it may differ between neighbouring pixels
+    if (layer < 0) return vec4(0.0);
+    return textureGrad(uMaterialArray, vec3(uv, float(layer)), dx, dy);
+}
+
+void main() {
+    uint id = texelFetch(uVisibility, ivec2(gl_FragCoord.xy), 0).r;
+    if (id == 0u) discard;
+
+    uvec4 draw = draws[(id >> 20) - 1u];
+    uint firstVertex = draw.x + (id & 0xFFFFFu) * 3u;
+    Vertex v0 = fetchVertex(firstVertex);
+    Vertex v1 = fetchVertex(firstVertex + 1u);
+    Vertex v2 = fetchVertex(firstVertex + 2u);
+
+    // the neighbouring pixels' rays through the same plane give the uv footprint for filtering
+    vec2 pixel = 1.0 / vec2(textureSize(uVisibility, 0));
+    vec2 b = rayBarycentrics(texCoord, v0.pos, v1.pos, v2.pos);
+    vec2 bx = rayBarycentrics(texCoord + vec2(pixel.x, 0.0), v0.pos, v1.pos, v2.pos);
+    vec2 by = rayBarycentrics(texCoord + vec2(0.0, pixel.y), v0.pos, v1.pos, v2.pos);
+    vec3 w = vec3(1.0 - b.x - b.y, b);
+    vec3 wx = vec3(1.0 - bx.x - bx.y, bx);
+    vec3 wy = vec3(1.0 - by.x - by.y, by);
+
+    mat3x2 uvs = mat3x2(v0.uv, v1.uv, v2.uv);
+    vec2 uv = uvs * w;
+    vec3 normal = normalize(mat3(v0.nrm, v1.nrm, v2.nrm) * w);
+
+    Material m = materials[draw.y];
+    vec4 tex = sampleMaterialTexture(int(m.weights.w), uv, uvs * wx - uv, uvs * wy - uv);
+    vec3 albedo = m.baseSmoothness.rgb + tex.rgb * m.weights.x + vec3(tex.g * m.weights.y);
+
+    gNormal = vec4(octEncode(normal), m.weights.z, m.baseSmoothness.a);
+    gAlbedo = vec4(albedo, 0.0);
+    gEmissive = vec4(0.0);
+    gBakedIrradiance = vec4(0.0);
+}
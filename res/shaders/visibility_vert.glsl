@@ -0,0 +1,8 @@
+#version 440 core
+layout(location = 0) in vec4 aPosition; // captured world position, see visibilityBufferPass::capture
+
+uniform mat4 uViewProj;
+
+void main() {
+    gl_Position = uViewProj * vec4(aPosition.xyz, 1.0);
+}
@@ -0,0 +1,110 @@
+#version 440
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+/*
+    Amortised multi-bounce, one invocation per cell of the (coarse) bounce volume in the slab being updated.
+    Every occupied cell gathers irradiance with a few diffuse cones, the cones see the emissives and the bounce
+    volume itself, so each update adds a bounce. The stored radiance is albedo * irradiance * fraction, the
+    lighting pass adds it to the voxel emission wherever its cones hit geometry.
+*/
+
+layout(rgba16f, binding = 0) uniform writeonly image3D uBounceOut;
+uniform sampler3D voxelTex1;  // Normal.xyz + Smoothness
+uniform sampler3D voxelTex2;  // Albedo.rgb + EmissiveFactor
+uniform sampler3D uBounceTex; // the volume being written, earlier results are read for the feedback
+uniform int uBounceRes;
+uniform int uVoxelRes;
+uniform int uSliceOffset;
+uniform int uSliceCount;
+uniform float uMipLevelCount;
+uniform float uBounceMipOffset;  // log2(voxel res / bounce res)
+uniform sampler3D uDirectTex;    // injected direct light of the shadowed primary light
+uniform bool uDirectEnabled;
+uniform float uDirectMipOffset;
+uniform float uBounceFraction;
+uniform float uDiffuseBrightnessMultiplier;
+uniform int uNumCones;
+uniform float uConeAperture;
+uniform float uStepMultiplier;
+uniform float uMaxSteps;
+uniform float uTransmittanceNeededForConeTermination;
+
+void getTangentSpace(vec3 normal, out vec3 tangent, out vec3 bitangent) {
+    vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    tangent = normalize(cross(up, normal));
+    bitangent = cross(normal, tangent);
+}
+
+// traceCone of the lighting pass, in voxel texture coordinates
+vec3 traceCone(vec3 origin, vec3 direction) {
+    float voxelSize = 1.0 / float(uVoxelRes);
+    vec3 accumulatedColor = vec3(0.0);
+    float accumulatedAlpha = 0.0;
+    float distance = voxelSize * 2.0;
+
+    for (int i = 0; i < int(uMaxSteps); ++i) {
+        vec3 sampleCoord = origin + direction * distance;
+        if (any(lessThan(sampleCoord, vec3(0.0))) || any(greaterThan(sampleCoord, vec3(1.0))))
+            break;
+
+        float coneDiameter = max(voxelSize, distance * uConeAperture);
+        float mipLevel = clamp(log2(coneDiameter / voxelSize), 0.0, uMipLevelCount);
+        float occlusion = length(textureLod(voxelTex1, sampleCoord, mipLevel).xyz);
+
+        if (occlusion > 0.01) {
+            vec4 voxelData2 = textureLod(voxelTex2, sampleCoord, mipLevel);
+            vec3 light = voxelData2.rgb * voxelData2.a
+                + textureLod(uBounceTex, sampleCoord, max(mipLevel - uBounceMipOffset, 0.0)).rgb;
+            if (uDirectEnabled)
+                light += textureLod(uDirectTex, sampleCoord, max(mipLevel - uDirectMipOffset, 0.0)).rgb;
+
+            float transmittance = 1.0 - accumulatedAlpha;
+            accumulatedColor += light * occlusion * transmittance;
+            accumulatedAlpha += occlusion * transmittance;
+        }
+
+        if (accumulatedAlpha > (1.0 - uTransmittanceNeededForConeTermination))
+            break;
+
+        distance += coneDiameter * uStepMultiplier;
+    }
+    return accumulatedColor;
+}
+
+void main() {
+    if (int(gl_GlobalInvocationID.z) >= uSliceCount) return;
+    ivec3 cell = ivec3(gl_GlobalInvocationID) + ivec3(0, 0, uSliceOffset);
+    if (any(greaterThanEqual(cell, ivec3(uBounceRes)))) return;
+
+    vec3 coord = (vec3(cell) + 0.5) / float(uBounceRes);
+    vec3 averageNormal = textureLod(voxelTex1, coord, uBounceMipOffset).xyz;
+    float occlusion = length(averageNormal);
+    if (occlusion < 0.01) {
+        imageStore(uBounceOut, cell, vec4(0.0));
+        return;
+    }
+    vec3 normal = averageNormal / occlusion;
+    vec3 albedo = textureLod(voxelTex2, coord, uBounceMipOffset).rgb;
+
+    vec3 tangent, bitangent;
+    getTangentSpace(normal, tangent, bitangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+
+    // start outside the cell so the cones don't gather the surface they leave from
+    vec3 origin = coord + normal * (1.0 / float(uBounceRes));
+    vec3 irradiance = vec3(0.0);
+    int numCones = max(1, uNumCones);
+    for (int i = 0; i < numCones; ++i) {
+        // fixed cosine distributed spiral, the same directions every update so the result is stable
+        float u1 = (float(i) + 0.5) / float(numCones);
+        float phi = float(i) * 2.39996323; // golden angle
+        float r = sqrt(u1);
+        vec3 localDir = vec3(r * cos(phi), r * sin(phi), sqrt(max(0.0, 1.0 - u1)));
+        irradiance += traceCone(origin, TBN * localDir);
+    }
+    irradiance *= uDiffuseBrightnessMultiplier / float(numCones); // as the lighting pass would light the surface
+
+    // clamped so a multiplier tuned far too high can't make the feedback run away
+    vec3 radiance = min(albedo * irradiance * uBounceFraction, vec3(16.0));
+    imageStore(uBounceOut, cell, vec4(radiance, 1.0));
+}
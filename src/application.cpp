@@ -2,6 +2,7 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <random>
 
 // glm
 #include <glm/gtc/constants.hpp>
@@ -23,6 +24,7 @@
 
 #include "terrain/BaseTerrain.hpp"
 #include "terrain/WaterPlane.hpp"
+#include "simulation.hpp"
 #include <cubeRenderable.cpp>
 
 
@@ -36,6 +38,7 @@ int scene = 0;
 glm::vec3 lightPos;
 glm::vec3 lightScale;
 bool dirtyVoxels = true;
+bool bakeRequested = false; // baked after the voxels are refreshed
 Renderer* renderer = nullptr;
 
 // scene 0, (this is ugly but it works)
@@ -57,12 +60,44 @@ ExampleRenderable* exampleRenderable3 = nullptr;
 
 // shared
 PointLightRenderable* light = nullptr;
+Simulation simulation; // real-time erosion and plant growth, off the render thread
+
+// fireflies, analytic point lights scattered over the terrain
+std::vector<glm::vec3> fireflyAnchors;
+int fireflyCount = 256;
+float fireflyRadius = 1.5;
+float fireflyBrightness = 2;
+glm::vec3 fireflyColor = glm::vec3(1, 0.8, 0.3);
+float fireflyHover = 0.5;
+bool fireflyDrift = true;
+
+void updateFireflies(float time) {
+	auto& lights = renderer->clusterPass->lights;
+	lights.resize(fireflyAnchors.size());
+	for (size_t i = 0; i < fireflyAnchors.size(); i++) {
+		vec3 offset(0);
+		if (fireflyDrift) offset = vec3(sin(time * 0.7f + i * 1.3f), 0.5f * sin(time * 1.1f + i * 0.5f), cos(time * 0.9f + i * 2.1f)) * 0.3f;
+		lights[i].positionRadius = vec4(fireflyAnchors[i] + offset, fireflyRadius);
+		lights[i].color = vec4(fireflyColor * fireflyBrightness, 1);
+	}
+}
+
+void scatterFireflies() {
+	std::mt19937 rng(std::random_device{}());
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	fireflyAnchors.clear();
+	for (int i = 0; i < fireflyCount; i++)
+		fireflyAnchors.push_back(t_terrain->normalizedXZToWorldPos({ dist(rng), dist(rng) }) + vec3(0, fireflyHover, 0));
+	updateFireflies(0);
+}
 
 void resetScene() {
-	//for (int i = 0; i < renderer->renderables.size(); i++)   
-		//delete renderer->renderables.at(i);
-	// keep stuff in memory, otherwise things break, this is bad and ugly and terrible but thats okay...
-	renderer->renderables.clear();
+	// deletes what the last scene created, the plants belong to the plant manager and the terrain outlives the
+	// scene (its UI stays up), those are only unregistered
+	renderer->clearScene();
+	renderer->primaryLight->lightRenderable = nullptr;
+	renderer->clusterPass->lights.clear();
+	fireflyAnchors.clear();
 	dirtyVoxels = true;
 	renderer->lightingPass->setDefaultParams();
 }
@@ -71,13 +106,19 @@ void resetScene() {
 void loadScene0() {
 	resetScene();
 	scene = 0;
-	plantManager = plant::PlantManager(renderer);
+	plantManager = plant::PlantManager(renderer, &simulation);
 
+	delete t_terrain;
+	delete t_water;
 	t_terrain = new Terrain::BaseTerrain();
 	t_terrain->plant_manager = &plantManager;
+	t_terrain->simulation = &simulation;
+	t_terrain->lightmap_baker = &renderer->lightmapBaker;
 	t_water = new Terrain::WaterPlane();
 	t_terrain->water_plane = t_water;
 	light = new PointLightRenderable();
+	delete exampleRenderable;
+	delete exampleRenderable2;
 	exampleRenderable = new ExampleRenderable();
 	exampleRenderable2 = new ExampleRenderable();
 
@@ -99,7 +140,8 @@ void loadScene0() {
 	// add renderables
 	renderer->addRenderable(t_terrain);
 	renderer->addRenderable(t_water);
-	renderer->addRenderable(light);
+	renderer->addRenderable(light, true);
+	renderer->primaryLight->lightRenderable = light;
 	//renderer->addRenderable(exampleRenderable);
 	//renderer->addRenderable(exampleRenderable2);
 
@@ -181,14 +223,15 @@ void loadScene1() {
 	exampleRenderable3->modelTransform = glm::scale(exampleRenderable3->modelTransform, vec3(roomSize / 15));
 
 	// Add to renderer
-	renderer->addRenderable(floor1);
-	renderer->addRenderable(ceiling);
-	renderer->addRenderable(backWall);
-	renderer->addRenderable(leftWall);
-	renderer->addRenderable(rightWall);
-	renderer->addRenderable(light);
-	renderer->addRenderable(cube);
-	renderer->addRenderable(exampleRenderable3);
+	renderer->addRenderable(floor1, true);
+	renderer->addRenderable(ceiling, true);
+	renderer->addRenderable(backWall, true);
+	renderer->addRenderable(leftWall, true);
+	renderer->addRenderable(rightWall, true);
+	renderer->addRenderable(light, true);
+	renderer->primaryLight->lightRenderable = light;
+	renderer->addRenderable(cube, true);
+	renderer->addRenderable(exampleRenderable3, true);
 
 	// Configure voxelizer
 	renderer->voxelizer->setCenter(vec3(0, roomSize / 2, 0));
@@ -213,6 +256,19 @@ Application::Application(GLFWwindow* window) : m_window(window) {
 	loadScene0();
 }
 
+Application::Application(glm::ivec2 size, int sceneIndex) : m_windowsize(size), m_window(nullptr) {
+	renderer = new Renderer(size.x, size.y);
+
+	if (sceneIndex == 1) loadScene1();
+	else loadScene0();
+}
+
+void Application::setCamera(const glm::vec3& position, float pitch, float yaw) {
+	m_cameraPosition = position;
+	m_pitch = pitch;
+	m_yaw = yaw;
+}
+
 void Application::updateCameraMovement(float deltaTime) {
 	m_yaw = std::clamp(m_yaw, -pi<float>(), pi<float>());
 	// Calculate forward and right directions
@@ -245,16 +301,20 @@ void Application::render() {
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
 	lastTime = currentTime;
-
-	updateCameraMovement(deltaTime);
-	int width, height;
-	glfwGetFramebufferSize(m_window, &width, &height);
-	if (width != m_windowsize.x || height != m_windowsize.y) {
-		m_windowsize = vec2(width, height); // update window size
-		onWindowResize();
+	cgra::gl_state::begin_frame();
+
+	// headless keeps its size and the camera it was given
+	int width = int(m_windowsize.x), height = int(m_windowsize.y);
+	if (m_window) {
+		updateCameraMovement(deltaTime);
+		glfwGetFramebufferSize(m_window, &width, &height);
+		if (width != m_windowsize.x || height != m_windowsize.y) {
+			m_windowsize = vec2(width, height); // update window size
+			onWindowResize();
+		}
 	}
 
-	glViewport(0, 0, width, height); // set the viewport to draw to the entire window
+	cgra::gl_state::viewport(0, 0, width, height); // set the viewport to draw to the entire window
 
 	// clear the back-buffer
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -270,11 +330,31 @@ void Application::render() {
 		* translate(mat4(1), -m_cameraPosition);
 
 
-	if (dirtyVoxels) {
+	// programs that finished linking in the background, the scene shows their renderables from now on
+	cgra::shader_builder::poll();
+	auto& programs = cgra::shader_builder::stats();
+	static int reportedPending = -1; // the first frame reports too
+	if (programs.pending == 0 && reportedPending != 0)
+		cout << "Programs ready " << programs.ready_ms << " ms after the first was submitted (" << programs.compiled << " linked from source, " << programs.loaded << " from the binary cache)" << endl;
+	reportedPending = programs.pending;
+
+	// the simulation thread's latest results, only uploaded here
+	if (t_terrain) t_terrain->updateErosion();
+	if (plantManager.update()) renderer->visibility->markDirty();
+
+	if (dirtyVoxels || renderer->voxelsStale()) {
 		renderer->refreshVoxels(view, proj);
 		dirtyVoxels = false;
 	}
+	if (!fireflyAnchors.empty()) updateFireflies(m_window ? float(glfwGetTime()) : m_time);
 
+	if (bakeRequested) {
+		renderer->bakeStaticGI();
+		bakeRequested = false;
+	}
+
+	renderer->primaryLight->params.position = lightPos;
+	renderer->primaryLight->params.color = light->lightColor;
 	renderer->render(view, proj);
 }
 
@@ -310,6 +390,35 @@ void Application::renderGUI() {
 		ImGui::SliderFloat("Contrast", &renderer->lightingPass->params.uContrast, 0, 2);
 
 	}
+	if (ImGui::CollapsingHeader("Shadowed direct light", ImDrawFlags_Closed)) {
+		auto& shadowed = renderer->primaryLight->params;
+		// the light leaves the voxels while it is shadowed analytically
+		if (ImGui::Checkbox("Shadow mapped main light", &shadowed.enabled)) { dirtyVoxels = true; }
+		ImGui::SliderFloat("Direct intensity", &shadowed.intensity, 0, 2000);
+		ImGui::SliderFloat("Direct radius", &shadowed.radius, 1, 200);
+		ImGui::SliderFloat("Shadow bias", &shadowed.shadowBias, 0, 0.5);
+		ImGui::SliderInt("Shadow face resolution", &shadowed.shadowResolution, 128, 2048);
+		ImGui::SliderInt("Injection resolution", &shadowed.injectResolution, 16, 256);
+		ImGui::Text("Last shadow update %.3f ms", renderer->primaryLight->getLastUpdateMs());
+	}
+	if (ImGui::CollapsingHeader("Point lights", ImDrawFlags_Closed)) {
+		auto& clusters = renderer->clusterPass->params;
+		ImGui::Checkbox("Clustered point lights", &clusters.enabled);
+		ImGui::SliderInt("Max lights per cluster", &clusters.maxLightsPerCluster, 8, 256);
+		ImGui::SliderInt("Depth slices", &clusters.gridZ, 4, 64);
+		ImGui::Text("%d lights, culling %.3f ms", (int)renderer->clusterPass->lights.size(), renderer->clusterPass->getPassMs());
+		if (scene == 0) {
+			ImGui::SliderInt("Firefly count", &fireflyCount, 1, clusteredLightPass::MAX_LIGHTS);
+			ImGui::SliderFloat("Firefly radius", &fireflyRadius, 0.1, 10);
+			ImGui::SliderFloat("Firefly brightness", &fireflyBrightness, 0, 50);
+			ImGui::ColorEdit3("Firefly color", &fireflyColor[0]);
+			ImGui::SliderFloat("Firefly hover height", &fireflyHover, 0, 5);
+			ImGui::Checkbox("Firefly drift", &fireflyDrift);
+			if (ImGui::Button("Scatter fireflies")) { scatterFireflies(); }
+			ImGui::SameLine();
+		}
+		if (ImGui::Button("Clear point lights")) { fireflyAnchors.clear(); renderer->clusterPass->lights.clear(); }
+	}
 	if (ImGui::CollapsingHeader("Sky settings", ImDrawFlags_Closed)) {
 		ImGui::SliderFloat3("Horizon color", &renderer->lightingPass->params.uHorizonColor[0], 0, 1);
 		ImGui::SliderFloat3("Zenith color", &renderer->lightingPass->params.uZenithColor[0], 0, 1);
@@ -328,9 +437,153 @@ void Application::renderGUI() {
 		ImGui::SliderFloat("Reflection cone aperature", &renderer->lightingPass->params.uReflectionAperture, 0, 1);
 		ImGui::SliderFloat("Cone max steps", &renderer->lightingPass->params.uMaxSteps, 0, 1024);
 	}
+	if (ImGui::CollapsingHeader("Multi-bounce settings", ImDrawFlags_Closed)) {
+		ImGui::Checkbox("Multi-bounce GI", &renderer->bounce->params.enabled);
+		ImGui::SliderFloat("Bounce fraction", &renderer->bounce->params.fraction, 0, 1);
+		ImGui::SliderInt("Bounce volume resolution", &renderer->bounce->params.resolution, 16, 128);
+		ImGui::SliderInt("Bounce slices per frame", &renderer->bounce->params.slicesPerFrame, 1, 64);
+		ImGui::SliderInt("Bounce cones", &renderer->bounce->params.numCones, 1, 16);
+		if (ImGui::Button("Reset bounces")) { renderer->bounce->clear(); }
+		ImGui::Text("Bounce pass %.3f ms", renderer->bounce->getPassMs());
+	}
+	if (ImGui::CollapsingHeader("Screen space GI settings", ImDrawFlags_Closed)) {
+		ImGui::Checkbox("Screen space near field GI", &renderer->ssgi->params.enabled);
+		ImGui::SliderFloat("Near / far handoff distance", &renderer->ssgi->params.handoffDistance, 0.05, 5);
+		ImGui::SliderInt("SSGI directions", &renderer->ssgi->params.directions, 1, 16);
+		ImGui::SliderInt("SSGI steps", &renderer->ssgi->params.steps, 1, 32);
+		ImGui::SliderFloat("SSGI strength", &renderer->ssgi->params.strength, 0, 4);
+		ImGui::Text("SSGI pass %.3f ms", renderer->ssgi->getPassMs());
+	}
+	if (ImGui::CollapsingHeader("Denoiser settings", ImDrawFlags_Closed)) {
+		ImGui::Checkbox("Denoise indirect diffuse", &renderer->denoisePass->params.enabled);
+		ImGui::SliderInt("Denoise iterations", &renderer->denoisePass->params.iterations, 1, 6);
+		ImGui::SliderFloat("Denoise normal sigma", &renderer->denoisePass->params.sigmaNormal, 1, 256);
+		ImGui::SliderFloat("Denoise position sigma", &renderer->denoisePass->params.sigmaPosition, 0.01, 5);
+		ImGui::SliderFloat("Denoise luminance sigma", &renderer->denoisePass->params.sigmaLuminance, 0.1, 20);
+		ImGui::Text("Denoise pass %.3f ms", renderer->denoisePass->getPassMs());
+	}
+	if (ImGui::CollapsingHeader("Tracer statistics", ImDrawFlags_Closed)) {
+		auto& stats = renderer->tracerStats;
+		ImGui::Checkbox("Collect tracer statistics", &stats.params.enabled);
+		ImGui::Checkbox("Steps heatmap", &stats.params.heatmap);
+		ImGui::SliderFloat("Heatmap max steps", &stats.params.heatmapMaxSteps, 64, 16384, "%.0f", ImGuiSliderFlags_Logarithmic);
+		auto& summary = stats.getSummary();
+		ImGui::Text("%u cones, %.1f per pixel, %.1f steps per cone", summary.cones, summary.conesPerPixel, summary.meanStepsPerCone);
+		ImGui::Text("Occluded %.1f%%, left volume %.1f%%, max steps %.1f%%", summary.occludedPercent, summary.leftVolumePercent, summary.maxStepsPercent);
+		ImGui::PlotHistogram("Mean steps per cone", stats.getStepHistogram().data(), TracerStats::STEP_BUCKETS, 0, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+		ImGui::PlotHistogram("Max mip", stats.getMipHistogram().data(), TracerStats::MIP_BUCKETS, 0, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+		static char statsPath[256] = "tracer_stats_dump.csv";
+		ImGui::InputText("Dump path", statsPath, sizeof(statsPath));
+		if (ImGui::Button("Dump CSV")) { stats.dumpCsv(statsPath); }
+		ImGui::Checkbox("Log every frame", &stats.params.logToFile);
+		static char statsLogPath[256] = "tracer_stats.csv";
+		if (ImGui::InputText("Stats log path", statsLogPath, sizeof(statsLogPath))) { stats.params.logPath = statsLogPath; }
+	}
+	if (ImGui::CollapsingHeader("Culling", ImDrawFlags_Closed)) {
+		auto& culling = *renderer->culling;
+		ImGui::Checkbox("Frustum culling", &culling.params.frustumEnabled);
+		ImGui::Checkbox("Occlusion culling", &culling.params.occlusionEnabled);
+		ImGui::SliderInt("Occlusion read back size", &culling.params.readbackSize, 16, 256);
+		ImGui::Text("%d tested, %d visible", culling.getTested(), culling.getVisible());
+		ImGui::Text("%d outside the frustum, %d occluded", culling.getFrustumCulled(), culling.getOcclusionCulled());
+	}
+	if (ImGui::CollapsingHeader("Multi draw", ImDrawFlags_Closed)) {
+		auto& arena = *renderer->arena;
+		ImGui::Checkbox("Multi draw indirect", &arena.params.enabled);
+		auto& arenaStats = arena.getStats();
+		ImGui::Text("%d meshes, %d vertices, %d indices in the arena", arenaStats.meshes, arenaStats.vertices, arenaStats.indices);
+		ImGui::Text("%d draws in %d calls, %d repacks", arenaStats.draws, arenaStats.drawCalls, arenaStats.rebuilds);
+		auto& queueStats = renderer->queue.getStats();
+		ImGui::Text("Prepass queue: %d draws", queueStats.draws);
+		ImGui::Text("Program switches %d (unsorted %d)", queueStats.programSwitches, queueStats.unsortedProgramSwitches);
+		ImGui::Text("Material changes %d (unsorted %d)", queueStats.textureSwitches, queueStats.unsortedTextureSwitches);
+		auto& materials = MaterialTextures::get();
+		ImGui::Text("Material array: %d layers for %d loads, %.1f MB", materials.getLayers(), materials.getRequests(),
+			materials.getBytes() / (1024.0 * 1024.0));
+	}
+	if (ImGui::CollapsingHeader("Visibility buffer", ImDrawFlags_Closed)) {
+		ImGui::Checkbox("Visibility buffer plants", &renderer->visibility->params.enabled);
+		ImGui::Text("%d draws, %d triangles, %.3f ms", renderer->visibility->getDrawCount(),
+			renderer->visibility->getTriangleCount(), renderer->visibility->getPassMs());
+	}
+	if (ImGui::CollapsingHeader("Temporal upscaling", ImDrawFlags_Closed)) {
+		ImGui::Checkbox("Temporal upscaling", &renderer->upscalePass->params.enabled);
+		float scale = renderer->getRenderScale();
+		if (ImGui::SliderFloat("Upscale render scale", &scale, 0.5, 1, "%.2f")) { renderer->setRenderScale(scale); }
+		ImGui::SliderFloat("History feedback", &renderer->upscalePass->params.feedback, 0.5, 0.98);
+		ImGui::SliderFloat("History clamp", &renderer->upscalePass->params.clampGamma, 0.5, 3);
+		ImGui::SliderFloat("Sharpen", &renderer->upscalePass->params.sharpness, 0, 1);
+		ImGui::Text("Rendering %dx%d, output %dx%d, upscale %.3f ms", renderer->renderWidth, renderer->renderHeight,
+			renderer->windowWidth, renderer->windowHeight, renderer->upscalePass->getPassMs());
+	}
+	if (ImGui::CollapsingHeader("Render graph", ImDrawFlags_Closed)) {
+		auto& graphStats = renderer->graph.getStats();
+		ImGui::Text("%d passes, %d culled, %d barriers", graphStats.passes, graphStats.culledPasses, graphStats.barriers);
+		ImGui::Text("%d transient textures on %d pooled", graphStats.transientTextures, graphStats.physicalTextures);
+		ImGui::Text("Peak transient memory %.2f MB (%.2f MB unaliased)", graphStats.peakTransientBytes / (1024.0 * 1024.0),
+			graphStats.unaliasedTransientBytes / (1024.0 * 1024.0));
+		ImGui::Text("Pool holds %.2f MB", graphStats.pooledBytes / (1024.0 * 1024.0));
+		for (auto& pass : renderer->graph.getPassLog())
+			ImGui::BulletText("%s", pass.c_str());
+	}
+	if (ImGui::CollapsingHeader("GL state", ImDrawFlags_Closed)) {
+		static const char* kinds[] = { "Program", "Vertex array", "Texture", "Framebuffer", "Viewport", "Enable / disable" };
+		auto& counts = cgra::gl_state::last_frame();
+		int issued = 0, skipped = 0;
+		for (int k = 0; k < cgra::gl_state::KIND_COUNT; k++) {
+			ImGui::Text("%s: %d issued, %d skipped", kinds[k], counts.issued[k], counts.skipped[k]);
+			issued += counts.issued[k];
+			skipped += counts.skipped[k];
+		}
+		ImGui::Text("Total: %d issued, %d skipped", issued, skipped);
+		auto& programs = cgra::shader_builder::stats();
+		ImGui::Text("Programs: %d linked from source, %d from the binary cache, %d shared", programs.compiled, programs.loaded, programs.shared);
+		ImGui::Text("%d linking (%s), %d failed, all ready %.0f ms after the first was submitted", programs.pending,
+			programs.parallel ? "in parallel" : "no KHR_parallel_shader_compile", programs.failed, programs.ready_ms);
+		ImGui::Text("Renderables waiting for their program: %d", int(renderer->scene.getWaiting()));
+	}
+	if (ImGui::CollapsingHeader("Frame budget controller", ImDrawFlags_Closed)) {
+		auto& budget = renderer->budgetController.params;
+		ImGui::Checkbox("Enable frame budget controller", &budget.enabled);
+		ImGui::SliderFloat("Target GPU ms", &budget.targetMs, 2, 50);
+		ImGui::SliderFloat("Tolerance", &budget.tolerance, 0.01, 0.5);
+		ImGui::SliderInt("Cooldown frames", &budget.cooldownFrames, 4, 60);
+		ImGui::DragFloatRange2("Render scale bounds", &budget.minRenderScale, &budget.maxRenderScale, 0.01, 0.25, 1);
+		ImGui::DragIntRange2("Diffuse cone bounds", &budget.minDiffuseCones, &budget.maxDiffuseCones, 1, 1, 128);
+		ImGui::DragFloatRange2("Max steps bounds", &budget.minMaxSteps, &budget.maxMaxSteps, 1, 8, 1024);
+		ImGui::DragFloatRange2("Step multiplier bounds", &budget.minStepMultiplier, &budget.maxStepMultiplier, 0.01, 0.05, 2);
+		float scale = renderer->getRenderScale();
+		if (ImGui::SliderFloat("Render scale", &scale, 0.25, 1)) { renderer->setRenderScale(scale); }
+		ImGui::Text("GPU prepass %.3f ms, lighting %.3f ms", renderer->prepassTimer.getSmoothedMs(), renderer->lightingTimer.getSmoothedMs());
+		ImGui::Checkbox("Log decisions to file", &budget.logToFile);
+		static char logPath[256] = "frame_budget_log.csv";
+		if (ImGui::InputText("Log path", logPath, sizeof(logPath))) { budget.logPath = logPath; }
+		ImGui::TextUnformatted("frame,prepass,lighting,denoise,total,target,action,scale,cones,steps,step mult");
+		for (auto& decision : renderer->budgetController.getRecentDecisions())
+			ImGui::TextUnformatted(decision.c_str());
+	}
+	if (ImGui::CollapsingHeader("Static GI bake", ImDrawFlags_Closed)) {
+		auto& bake = renderer->lightmapBaker.params;
+		ImGui::Checkbox("Use baked GI", &renderer->lightingPass->params.uUseBakedGI);
+		ImGui::SliderInt("Lightmap resolution", &bake.resolution, 128, 4096);
+		ImGui::SliderInt("Bake diffuse cones", &bake.numDiffuseCones, 8, 512);
+		if (ImGui::Button("Bake static GI")) { bakeRequested = true; }
+		ImGui::SameLine();
+		if (ImGui::Button("Clear bake")) { renderer->lightmapBaker.clear(renderer->scene.getObjects()); }
+		static char bakePath[256] = "lightmaps.bin";
+		if (ImGui::InputText("Bake path", bakePath, sizeof(bakePath))) { bake.path = bakePath; }
+		if (ImGui::Button("Save bake")) { renderer->lightmapBaker.save(bake.path); }
+		ImGui::SameLine();
+		if (ImGui::Button("Load bake")) { renderer->lightmapBaker.load(bake.path, renderer->scene.getObjects()); }
+		ImGui::Text("%d lightmaps, last bake %.1f ms", (int)renderer->lightmapBaker.getLightmapCount(), renderer->lightmapBaker.getLastBakeMs());
+	}
 	if (ImGui::CollapsingHeader("Reflection blending settings", ImDrawFlags_Closed)) {
 		ImGui::SliderFloat("Reflection blend lower bound", &renderer->lightingPass->params.uReflectionBlendLowerBound, 0, 1);
 		ImGui::SliderFloat("Reflection blend upper bound", &renderer->lightingPass->params.uReflectionBlendUpperBound, 0, 1);
+		ImGui::Checkbox("Screen space reflections", &renderer->lightingPass->params.uSSREnabled);
+		ImGui::SliderInt("SSR max iterations", &renderer->lightingPass->params.uSSRMaxIterations, 8, 256);
+		ImGui::SliderFloat("SSR max distance", &renderer->lightingPass->params.uSSRMaxDistance, 1, 200);
+		ImGui::SliderFloat("SSR thickness", &renderer->lightingPass->params.uSSRThickness, 0.01f, 5);
 	}
 
 	ImGui::Separator();
@@ -343,12 +596,18 @@ void Application::renderGUI() {
 		if (ImGui::Button("Gbuffer show albedo as RGB")) { renderer->debug_params.debug_channel_index = 5; }
 		if (ImGui::Button("Gbuffer show emissive factor as RGB")) { renderer->debug_params.debug_channel_index = 6; }
 		if (ImGui::Button("Gbuffer show emissive colorf as RGB")) { renderer->debug_params.debug_channel_index = 7; }
-		if (ImGui::Button("Gbuffer show 'spare channel' as RGB")) { renderer->debug_params.debug_channel_index = 8; }
+		if (ImGui::Button("Gbuffer show 'spare channel' (baked GI) as RGB")) { renderer->debug_params.debug_channel_index = 8; }
 		if (ImGui::Button("Gbuffer show voxel sampled position as RGB")) { renderer->debug_params.debug_channel_index = 9; }
 	}
 
 	ImGui::Separator();
 	if (ImGui::CollapsingHeader("Voxel settings", ImDrawFlags_Closed)) {
+		static const int voxelResolutions[] = { 128, 256, 512 };
+		int resolutionIndex = renderer->voxelizer->m_params.resolution <= 128 ? 0 : renderer->voxelizer->m_params.resolution <= 256 ? 1 : 2;
+		if (ImGui::Combo("Voxel resolution", &resolutionIndex, "128\0" "256\0" "512\0")) {
+			renderer->voxelizer->setResolution(voxelResolutions[resolutionIndex]);
+			dirtyVoxels = true;
+		}
 		ImGui::Checkbox("Voxel conservative rasterization", &renderer->voxelizer->m_params.conservativeRaster);
 		ImGui::SliderInt("Voxelization render resolution", &renderer->voxelizer->m_params.voxelizeRes, 64, 7680);
 		ImGui::SliderInt("Voxel splat radius", &renderer->voxelizer->m_params.voxelSplatRadius, 0, 5);
@@ -375,8 +634,12 @@ void Application::renderGUI() {
 		if (ImGui::Checkbox("Draw Plants", &planttt)) {
 			dirtyVoxels = true;
 		}
+		if (ImGui::Checkbox("Instanced plants", &plantManager.instanced)) {
+			plantManager.refresh();
+			dirtyVoxels = true;
+		}
 		if (ImGui::Button("GROW")) {
-			plantManager.grow();
+			plantManager.grow(); // taken over by render() once the simulation thread is done
 		}
 	};
 	if (scene == 0) t_terrain->plantUI(f);
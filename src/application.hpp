@@ -21,6 +21,7 @@ private:
 	float m_pitch = .86;
 	float m_yaw = -.86;
 	glm::vec3 m_cameraPosition = glm::vec3(5);
+	float m_time = 0;
 
 	// last input
 	bool m_leftMouseDown = false;
@@ -34,12 +35,17 @@ private:
 public:
 	// setup
 	Application(GLFWwindow *);
+	// headless, there is no window or input, the size is fixed and the camera is set with setCamera
+	Application(glm::ivec2 size, int scene);
 
 	// disable copy constructors (for safety)
 	Application(const Application&) = delete;
 	Application& operator=(const Application&) = delete;
 
 	void updateCameraMovement(float deltaTime);
+	void setCamera(const glm::vec3 &position, float pitch, float yaw);
+	// scene time the animations (fireflies) are at when headless, windowed uses the GLFW clock
+	void setTime(float seconds) { m_time = seconds; }
 	void render();
 	void onWindowResize();
 	void renderGUI();
@@ -394,6 +394,8 @@ namespace cgra {
 		void render() {
 			ImGui::Render();
 			renderDrawLists(ImGui::GetDrawData());
+			// the draw lists set GL state behind the state cache's back
+			gl_state::invalidate();
 		}
 
 		void shutdown() {
@@ -49,8 +49,8 @@ namespace cgra {
 			assert(size.x * size.y * 4 == data.size()); // check we have consistent size and data
 
 			if (!tex) glGenTextures(1, &tex);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, tex);
+			gl_state::active_texture(GL_TEXTURE0);
+			gl_state::bind_texture(GL_TEXTURE_2D, tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap.x);
@@ -83,7 +83,7 @@ namespace cgra {
 		static rgba_image screenshot(bool write) {
 			using namespace std;
 			int w, h;
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
 			glfwGetFramebufferSize(glfwGetCurrentContext(), &w, &h);
 
 			rgba_image img(w, h);
@@ -14,14 +14,14 @@ namespace cgra {
 	void gl_mesh::draw() {
 		if (vao == 0) return;
 		// bind our VAO which sets up all our buffers and data for us
-		glBindVertexArray(vao);
+		gl_state::bind_vertex_array(vao);
 		// tell opengl to draw our VAO using the draw mode and how many verticies to render
 		glDrawElements(mode, index_count, GL_UNSIGNED_INT, 0);
 	}
 
 	void gl_mesh::destroy() {
 		// delete the data buffers
-		glDeleteVertexArrays(1, &vao);
+		gl_state::delete_vertex_arrays(1, &vao);
 		glDeleteBuffers(1, &vbo);
 		glDeleteBuffers(1, &ibo);
 	}
@@ -37,7 +37,7 @@ namespace cgra {
 
 		// VAO
 		//
-		glBindVertexArray(m.vao);
+		gl_state::bind_vertex_array(m.vao);
 
 		
 		// VBO (single buffer, interleaved)
@@ -72,7 +72,7 @@ namespace cgra {
 		m.mode = mode;
 
 		// clean up by binding VAO 0 (good practice)
-		glBindVertexArray(0);
+		gl_state::bind_vertex_array(0);
 
 		return m;
 	}
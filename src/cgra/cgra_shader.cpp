@@ -1,15 +1,26 @@
 
 // std
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 // project
 #include "cgra_shader.hpp"
 #include <opengl.hpp>
 
+// KHR_parallel_shader_compile is newer than the GLEW this builds with, ARB_parallel_shader_compile uses the same value
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 
 // forward declaration
 class shader_error : public std::runtime_error {
@@ -60,6 +71,179 @@ void printProgramInfoLog(GLuint obj) {
 }
 
 
+namespace {
+
+	struct program_entry {
+		GLuint program;
+		int uses;
+	};
+
+	// submitted, still compiling or linking
+	struct pending_program {
+		uint64_t key;
+		std::map<GLenum, std::string> names; // of the stages, for errors
+	};
+
+	using build_clock = std::chrono::steady_clock;
+
+	struct program_cache {
+		std::string directory = "shader_cache";
+		std::unordered_map<uint64_t, program_entry> programs; // linked this run, by key
+		std::unordered_map<GLuint, pending_program> pending;
+		// submitted programs that didn't compile or link, with the error. They aren't deleted before they are
+		// released, so their id isn't handed out again while renderables still hold it
+		std::unordered_map<GLuint, std::exception_ptr> failed;
+		cgra::shader_builder::cache_stats stats;
+		build_clock::time_point first_submit;
+		std::string driver; // read when the first program is built, there is no context before
+		bool binaries = false; // the driver has a binary format
+		bool parallel = false; // the driver compiles in the background and can be asked if it is done
+	};
+
+	program_cache & cache() {
+		static program_cache c;
+		if (c.driver.empty()) {
+			for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+				const GLubyte *s = glGetString(name);
+				c.driver += s ? (const char *) s : "?";
+				c.driver += '\n';
+			}
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			c.binaries = formats > 0;
+			GLint extensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+			for (GLint i = 0; i < extensions; i++) {
+				const char *e = (const char *) glGetStringi(GL_EXTENSIONS, i);
+				if (e && (!strcmp(e, "GL_KHR_parallel_shader_compile") || !strcmp(e, "GL_ARB_parallel_shader_compile"))) c.parallel = true;
+			}
+			c.stats.parallel = c.parallel;
+		}
+		return c;
+	}
+
+	// FNV-1a, 64 bit
+	uint64_t hash(uint64_t h, const void *data, size_t size) {
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; i++) {
+			h ^= bytes[i];
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+
+	uint64_t hash(uint64_t h, const std::string &s) {
+		// the size too, so the strings can't run into each other
+		size_t size = s.size();
+		return hash(hash(h, &size, sizeof(size)), s.data(), s.size());
+	}
+
+	std::string binary_path(uint64_t key) {
+		std::ostringstream path;
+		path << cache().directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return path.str();
+	}
+
+	// checks the compile and link status of what shader_builder::start_link() started, the stage names are only
+	// for the error message
+	void finish_link(GLuint program, const std::map<GLenum, std::string> &names) {
+		int shader_count = 0;
+		glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count);
+		std::vector<GLuint> shaders(shader_count);
+		int actual_shader_count = 0;
+		if (shader_count > 0) glGetAttachedShaders(program, shader_count, &actual_shader_count, shaders.data());
+
+		// check compilation status
+		for (int i = 0; i < actual_shader_count; i++) {
+			GLint compile_status;
+			glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compile_status);
+			printShaderInfoLog(shaders[i]); // print warnings and errors
+			if (!compile_status) {
+				GLint type = 0;
+				glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+				auto name = names.find(GLenum(type));
+				if (name != names.end() && !name->second.empty()) std::cerr << "Error: Could not compile " << name->second << std::endl;
+				throw shader_compile_error();
+			}
+		}
+
+		// check link status
+		GLint link_status;
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+		printProgramInfoLog(program); // print warnings and errors
+		if (!link_status) throw shader_link_error();
+	}
+
+	constexpr uint32_t BINARY_MAGIC = 0x42505243; // "CRPB"
+
+	bool load_binary(GLuint program, uint64_t key) {
+		program_cache &c = cache();
+		if (c.directory.empty() || !c.binaries) return false;
+		std::ifstream file(binary_path(key), std::ios::binary);
+		if (!file) return false;
+
+		uint32_t magic = 0;
+		GLenum format = 0;
+		uint32_t size = 0;
+		file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+		file.read(reinterpret_cast<char *>(&format), sizeof(format));
+		file.read(reinterpret_cast<char *>(&size), sizeof(size));
+		if (!file || magic != BINARY_MAGIC || size == 0) return false;
+		std::vector<char> binary(size);
+		if (!file.read(binary.data(), size)) return false;
+
+		glProgramBinary(program, format, binary.data(), GLsizei(size));
+		GLint link_status = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+		return link_status;
+	}
+
+	void save_binary(GLuint program, uint64_t key) {
+		program_cache &c = cache();
+		if (c.directory.empty() || !c.binaries) return;
+		GLint size = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+		if (size <= 0) return;
+		std::vector<char> binary(size);
+		GLenum format = 0;
+		glGetProgramBinary(program, size, nullptr, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(c.directory, error);
+		std::ofstream file(binary_path(key), std::ios::binary);
+		if (!file) {
+			std::cerr << "Warning: Could not write the program binary to " << binary_path(key) << std::endl;
+			return;
+		}
+		uint32_t magic = BINARY_MAGIC;
+		uint32_t length = uint32_t(size);
+		file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+		file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+		file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+		file.write(binary.data(), size);
+	}
+
+	// a submitted program the driver has finished with, throws if it failed and remembers the error
+	void finish(GLuint program) {
+		program_cache &c = cache();
+		auto it = c.pending.find(program);
+		pending_program pending = std::move(it->second);
+		c.pending.erase(it);
+		try {
+			finish_link(program, pending.names);
+		}
+		catch (shader_error &) {
+			c.failed[program] = std::current_exception();
+			throw;
+		}
+		save_binary(program, pending.key);
+		c.stats.compiled++;
+		if (c.pending.empty()) c.stats.ready_ms = std::chrono::duration<float, std::milli>(build_clock::now() - c.first_submit).count();
+	}
+
+}
+
+
 namespace cgra {
 
 	void shader_builder::set_shader(GLenum type, const std::string &filename) {
@@ -73,21 +257,13 @@ namespace cgra {
 		std::stringstream buffer;
 		buffer << fileStream.rdbuf();
 
-		try {
-			set_shader_source(type, buffer.str());
-		}
-		catch (shader_compile_error &e) {
-			std::cerr << "Error: Could not compile " << filename << std::endl;
-			throw e;
-		}
+		set_shader_source(type, buffer.str());
+		m_stages[type].name = filename;
 	}
 
 
 	void shader_builder::set_shader_source(GLenum type, const std::string &source) {
 
-		// same as GLint shader = glCreateShader(type);
-		gl_object shader = gl_object::gen_shader(type);
-
 		// cgra specific extra (allows different shaders to be defined in a single source)
 		// Start of CGRA addition
 		//
@@ -103,6 +279,8 @@ namespace cgra {
 				return "_TESS_EVALUATION_";
 			case GL_FRAGMENT_SHADER:
 				return "_FRAGMENT_";
+			case GL_COMPUTE_SHADER:
+				return "_COMPUTE_";
 			default:
 				return "_INVALID_SHADER_TYPE_";
 			}
@@ -119,29 +297,76 @@ namespace cgra {
 		}
 		oss << "#define " << get_define(type) << std::endl;
 		oss << iss.rdbuf();
-		std::string final_source = oss.str();
 		//
 		// End of CGRA addition
 
-		// upload and compile the shader
-		const char *text_c = final_source.c_str();
-		glShaderSource(shader, 1, &text_c, nullptr);
-		glCompileShader(shader);
+		// compiled by build(), if at all
+		m_stages[type] = { oss.str(), "" };
+	}
 
-		// check compilation status
-		GLint compile_status;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-		printShaderInfoLog(shader); // print warnings and errors
-		if (!compile_status) throw shader_compile_error();
 
-		m_shaders[type] = std::make_shared<gl_object>(std::move(shader));
+	void shader_builder::set_transform_feedback_varyings(const std::vector<std::string> &varyings, GLenum buffer_mode) {
+		m_varyings = varyings;
+		m_buffer_mode = buffer_mode;
+	}
+
+
+	uint64_t shader_builder::key() const {
+		uint64_t h = hash(14695981039346656037ull, cache().driver);
+		for (auto &stage_pair : m_stages) {
+			h = hash(h, &stage_pair.first, sizeof(stage_pair.first));
+			h = hash(h, stage_pair.second.source);
+		}
+		for (auto &varying : m_varyings) h = hash(h, varying);
+		return hash(h, &m_buffer_mode, sizeof(m_buffer_mode));
+	}
+
+
+	GLuint shader_builder::submit() {
+		program_cache &c = cache();
+		if (c.first_submit == build_clock::time_point()) c.first_submit = build_clock::now();
+		uint64_t k = key();
+		auto it = c.programs.find(k);
+		if (it != c.programs.end()) {
+			it->second.uses++;
+			c.stats.shared++;
+			return it->second.program;
+		}
+
+		GLuint program = glCreateProgram();
+		if (load_binary(program, k)) {
+			c.stats.loaded++;
+			if (c.pending.empty()) c.stats.ready_ms = std::chrono::duration<float, std::milli>(build_clock::now() - c.first_submit).count();
+		}
+		else {
+			c.pending[program] = { k, start_link(program) };
+		}
+		c.programs[k] = { program, 1 };
+		return program;
 	}
 
 
 	GLuint shader_builder::build(GLuint program) {
+		if (program) {
+			finish_link(program, start_link(program));
+			return program;
+		}
+		program = submit();
+		try {
+			wait(program);
+		}
+		catch (shader_error &) {
+			release(program); // the caller never gets it
+			throw;
+		}
+		return program;
+	}
+
+
+	std::map<GLenum, std::string> shader_builder::start_link(GLuint program) const {
 
 		// if the program exists get attached shaders and detach them
-		if (program) {
+		{
 			int shader_count = 0;
 			glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count);
 
@@ -154,25 +379,106 @@ namespace cgra {
 				}
 			}
 		}
-		else {
-			program = glCreateProgram();
+
+		// compile and attach shaders, nothing waits on the compile. They are deleted with the program
+		std::map<GLenum, std::string> names;
+		for (auto &stage_pair : m_stages) {
+			// same as GLint shader = glCreateShader(type);
+			gl_object shader = gl_object::gen_shader(stage_pair.first);
+
+			// upload and compile the shader
+			const char *text_c = stage_pair.second.source.c_str();
+			glShaderSource(shader, 1, &text_c, nullptr);
+			glCompileShader(shader);
+
+			glAttachShader(program, shader);
+			names[stage_pair.first] = stage_pair.second.name;
 		}
 
-		// attach shaders
-		for (auto &shader_pair : m_shaders) {
-			glAttachShader(program, *(shader_pair.second));
+		if (!m_varyings.empty()) {
+			std::vector<const char *> varyings;
+			for (auto &varying : m_varyings) varyings.push_back(varying.c_str());
+			glTransformFeedbackVaryings(program, GLsizei(varyings.size()), varyings.data(), m_buffer_mode);
 		}
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-		// link the program
+		// link the program, checked by finish_link()
 		glLinkProgram(program);
+		return names;
+	}
 
-		// check link status
-		GLint link_status;
-		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-		printProgramInfoLog(program); // print warnings and errors
-		if (!link_status) throw shader_link_error();
 
-		return program;
+	bool shader_builder::ready(GLuint program) {
+		program_cache &c = cache();
+		if (c.failed.count(program)) return false;
+		if (!c.pending.count(program)) return true;
+		if (c.parallel) {
+			GLint done = 0;
+			glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+			if (!done) return false;
+		}
+		try {
+			finish(program);
+		}
+		catch (shader_error &) {
+			return false; // the log is printed, failed() tells
+		}
+		return true;
+	}
+
+
+	bool shader_builder::failed(GLuint program) {
+		return cache().failed.count(program) > 0;
+	}
+
+
+	void shader_builder::wait(GLuint program) {
+		program_cache &c = cache();
+		if (c.pending.count(program)) finish(program);
+		auto it = c.failed.find(program);
+		if (it != c.failed.end()) std::rethrow_exception(it->second);
+	}
+
+
+	void shader_builder::poll() {
+		program_cache &c = cache();
+		std::vector<GLuint> programs;
+		for (auto &pending_pair : c.pending) programs.push_back(pending_pair.first);
+		for (GLuint program : programs) ready(program);
+	}
+
+
+	void shader_builder::wait_all() {
+		program_cache &c = cache();
+		while (!c.pending.empty()) finish(c.pending.begin()->first);
+		if (!c.failed.empty()) std::rethrow_exception(c.failed.begin()->second);
+	}
+
+
+	void shader_builder::release(GLuint program) {
+		program_cache &c = cache();
+		for (auto it = c.programs.begin(); it != c.programs.end(); ++it) {
+			if (it->second.program != program) continue;
+			if (--it->second.uses > 0) return;
+			c.programs.erase(it);
+			break;
+		}
+		c.pending.erase(program);
+		c.failed.erase(program);
+		gl_state::delete_program(program);
+	}
+
+
+	void shader_builder::set_cache_directory(const std::string &directory) {
+		cache().directory = directory;
+	}
+
+
+	const shader_builder::cache_stats & shader_builder::stats() {
+		program_cache &c = cache();
+		c.stats.pending = int(c.pending.size());
+		c.stats.failed = int(c.failed.size());
+		return c.stats;
 	}
 
 }
\ No newline at end of file
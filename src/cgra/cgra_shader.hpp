@@ -2,9 +2,11 @@
 #pragma once
 
 // std
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 // project
 #include <opengl.hpp>
@@ -12,16 +14,73 @@
 
 namespace cgra {
 
+	// Collects the stages of a program and links them. The stages are only compiled by build(), and not at all if
+	// a program linked from the same sources is known: build() hands out the program an identical build linked
+	// earlier this run, or loads the binary the driver gave for it in an earlier run (glProgramBinary) from the
+	// cache directory. The binaries are keyed by a hash of the driver (vendor, renderer, version) and everything
+	// linked, ie. the stage sources with their injected defines and the transform feedback varyings, so editing a
+	// shader or updating the driver just misses the cache. A binary the driver rejects is linked from source again.
+	//
+	// submit() only starts the compile and link and returns the program right away, so programs submitted one
+	// after the other are compiled side by side where the driver has KHR_parallel_shader_compile. ready() asks
+	// without waiting (it has to wait without the extension) and wait() blocks. Anything querying or using the
+	// program before it is ready (uniform locations included) waits for it as well, so deferred setup belongs after
+	// ready(), see Renderable::onProgramReady. A compile or link error is printed when it is found, ready() stays
+	// false for the program and failed() is true, only wait() and wait_all() throw it. The failed program is kept
+	// until it is released, so its id isn't reused while anything still holds it.
 	class shader_builder {
 	private:
-		std::map<GLenum, std::shared_ptr<gl_object>> m_shaders;
+		struct stage {
+			std::string source; // with the stage define injected
+			std::string name; // the file, for errors
+		};
+		std::map<GLenum, stage> m_stages;
+		std::vector<std::string> m_varyings;
+		GLenum m_buffer_mode = GL_INTERLEAVED_ATTRIBS;
+
+		uint64_t key() const;
+		// compiles the stages and links without waiting on either, returns the stage names by type
+		std::map<GLenum, std::string> start_link(GLuint program) const;
 
 	public:
+		struct cache_stats {
+			int compiled = 0; // linked from source
+			int loaded = 0; // from a binary on disk
+			int shared = 0; // handed out again, an identical program was built before
+			int pending = 0; // submitted, not linked yet
+			int failed = 0; // submitted, didn't compile or link, not released yet
+			float ready_ms = 0; // from the first submit until none was left pending, the last time that happened
+			bool parallel = false; // KHR_parallel_shader_compile, ready() doesn't wait
+		};
+
 		shader_builder() { }
 		void set_shader(GLenum type, const std::string &filename);
 		void set_shader_source(GLenum type, const std::string &shadersource);
+		// outputs captured by transform feedback, set before linking
+		void set_transform_feedback_varyings(const std::vector<std::string> &varyings, GLenum buffer_mode = GL_INTERLEAVED_ATTRIBS);
 
+		// Without a program the result may be shared with identical builds, uniforms included, give it back with
+		// release(). A given program is relinked from source, detaching what it had, and is neither cached nor
+		// shared. Waits for the link, the same as submit() and wait().
 		GLuint build(GLuint program = 0);
+		// starts building, the program may be shared and is released like one from build()
+		GLuint submit();
+
+		// true once a submitted program is linked (always for any other program), false if it failed
+		static bool ready(GLuint program);
+		static bool failed(GLuint program);
+		// throws the compile or link error if the program failed
+		static void wait(GLuint program);
+		// ready() on every submitted program, so the ones nothing asks about are finished (and cached) too
+		static void poll();
+		// wait() on every submitted program, throws the first error of any that failed and wasn't released yet
+		static void wait_all();
+
+		// instead of deleting a program from build(), it is deleted once every build that got it released it
+		static void release(GLuint program);
+		// where the program binaries are kept, relative to the working directory. Empty turns the disk cache off
+		static void set_cache_directory(const std::string &directory);
+		static const cache_stats & stats();
 	};
 
-}
\ No newline at end of file
+}
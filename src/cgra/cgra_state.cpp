@@ -0,0 +1,190 @@
+
+// project
+#include "cgra_state.hpp"
+
+
+
+namespace cgra {
+
+	gl_state::cache & gl_state::state() {
+		static cache c;
+		return c;
+	}
+
+	int gl_state::target_index(GLenum target) {
+		switch (target) {
+			case GL_TEXTURE_2D: return 0;
+			case GL_TEXTURE_3D: return 1;
+			case GL_TEXTURE_CUBE_MAP: return 2;
+			case GL_TEXTURE_2D_ARRAY: return 3;
+			case GL_TEXTURE_1D: return 4;
+			case GL_TEXTURE_BUFFER: return 5;
+		}
+		return -1; // not tracked, always issued
+	}
+
+	void gl_state::count(kind k, bool issued) {
+		if (issued) state().current.issued[k]++;
+		else state().current.skipped[k]++;
+	}
+
+	void gl_state::use_program(GLuint program) {
+		cache &c = state();
+		bool issue = c.program != program;
+		if (issue) {
+			glUseProgram(program);
+			c.program = program;
+		}
+		count(PROGRAM, issue);
+	}
+
+	void gl_state::bind_vertex_array(GLuint vao) {
+		cache &c = state();
+		bool issue = c.vao != vao;
+		if (issue) {
+			glBindVertexArray(vao);
+			c.vao = vao;
+		}
+		count(VERTEX_ARRAY, issue);
+	}
+
+	void gl_state::active_texture(GLenum unit) {
+		cache &c = state();
+		int index = int(unit - GL_TEXTURE0);
+		bool issue = c.active_unit != index;
+		if (issue) {
+			glActiveTexture(unit);
+			c.active_unit = (index >= 0 && index < MAX_UNITS) ? index : -1;
+		}
+		count(TEXTURE, issue);
+	}
+
+	void gl_state::bind_texture(GLenum target, GLuint texture) {
+		cache &c = state();
+		int t = target_index(target);
+		GLuint *bound = (c.active_unit >= 0 && t >= 0) ? &c.textures[c.active_unit][t] : nullptr;
+		bool issue = !bound || *bound != texture;
+		if (issue) {
+			glBindTexture(target, texture);
+			if (bound) *bound = texture;
+		}
+		count(TEXTURE, issue);
+	}
+
+	void gl_state::bind_framebuffer(GLenum target, GLuint framebuffer) {
+		cache &c = state();
+		if (framebuffer == 0) framebuffer = c.default_framebuffer;
+		bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+		bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+		bool issue = (draw && c.draw_framebuffer != framebuffer) || (read && c.read_framebuffer != framebuffer);
+		if (issue) {
+			glBindFramebuffer(target, framebuffer);
+			if (draw) c.draw_framebuffer = framebuffer;
+			if (read) c.read_framebuffer = framebuffer;
+		}
+		count(FRAMEBUFFER, issue);
+	}
+
+	void gl_state::set_default_framebuffer(GLuint framebuffer) {
+		state().default_framebuffer = framebuffer;
+	}
+
+	void gl_state::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+		cache &c = state();
+		std::array<GLint, 4> v{ x, y, width, height };
+		bool issue = !c.viewport_known || c.viewport != v;
+		if (issue) {
+			glViewport(x, y, width, height);
+			c.viewport = v;
+			c.viewport_known = true;
+		}
+		count(VIEWPORT, issue);
+	}
+
+	void gl_state::get_viewport(GLint viewport[4]) {
+		cache &c = state();
+		if (!c.viewport_known) {
+			glGetIntegerv(GL_VIEWPORT, c.viewport.data());
+			c.viewport_known = true;
+		}
+		for (int i = 0; i < 4; i++) viewport[i] = c.viewport[i];
+	}
+
+	void gl_state::enable(GLenum cap) {
+		set_enabled(cap, true);
+	}
+
+	void gl_state::disable(GLenum cap) {
+		set_enabled(cap, false);
+	}
+
+	void gl_state::set_enabled(GLenum cap, bool enabled) {
+		cache &c = state();
+		auto it = c.capabilities.find(cap);
+		bool issue = it == c.capabilities.end() || it->second != enabled;
+		if (issue) {
+			if (enabled) glEnable(cap);
+			else glDisable(cap);
+			c.capabilities[cap] = enabled;
+		}
+		count(CAPABILITY, issue);
+	}
+
+	void gl_state::delete_program(GLuint program) {
+		forget(program);
+		glDeleteProgram(program);
+	}
+
+	void gl_state::delete_vertex_arrays(GLsizei n, const GLuint *vaos) {
+		for (GLsizei i = 0; i < n; i++) forget(vaos[i]);
+		glDeleteVertexArrays(n, vaos);
+	}
+
+	void gl_state::delete_textures(GLsizei n, const GLuint *textures) {
+		for (GLsizei i = 0; i < n; i++) forget(textures[i]);
+		glDeleteTextures(n, textures);
+	}
+
+	void gl_state::delete_framebuffers(GLsizei n, const GLuint *framebuffers) {
+		for (GLsizei i = 0; i < n; i++) forget(framebuffers[i]);
+		glDeleteFramebuffers(n, framebuffers);
+	}
+
+	void gl_state::forget(GLuint name) {
+		// names of different kinds of objects overlap, forgetting too much only costs a redundant call
+		if (name == 0) return;
+		cache &c = state();
+		if (c.program == name) c.program = UNKNOWN;
+		if (c.vao == name) c.vao = UNKNOWN;
+		if (c.draw_framebuffer == name) c.draw_framebuffer = UNKNOWN;
+		if (c.read_framebuffer == name) c.read_framebuffer = UNKNOWN;
+		for (auto &unit : c.textures) {
+			for (auto &bound : unit) {
+				if (bound == name) bound = UNKNOWN;
+			}
+		}
+	}
+
+	void gl_state::invalidate() {
+		cache &c = state();
+		c.program = UNKNOWN;
+		c.vao = UNKNOWN;
+		c.active_unit = -1;
+		for (auto &unit : c.textures) unit.fill(UNKNOWN);
+		c.draw_framebuffer = UNKNOWN;
+		c.read_framebuffer = UNKNOWN;
+		c.viewport_known = false;
+		c.capabilities.clear();
+	}
+
+	void gl_state::begin_frame() {
+		cache &c = state();
+		c.last = c.current;
+		c.current = counts();
+	}
+
+	const gl_state::counts & gl_state::last_frame() {
+		return state().last;
+	}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// std
+#include <array>
+#include <unordered_map>
+
+// gl
+#include <GL/glew.h>
+
+
+
+namespace cgra {
+
+	// Tracks the GL state that is changed most often (program, VAO, texture units, framebuffers, viewport and
+	// glEnable / glDisable capabilities) and drops calls that would set what is already set. Everything that
+	// changes this state has to go through here, including deleting the objects, or the cache goes out of step
+	// with GL. Code that has to go around it (the GUI backend) calls invalidate() afterwards.
+	// The calls issued and skipped are counted per frame, see begin_frame().
+	class gl_state {
+	public:
+		enum kind {
+			PROGRAM,
+			VERTEX_ARRAY,
+			TEXTURE, // binds and active texture unit switches
+			FRAMEBUFFER,
+			VIEWPORT,
+			CAPABILITY, // glEnable / glDisable
+			KIND_COUNT,
+		};
+
+		struct counts {
+			std::array<int, KIND_COUNT> issued{};
+			std::array<int, KIND_COUNT> skipped{};
+		};
+
+		static void use_program(GLuint program);
+		static void bind_vertex_array(GLuint vao);
+		static void active_texture(GLenum unit); // GL_TEXTURE0 + i
+		static void bind_texture(GLenum target, GLuint texture); // on the active unit
+		static void bind_framebuffer(GLenum target, GLuint framebuffer);
+		// what binding framebuffer 0 binds, eg. the offscreen target standing in for the window when headless
+		static void set_default_framebuffer(GLuint framebuffer);
+		static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		// the last viewport set, read from GL if it isn't known
+		static void get_viewport(GLint viewport[4]);
+		static void enable(GLenum cap);
+		static void disable(GLenum cap);
+		static void set_enabled(GLenum cap, bool enabled);
+
+		// deleted objects are unbound by GL and their names may be handed out again, so they are forgotten
+		static void delete_program(GLuint program);
+		static void delete_vertex_arrays(GLsizei n, const GLuint* vaos);
+		static void delete_textures(GLsizei n, const GLuint* textures);
+		static void delete_framebuffers(GLsizei n, const GLuint* framebuffers);
+		// any cached binding of this name is forgotten (for objects deleted elsewhere, eg. by gl_object)
+		static void forget(GLuint name);
+
+		// forgets everything, the next call of each kind is issued
+		static void invalidate();
+
+		// starts counting a new frame, the counts of the last one are kept for last_frame()
+		static void begin_frame();
+		static const counts & last_frame();
+
+	private:
+		static constexpr GLuint UNKNOWN = ~GLuint(0);
+		static constexpr int MAX_UNITS = 32;
+		static constexpr int TARGET_COUNT = 6;
+
+		struct cache {
+			GLuint program = UNKNOWN;
+			GLuint vao = UNKNOWN;
+			int active_unit = -1;
+			std::array<std::array<GLuint, TARGET_COUNT>, MAX_UNITS> textures;
+			GLuint draw_framebuffer = UNKNOWN;
+			GLuint read_framebuffer = UNKNOWN;
+			GLuint default_framebuffer = 0;
+			std::array<GLint, 4> viewport{};
+			bool viewport_known = false;
+			std::unordered_map<GLenum, bool> capabilities;
+			counts current;
+			counts last;
+
+			cache() { for (auto &unit : textures) unit.fill(UNKNOWN); }
+		};
+
+		static cache & state();
+		static int target_index(GLenum target);
+		static void count(kind k, bool issued);
+	};
+
+}
@@ -12,7 +12,7 @@ public:
         cgra::shader_builder sb;
         sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//cube_vert.glsl"));
         sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//cube_frag.glsl"));
-        shader = sb.build();
+        shader = sb.submit();
 
         // Load mesh
         mesh = cgra::load_wavefront_data(CGRA_SRCDIR + std::string("//res//assets//cube.obj")).build();
@@ -25,21 +25,21 @@ public:
 
     GLuint getShader() override { return shader; }
 
-    void setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const override {
-        glUseProgram(shader);
-
-        glm::mat4 modelview = view * modelTransform;
+    void onProgramReady() override {
+        modelLocation = glGetUniformLocation(shader, "uModelMatrix");
+        colorLocation = glGetUniformLocation(shader, "uColor");
+        matLocation = glGetUniformLocation(shader, "uMat");
+    }
 
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, GL_FALSE, glm::value_ptr(modelview));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, GL_FALSE, glm::value_ptr(modelTransform));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(proj));
+    void setObjectUniforms() const override {
+        cgra::gl_state::use_program(shader);
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(modelTransform));
     }
 
     void draw() override {
-        glUseProgram(shader);
-        glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, glm::value_ptr(color)); 
-        glUniform3fv(glGetUniformLocation(shader, "uMat"), 1, glm::value_ptr(mat));
+        cgra::gl_state::use_program(shader);
+        glUniform3fv(colorLocation, 1, glm::value_ptr(color));
+        glUniform3fv(matLocation, 1, glm::value_ptr(mat));
         mesh.draw();
     }
 
@@ -51,6 +51,7 @@ public:
     glm::vec3 color;
     glm::vec3 mat; // metalic, smooth, emissive
     GLuint shader;
+    GLint modelLocation = -1, colorLocation = -1, matLocation = -1;
     cgra::gl_mesh mesh;
 
 };
@@ -12,7 +12,7 @@ public:
         cgra::shader_builder sb;
         sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//example_vct_compatible_vert.glsl"));
         sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//example_vct_compatible_frag.glsl"));
-        shader = sb.build();
+        shader = sb.submit();
 
         // Load mesh
         mesh = cgra::load_wavefront_data(CGRA_SRCDIR + std::string("//res//assets//ball2.obj")).build();
@@ -24,20 +24,19 @@ public:
 
     GLuint getShader() override { return shader; }
 
-    void setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const override {
-        glUseProgram(shader);
-
-        glm::mat4 modelview = view * modelTransform;
+    void onProgramReady() override {
+        modelLocation = glGetUniformLocation(shader, "uModelMatrix");
+        colorLocation = glGetUniformLocation(shader, "uColor");
+    }
 
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, GL_FALSE, glm::value_ptr(modelview));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, GL_FALSE, glm::value_ptr(modelTransform));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(proj));
+    void setObjectUniforms() const override {
+        cgra::gl_state::use_program(shader);
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(modelTransform));
     }
 
     void draw() override {
-        glUseProgram(shader);
-        glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, glm::value_ptr(color)); // this isnt actually used in the shader, its just an example
+        cgra::gl_state::use_program(shader);
+        glUniform3fv(colorLocation, 1, glm::value_ptr(color)); // this isnt actually used in the shader, its just an example
         mesh.draw();
     }
 
@@ -49,6 +48,7 @@ public:
     glm::vec3 color;
 
     GLuint shader;
+    GLint modelLocation = -1, colorLocation = -1;
     cgra::gl_mesh mesh;
 
 };
@@ -0,0 +1,313 @@
+
+// std
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// glm
+#include <glm/gtc/constants.hpp>
+
+// project
+#include "headless.hpp"
+#include "application.hpp"
+#include "opengl.hpp"
+#include "cgra/cgra_image.hpp"
+#include "cgra/cgra_shader.hpp"
+
+#ifdef CGRA_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// glewInit also sets up GLX, which has no display without a window, so only the GL part is initialised.
+// glew.h only declares it for GLEW_MX builds.
+extern "C" GLenum GLEWAPIENTRY glewContextInit(void);
+#endif
+
+
+using namespace std;
+
+
+namespace {
+	int parseInt(const string &arg, const string &value) {
+		size_t end = 0;
+		int result = 0;
+		try { result = stoi(value, &end); }
+		catch (const logic_error &) { } // invalid_argument and out_of_range, reported below
+		if (end == 0 || end != value.size()) throw runtime_error("Expected a whole number after " + arg + ", got " + value);
+		return result;
+	}
+}
+
+
+bool parseHeadlessArguments(int argc, char *argv[], headless_options &options) {
+	bool headless = false;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless" && hasValue) {
+			headless = true;
+			options.posesPath = argv[++i];
+		}
+		else if (arg == "--out" && hasValue) options.outputDir = argv[++i];
+		else if (arg == "--scene" && hasValue) options.scene = parseInt(arg, argv[++i]);
+		else if (arg == "--frames" && hasValue) options.framesPerPose = max(1, parseInt(arg, argv[++i]));
+		else if (arg == "--size" && hasValue) {
+			string size = argv[++i];
+			size_t x = size.find('x');
+			if (x == string::npos) throw runtime_error("Expected --size <width>x<height>, got " + size);
+			options.width = parseInt(arg, size.substr(0, x));
+			options.height = parseInt(arg, size.substr(x + 1));
+			if (options.width < 1 || options.height < 1) throw runtime_error("Expected a positive --size, got " + size);
+		}
+		else cerr << "Warning: ignoring argument " << arg << endl;
+	}
+	return headless;
+}
+
+
+void printHeadlessUsage(ostream &out) {
+	out << "Usage: base --headless <poses> [--out <dir>] [--size <width>x<height>] [--scene <index>] [--frames <count>]" << endl;
+}
+
+
+vector<camera_pose> loadCameraPoses(const string &path) {
+	ifstream file(path);
+	if (!file) throw runtime_error("Could not open camera pose script " + path);
+
+	vector<camera_pose> poses;
+	string line;
+	for (int lineNumber = 1; getline(file, line); lineNumber++) {
+		line = line.substr(0, line.find('#'));
+		istringstream in(line);
+		string first;
+		if (!(in >> first)) continue; // blank
+
+		if (first == "orbit") {
+			glm::vec3 center;
+			float radius, height;
+			int count;
+			if (!(in >> center.x >> center.y >> center.z >> radius >> height >> count) || count < 1)
+				throw runtime_error(path + ":" + to_string(lineNumber) + ": expected orbit cx cy cz radius height count [time]");
+			float time = 0;
+			in >> time;
+			for (int i = 0; i < count; i++) {
+				float angle = glm::two_pi<float>() * i / count;
+				camera_pose pose;
+				pose.position = center + glm::vec3(radius * sin(angle), height, radius * cos(angle));
+				// the inverse of the forward vector of Application::updateCameraMovement
+				glm::vec3 forward = glm::normalize(center - pose.position);
+				pose.pitch = asin(-forward.y);
+				pose.yaw = atan2(forward.x, -forward.z);
+				pose.time = time;
+				poses.push_back(pose);
+			}
+			continue;
+		}
+
+		camera_pose pose;
+		istringstream full(line);
+		if (!(full >> pose.position.x >> pose.position.y >> pose.position.z >> pose.pitch >> pose.yaw))
+			throw runtime_error(path + ":" + to_string(lineNumber) + ": expected x y z pitch yaw [time]");
+		full >> pose.time;
+		poses.push_back(pose);
+	}
+	return poses;
+}
+
+
+#ifdef CGRA_HAVE_EGL
+
+namespace {
+
+	// an EGL context without any surface, made current on creation
+	class offscreen_context {
+	public:
+		offscreen_context() {
+			// the surfaceless platform needs no display server or GPU (Mesa, llvmpipe), other drivers take the
+			// default display
+			const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+			auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+			if (getPlatformDisplay && extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+				m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (m_display == EGL_NO_DISPLAY)
+				m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+				throw runtime_error("Could not initialize an EGL display");
+			if (!eglBindAPI(EGL_OPENGL_API))
+				throw runtime_error("EGL has no desktop OpenGL");
+
+			const EGLint configAttribs[] = {
+				EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+				EGL_NONE
+			};
+			EGLConfig config;
+			EGLint configCount = 0;
+			if (!eglChooseConfig(m_display, configAttribs, &config, 1, &configCount) || configCount == 0)
+				throw runtime_error("No EGL config supports OpenGL");
+
+			// the same 4.4 core context the window gets, without the debug flag
+			const EGLint contextAttribs[] = {
+				EGL_CONTEXT_MAJOR_VERSION, 4,
+				EGL_CONTEXT_MINOR_VERSION, 4,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_NONE
+			};
+			m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttribs);
+			if (m_context == EGL_NO_CONTEXT)
+				throw runtime_error("Could not create an OpenGL 4.4 core context through EGL");
+			if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+				throw runtime_error("Could not make the EGL context current without a surface");
+		}
+
+		~offscreen_context() {
+			eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (m_context != EGL_NO_CONTEXT) eglDestroyContext(m_display, m_context);
+			eglTerminate(m_display);
+		}
+
+		offscreen_context(const offscreen_context&) = delete;
+		offscreen_context& operator=(const offscreen_context&) = delete;
+
+	private:
+		EGLDisplay m_display = EGL_NO_DISPLAY;
+		EGLContext m_context = EGL_NO_CONTEXT;
+	};
+
+
+	// the framebuffer that stands in for the window, and the pixel buffers its frames are read back through. A frame
+	// is read into one buffer and written out after the next frame was submitted, so the GPU is never waited on
+	// before it has finished the frame anyway.
+	class offscreen_target {
+	public:
+		offscreen_target(int width, int height) : m_width(width), m_height(height) {
+			glGenTextures(1, &m_color);
+			cgra::gl_state::bind_texture(GL_TEXTURE_2D, m_color);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+			glGenRenderbuffers(1, &m_depth);
+			glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+			glGenFramebuffers(1, &m_framebuffer);
+			cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				throw runtime_error("Offscreen framebuffer is incomplete");
+			cgra::gl_state::set_default_framebuffer(m_framebuffer);
+
+			glGenBuffers(2, m_readback);
+			for (GLuint buffer : m_readback) {
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+				glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * 4, nullptr, GL_STREAM_READ);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+
+		~offscreen_target() {
+			cgra::gl_state::set_default_framebuffer(0);
+			cgra::gl_state::delete_framebuffers(1, &m_framebuffer);
+			cgra::gl_state::delete_textures(1, &m_color);
+			glDeleteRenderbuffers(1, &m_depth);
+			glDeleteBuffers(2, m_readback);
+		}
+
+		offscreen_target(const offscreen_target&) = delete;
+		offscreen_target& operator=(const offscreen_target&) = delete;
+
+		// starts reading back the last frame, the one before it is written out first
+		void capture(const string &path) {
+			flush();
+			GLuint buffer = m_readback[m_next];
+			m_next = 1 - m_next;
+			cgra::gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			m_pendingBuffer = buffer;
+			m_pendingPath = path;
+		}
+
+		// writes the frame that is still being read back, if any
+		void flush() {
+			if (m_pendingPath.empty()) return;
+			cgra::rgba_image image(m_width, m_height);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pendingBuffer);
+			const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.data.size(), GL_MAP_READ_BIT);
+			if (pixels) {
+				memcpy(image.data.data(), pixels, image.data.size());
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				image.writePng(m_pendingPath);
+			}
+			else cerr << "Error: could not map the read back of " << m_pendingPath << endl;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			m_pendingPath.clear();
+		}
+
+	private:
+		int m_width;
+		int m_height;
+		GLuint m_color = 0;
+		GLuint m_depth = 0;
+		GLuint m_framebuffer = 0;
+		GLuint m_readback[2] = { 0, 0 };
+		int m_next = 0;
+		GLuint m_pendingBuffer = 0;
+		string m_pendingPath;
+	};
+
+}
+
+
+int runHeadless(const headless_options &options) {
+	try {
+		vector<camera_pose> poses = loadCameraPoses(options.posesPath);
+		if (poses.empty()) throw runtime_error("No camera poses in " + options.posesPath);
+
+		offscreen_context context;
+		glewExperimental = GL_TRUE; // required for full GLEW functionality for OpenGL 3.0+
+		GLenum err = glewContextInit();
+		if (GLEW_OK != err) throw runtime_error("GLEW: "s + (const char *)glewGetErrorString(err));
+		cout << "Using OpenGL " << glGetString(GL_VERSION) << " (" << glGetString(GL_RENDERER) << ")" << endl;
+
+		offscreen_target target(options.width, options.height);
+		Application application(glm::ivec2(options.width, options.height), options.scene);
+		// the scene's programs link in the background, the captures shouldn't depend on how long that takes
+		cgra::shader_builder::wait_all();
+
+		for (size_t i = 0; i < poses.size(); i++) {
+			const camera_pose &pose = poses[i];
+			application.setCamera(pose.position, pose.pitch, pose.yaw);
+			application.setTime(pose.time);
+			for (int frame = 0; frame < options.framesPerPose; frame++)
+				application.render();
+
+			ostringstream path;
+			path << options.outputDir << "/frame_" << setw(4) << setfill('0') << i;
+			target.capture(path.str());
+		}
+		target.flush();
+		glFinish();
+	}
+	catch (const exception &e) {
+		cerr << "Error: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
+
+#else
+
+int runHeadless(const headless_options &) {
+	cerr << "Error: headless rendering needs EGL, this build was made without it" << endl;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+// std
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// glm
+#include <glm/glm.hpp>
+
+
+// Headless batch rendering. An offscreen EGL context (surfaceless on Mesa, so it also runs on llvmpipe without a
+// GPU or a display) renders a scene for every camera pose of a script and writes each frame to a png, without a
+// window or ImGui. The frames go through the same Application::render as windowed mode, the window framebuffer is
+// replaced by an offscreen one (see cgra::gl_state::set_default_framebuffer) and read back asynchronously.
+//
+// The pose script has one pose per line, '#' starts a comment:
+//   x y z pitch yaw [time]                       camera position and angles as in the windowed mode
+//   orbit cx cy cz radius height count [time]    count poses on a circle around the center, looking at it
+struct headless_options {
+	std::string posesPath;
+	std::string outputDir = ".";
+	int width = 1280;
+	int height = 720;
+	int scene = 0;
+	int framesPerPose = 1; // frames rendered before a pose is written, > 1 lets the temporal passes settle
+};
+
+struct camera_pose {
+	glm::vec3 position{0};
+	float pitch = 0;
+	float yaw = 0;
+	float time = 0;
+};
+
+// true if the arguments ask for headless mode (--headless <poses>), options are filled in from them. Throws
+// std::runtime_error if an option has a malformed value
+bool parseHeadlessArguments(int argc, char *argv[], headless_options &options);
+
+// the headless options, for when they can't be parsed
+void printHeadlessUsage(std::ostream &out);
+
+// throws std::runtime_error if the script can't be read or has a malformed line
+std::vector<camera_pose> loadCameraPoses(const std::string &path);
+
+// returns the process exit code
+int runHeadless(const headless_options &options);
@@ -1,5 +1,6 @@
 
 // std
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <stdexcept>
@@ -8,6 +9,7 @@
 #include "application.hpp"
 #include "opengl.hpp"
 #include "cgra/cgra_gui.hpp"
+#include "headless.hpp"
 
 
 using namespace std;
@@ -31,7 +33,20 @@ namespace {
 
 // main program
 // 
-int main() {
+int main(int argc, char *argv[]) {
+
+	// batch rendering of scripted camera poses without a window, see headless.hpp
+	headless_options headless;
+	bool runsHeadless = false;
+	try {
+		runsHeadless = parseHeadlessArguments(argc, argv, headless);
+	}
+	catch (const exception &e) {
+		cerr << "Error: " << e.what() << endl;
+		printHeadlessUsage(cerr);
+		return 1;
+	}
+	if (runsHeadless) return runHeadless(headless);
 
 	// initialize the GLFW library
 	if (!glfwInit()) {
@@ -83,7 +98,7 @@ int main() {
 	// enable GL_ARB_debug_output if available (not necessary, just helpful)
 	if (glfwExtensionSupported("GL_ARB_debug_output")) {
 		// this allows the error location to be determined from a stacktrace
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+		cgra::gl_state::enable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
 		// setup up the callback
 		glDebugMessageCallbackARB(debugCallback, nullptr);
 		glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, true);
@@ -108,8 +123,11 @@ int main() {
 
 	
 	// create the application object (and a global pointer to it)
+	// the startup time, the programs submitted meanwhile may still be linking (reported by Application::render)
+	auto startup = chrono::steady_clock::now();
 	Application application(window);
 	application_ptr = &application;
+	cout << "Application created in " << chrono::duration<float, milli>(chrono::steady_clock::now() - startup).count() << " ms" << endl;
 
 
 
@@ -12,6 +12,9 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+// state tracking, every program, VAO, texture, framebuffer, viewport and enable change goes through it
+#include <cgra/cgra_state.hpp>
+
 
 
 namespace cgra {
@@ -23,9 +26,9 @@ namespace cgra {
 		if (vao == 0) {
 			glGenVertexArrays(1, &vao);
 		}
-		glBindVertexArray(vao);
+		gl_state::bind_vertex_array(vao);
 		glDrawArraysInstanced(GL_POINTS, 0, 1, instances);
-		glBindVertexArray(0);
+		gl_state::bind_vertex_array(0);
 	}
 
 
@@ -44,6 +47,7 @@ namespace cgra {
 
 		void destroy() noexcept {
 			if (m_id) {
+				gl_state::forget(m_id);
 				m_dtor(1, &m_id);
 				m_id = 0;
 			}
@@ -3,6 +3,8 @@
 #include "lsystem/node/tree.hpp"
 #include "lsystem/node/bush.hpp"
 #include "cgra/cgra_shader.hpp"
+#include "vct/visibilityBufferPass.hpp"
+#include "vct/materialTextures.hpp"
 #include <memory>
 
 using namespace plant::data;
@@ -11,6 +13,16 @@ using lsystem::node::common::RotateY;
 
 KnownPlants plant::data::known_plants;
 
+// the tree and the bush share their bark and leaf textures, the registry loads them once
+static void load_textures(PlantData &data) {
+	MaterialTextures& textures = MaterialTextures::get();
+	data.trunk_texture_colour = textures.load(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_color_1k.jpg");
+	data.trunk_texture_normal = textures.load(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_normal_opengl_1k.jpg");
+	data.canopy_texture_colour = textures.load(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_color_1k.jpg");
+	data.canopy_texture_normal = textures.load(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_normal_opengl_1k.jpg");
+	// the samplers are set by the meshes once the programs have linked (Mesh::onProgramReady)
+}
+
 static void tree(PlantData &data) {
 	data.initial = lsystem::ruleset{lsystem::node::tree::leaf};
 	data.size = 0.5;
@@ -19,20 +31,20 @@ static void tree(PlantData &data) {
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_trunk_vert.glsl"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_trunk_frag.glsl"));
 		sb.set_shader(GL_GEOMETRY_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_trunk_geom.glsl"));
-		data.trunk_shader = sb.build();
+		data.trunk_shader = visibilityBufferPass::buildCapturable(sb);
 	}
 	{
 		cgra::shader_builder sb;
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_canopy_vert.glsl"));
 		sb.set_shader(GL_GEOMETRY_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_canopy_geom.glsl"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//plant_canopy_frag.glsl"));
-		data.canopy_shader = sb.build();
+		data.canopy_shader = visibilityBufferPass::buildCapturable(sb);
 	}
 
-	data.trunk_texture_colour = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_color_1k.jpg").uploadTexture();
-	data.trunk_texture_normal = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_normal_opengl_1k.jpg").uploadTexture();
-	data.canopy_texture_colour = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_color_1k.jpg").uploadTexture();
-	data.canopy_texture_normal = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_normal_opengl_1k.jpg").uploadTexture();
+	load_textures(data);
+
+	data.trunk_material.smoothness = 0.10;
+	data.canopy_material.smoothness = 0.15;
 }
 
 static void bush(PlantData &data) {
@@ -43,20 +55,20 @@ static void bush(PlantData &data) {
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_trunk_vert.glsl"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_trunk_frag.glsl"));
 		sb.set_shader(GL_GEOMETRY_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_trunk_geom.glsl"));
-		data.trunk_shader = sb.build();
+		data.trunk_shader = visibilityBufferPass::buildCapturable(sb);
 	}
 	{
 		cgra::shader_builder sb;
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_canopy_vert.glsl"));
 		sb.set_shader(GL_GEOMETRY_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_canopy_geom.glsl"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//bush_canopy_frag.glsl"));
-		data.canopy_shader = sb.build();
+		data.canopy_shader = visibilityBufferPass::buildCapturable(sb);
 	}
 
-	data.trunk_texture_colour = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_color_1k.jpg").uploadTexture();
-	data.trunk_texture_normal = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//bark//wood_0025_normal_opengl_1k.jpg").uploadTexture();
-	data.canopy_texture_colour = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_color_1k.jpg").uploadTexture();
-	data.canopy_texture_normal = cgra::rgba_image(CGRA_SRCDIR "//res//textures//plant//leaf//plants_0001_normal_opengl_1k.jpg").uploadTexture();
+	load_textures(data);
+
+	data.trunk_material = {glm::vec3(0.9, 0.9, 0.1), 0, 0.1, 0, 0.10};
+	data.canopy_material = {glm::vec3(0.9, 0.9, 0.5), 0, 0.1, 0, 0.15};
 }
 
 void plant::data::init_known_plants() {
@@ -3,6 +3,7 @@
 #include "lsystem.hpp"
 #include "opengl.hpp"
 #include "cgra/cgra_image.hpp"
+#include "renderable.hpp"
 
 namespace plant::data {
 	struct PlantData {
@@ -10,10 +11,14 @@ namespace plant::data {
 		float size;
 		GLuint trunk_shader;
 		GLuint canopy_shader;
-		GLuint trunk_texture_colour;
-		GLuint trunk_texture_normal;
-		GLuint canopy_texture_colour;
-		GLuint canopy_texture_normal;
+		// layers in the material texture array (vct/materialTextures.hpp)
+		int trunk_texture_colour;
+		int trunk_texture_normal;
+		int canopy_texture_colour;
+		int canopy_texture_normal;
+		// what the frag shaders above compute, for the visibility buffer resolve
+		VisibilityMaterial trunk_material;
+		VisibilityMaterial canopy_material;
 	};
 
 	struct KnownPlants{
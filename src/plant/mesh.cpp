@@ -1,17 +1,29 @@
 #include "plant/mesh.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include "cgra/cgra_mesh.hpp"
+#include "vct/materialTextures.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
+#include <cmath>
+#include <utility>
 
 using namespace plant;
 using namespace glm;
 bool planttt = true;
 
-Mesh::Mesh() : mesh{}, shader{0}, modelTransform{1} {}
+Mesh::Mesh() : mesh{}, shader{0}, modelTransform{1}, colour_texture{-1}, normal_texture{-1} {}
 
-Mesh::Mesh(GLuint shader, GLuint colour, GLuint normal) : mesh{}, shader{shader}, modelTransform{1}, colour_texture{colour}, normal_texture{normal} {}
+Mesh::Mesh(GLuint shader, int colour, int normal) : mesh{}, shader{shader}, modelTransform{1}, colour_texture{colour}, normal_texture{normal} {}
+
+// the species' programs are shared by all their meshes, setting the sampler again is harmless
+void Mesh::onProgramReady() {
+	MaterialTextures::setSampler(shader);
+	model_location = glGetUniformLocation(shader, "uModelMatrix");
+	colour_location = glGetUniformLocation(shader, "uColourLayer");
+	normal_location = glGetUniformLocation(shader, "uNormalLayer");
+	instanced_location = glGetUniformLocation(shader, "uInstanced");
+}
 
 GLuint Mesh::getShader() {
 	return shader;
@@ -21,24 +33,131 @@ mat4 Mesh::getModelTransform() {
 	return modelTransform;
 }
 
-void Mesh::setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const {
-	glUseProgram(shader);
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, value_ptr(proj));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, false, value_ptr(view));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, false, value_ptr(modelTransform));
+bool Mesh::supportsVisibilityBuffer() {
+	return true;
+}
+
+VisibilityMaterial Mesh::getVisibilityMaterial() {
+	VisibilityMaterial out = material;
+	out.colourLayer = colour_texture;
+	out.geometryId = mesh.vao;
+	return out;
+}
+
+WorldBounds Mesh::getWorldBounds() {
+	// the widest the geometry shaders expand a vertex, the leaf quads
+	const vec3 padding(0.25f);
+	return WorldBounds::transformed(boundsMin - padding, boundsMax + padding, modelTransform);
+}
+
+GLuint Mesh::getTextureSetKey() {
+	return GLuint(colour_texture); // the normal texture always comes with it
+}
+
+bool Mesh::supportsMultiDraw() {
+	return planttt;
+}
+
+ArenaGeometry Mesh::getArenaGeometry() {
+	// the layers go into the draw's record, so every plant of a program shares one call
+	return {mode, &vertices, &indices, &steps, mesh.vao, 0, ivec4(colour_texture, normal_texture, 0, 0)};
+}
+
+void Mesh::bindArenaState() {
+	// the textures are layers of the material array, which stays bound, only the layers are set
+	cgra::gl_state::use_program(shader);
+	glUniform1i(colour_location, colour_texture);
+	glUniform1i(normal_location, normal_texture);
+}
+
+void Mesh::setObjectUniforms() const {
+	cgra::gl_state::use_program(shader);
+	glUniformMatrix4fv(model_location, 1, false, value_ptr(modelTransform));
+}
+
+InstancedMesh::InstancedMesh(Mesh* source, std::vector<mat4> instances) : source{source}, instances{std::move(instances)} {
+	glGenBuffers(1, &instance_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+	glBufferData(GL_ARRAY_BUFFER, this->instances.size() * sizeof(mat4), this->instances.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	update_bounds();
+}
+
+void InstancedMesh::release() {
+	glDeleteBuffers(1, &instance_vbo);
+	instance_vbo = 0;
+}
+
+void InstancedMesh::draw() {
+	if (!planttt || instances.empty()) return;
+
+	source->bindArenaState();
+	glUniform1i(source->instanced_location, 1);
+	// the variant's vao is shared by the tiles, the instance attributes are pointed at this tile's buffer every draw
+	cgra::gl_state::bind_vertex_array(source->mesh.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+	for (int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(6 + i);
+		glVertexAttribPointer(6 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(vec4) * i));
+		glVertexAttribDivisor(6 + i, 1);
+	}
+	glDrawElementsInstanced(source->mesh.mode, source->mesh.index_count, GL_UNSIGNED_INT, 0, GLsizei(instances.size()));
+	cgra::gl_state::bind_vertex_array(0);
+	glUniform1i(source->instanced_location, 0);
+}
+
+void InstancedMesh::setObjectUniforms() const {
+	// the model matrices are per instance, only the program is made current
+	cgra::gl_state::use_program(source->shader);
+}
+
+// the variant's mesh isn't in the scene itself, it draws through this
+void InstancedMesh::onProgramReady() {
+	source->onProgramReady();
+}
+
+GLuint InstancedMesh::getShader() {
+	return source->shader;
+}
+
+mat4 InstancedMesh::getModelTransform() {
+	return mat4(1); // per instance
+}
+
+void InstancedMesh::update_bounds() {
+	const vec3 padding(0.25f); // as Mesh::getWorldBounds
+	bounds = {vec3(INFINITY), vec3(-INFINITY), !instances.empty()};
+	for (auto& instance : instances) {
+		WorldBounds instance_bounds = WorldBounds::transformed(source->boundsMin - padding, source->boundsMax + padding, instance);
+		bounds.min = min(bounds.min, instance_bounds.min);
+		bounds.max = max(bounds.max, instance_bounds.max);
+	}
+	bounds_source_min = source->boundsMin;
+	bounds_source_max = source->boundsMax;
+}
+
+WorldBounds InstancedMesh::getWorldBounds() {
+	// the instances never move, only growing the variant changes the bounds
+	if (source->boundsMin != bounds_source_min || source->boundsMax != bounds_source_max) update_bounds();
+	return bounds;
+}
+
+GLuint InstancedMesh::getTextureSetKey() {
+	return source->getTextureSetKey();
+}
+
+bool InstancedMesh::supportsVisibilityBuffer() {
+	return true;
+}
+
+VisibilityMaterial InstancedMesh::getVisibilityMaterial() {
+	return source->getVisibilityMaterial();
 }
 
 void Mesh::draw() {
 	// TODO: textures or whatever
 	if (!planttt) return;
 
-	glUseProgram(shader);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, colour_texture);
-	glUniform1i(glGetUniformLocation(shader, "colourTexture"), 0);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, normal_texture);
-	glUniform1i(glGetUniformLocation(shader, "normalTexture"), 1);
-
+	bindArenaState();
 	mesh.draw();
 }
@@ -7,16 +7,62 @@ namespace plant {
 		GLuint shader;
 		glm::mat4 modelTransform;
 		GLuint alt_vbo;
-		GLuint colour_texture;
-		GLuint normal_texture;
+		int colour_texture;  // layers in the material texture array
+		int normal_texture;
+		VisibilityMaterial material; // what the material shader does, for the visibility buffer
+		glm::vec3 boundsMin{0};      // model space bounds of the mesh vertices, before the geometry shader expands them
+		glm::vec3 boundsMax{0};
+		GLenum mode = GL_TRIANGLES;               // the geometry mesh was built from, for the shared mesh arena
+		std::vector<cgra::mesh_vertex> vertices;
+		std::vector<unsigned int> indices;
+		std::vector<float> steps;                 // attribute 4 of the trunk, empty for the canopy
+		GLint model_location = -1;                // the uniforms of shader, looked up once it has linked
+		GLint colour_location = -1;
+		GLint normal_location = -1;
+		GLint instanced_location = -1;
 
 		Mesh();
-		Mesh(GLuint shader, GLuint colour, GLuint normal);
+		Mesh(GLuint shader, int colour, int normal);
 
 		virtual void draw() override;
-		virtual void setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const override;
+		virtual void setObjectUniforms() const override;
 		virtual GLuint getShader() override;
+		virtual void onProgramReady() override;
 		virtual glm::mat4 getModelTransform() override;
+		virtual bool supportsVisibilityBuffer() override;
+		virtual VisibilityMaterial getVisibilityMaterial() override;
+		virtual WorldBounds getWorldBounds() override;
+		virtual GLuint getTextureSetKey() override;
+		virtual bool supportsMultiDraw() override;
+		virtual ArenaGeometry getArenaGeometry() override;
+		virtual void bindArenaState() override;
+	};
+
+	// the placements of one pre-grown plant variant (trunk or canopy) in one tile of the terrain, drawn with one
+	// glDrawElementsInstanced. The per instance model matrices are attributes 6-9, the plant programs use them while
+	// uInstanced is set. Tiles are culled and sorted on their own, their bounds are only computed again when the
+	// variant grows, so the per frame cost doesn't depend on the number of instances.
+	struct InstancedMesh : Renderable {
+		Mesh* source;                       // the variant's mesh, owned by the plant manager
+		std::vector<glm::mat4> instances;
+		GLuint instance_vbo = 0;
+		WorldBounds bounds;                 // of all instances
+		glm::vec3 bounds_source_min{0};     // the variant's bounds the instance bounds were computed from
+		glm::vec3 bounds_source_max{0};
+
+		InstancedMesh(Mesh* source, std::vector<glm::mat4> instances);
+		void release();                     // frees the instance buffer
+		void update_bounds();
+
+		virtual void draw() override;
+		virtual void setObjectUniforms() const override;
+		virtual GLuint getShader() override;
+		virtual void onProgramReady() override;
+		virtual glm::mat4 getModelTransform() override;
+		virtual WorldBounds getWorldBounds() override;
+		virtual GLuint getTextureSetKey() override;
+		virtual bool supportsVisibilityBuffer() override;
+		virtual VisibilityMaterial getVisibilityMaterial() override;
 	};
 
 }
@@ -3,6 +3,9 @@
 #include "lsystem.hpp"
 #include "plant/data.hpp"
 #include "opengl.hpp"
+#include "simulation.hpp"
+#include <cmath>
+#include <map>
 #include <ostream>
 #include <random>
 #include <string>
@@ -24,69 +27,133 @@ Plant::Plant(lsystem::ruleset current, GLuint trunk_shader, GLuint canopy_shader
 	grow(steps);
 }
 
-Plant::Plant(data::PlantData data, int steps) :
-		current{data.initial}, size{data.size},
+Plant::Plant(data::PlantData data, int steps, unsigned long rng_seed) :
+		rng{rng_seed}, current{data.initial}, size{data.size},
 		trunk{data.trunk_shader, data.trunk_texture_colour, data.trunk_texture_normal},
 		canopy{data.canopy_shader, data.canopy_texture_colour, data.canopy_texture_normal} {
+	trunk.material = data.trunk_material;
+	canopy.material = data.canopy_material;
 	grow(steps);
 }
 
+// keeps what the mesh was built from, the bounds and the shared mesh arena need it
+static void setGeometry(Mesh& mesh, const cgra::mesh_builder& mb) {
+	mesh.mode = mb.mode;
+	mesh.vertices = mb.vertices;
+	mesh.indices = mb.indices;
+	mesh.boundsMin = vec3(INFINITY);
+	mesh.boundsMax = vec3(-INFINITY);
+	for (auto& v : mb.vertices) {
+		mesh.boundsMin = min(mesh.boundsMin, v.pos);
+		mesh.boundsMax = max(mesh.boundsMax, v.pos);
+	}
+	if (mb.vertices.empty()) mesh.boundsMin = mesh.boundsMax = vec3(0);
+}
+
 void Plant::grow(int steps) {
-	current = lsystem::iterate(current, rng, steps);
-	recalculate_mesh();
+	PlantGrowth growth = growth_input();
+	PlantGrowth::derive(growth, steps);
+	apply_growth(growth);
 }
 
-void Plant::recalculate_mesh() {
-	cgra::mesh_builder trunk_mb;
-	trunk_mb.mode = GL_LINES;
-	cgra::mesh_builder canopy_mb;
-	canopy_mb.mode = GL_POINTS;
+// no GL in here, it runs on the simulation thread
+void PlantGrowth::derive(PlantGrowth& growth, int steps) {
+	growth.current = lsystem::iterate(growth.current, growth.rng, steps);
+
+	growth.trunk = cgra::mesh_builder();
+	growth.trunk.mode = GL_LINES;
+	growth.canopy = cgra::mesh_builder();
+	growth.canopy.mode = GL_POINTS;
+	growth.steps.clear();
 
 	float step = 1;
-	static float angle = 0.3;
 	mat4 trans = mat4(1);
-	std::vector<float> steps;
-	std::vector<lsystem::node::node_stack> stack = {{trans, size, step, &steps}};
+	std::vector<lsystem::node::node_stack> stack = {{trans, growth.size, step, &growth.steps}};
 
-	for (auto &n: current) {
-		n->render(stack, trunk_mb, canopy_mb);
+	for (auto &n: growth.current) {
+		n->render(stack, growth.trunk, growth.canopy);
 	}
 
-	trunk.mesh = trunk_mb.build();
-
-	if (canopy_mb.vertices.size() <= 0) {
-		canopy_mb.push_index(canopy_mb.push_vertex({{0,-10000,0}}));
+	if (growth.canopy.vertices.size() <= 0) {
+		growth.canopy.push_index(growth.canopy.push_vertex({{0,-10000,0}}));
 	}
+}
+
+PlantGrowth Plant::growth_input() const {
+	PlantGrowth growth;
+	growth.current = current;
+	growth.rng = rng;
+	growth.size = size;
+	return growth;
+}
 
-	canopy.mesh = canopy_mb.build();
+void Plant::apply_growth(const PlantGrowth& growth) {
+	current = growth.current;
+	rng = growth.rng;
+
+	trunk.mesh = growth.trunk.build();
+	setGeometry(trunk, growth.trunk);
+	trunk.steps = growth.steps;
+
+	canopy.mesh = growth.canopy.build();
+	setGeometry(canopy, growth.canopy);
 
 	glGenBuffers(1, &trunk.alt_vbo);
-	glBindVertexArray(trunk.mesh.vao);
+	cgra::gl_state::bind_vertex_array(trunk.mesh.vao);
 	glBindBuffer(GL_ARRAY_BUFFER, trunk.alt_vbo);
-	glBufferData(GL_ARRAY_BUFFER, steps.size() * sizeof(float), &steps[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, trunk.steps.size() * sizeof(float), trunk.steps.data(), GL_STATIC_DRAW);
 	// 0, 1, 2 are taken
 	glEnableVertexAttribArray(4);
 	
 	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void *)0);
-	glBindVertexArray(0);
+	cgra::gl_state::bind_vertex_array(0);
 }
 
-PlantManager::PlantManager(Renderer* renderer) : renderer{renderer} {}
+PlantManager::PlantManager(Renderer* renderer, Simulation* simulation) : renderer{renderer}, simulation{simulation} {}
 PlantManager::PlantManager() {}
 void PlantManager::clear() {
-	// Assuming that the item at the back is the one with the largest index
-	for (auto it = plants.rbegin(); it != plants.rend(); it++) {
-		renderer->renderables.erase(renderer->renderables.begin() + it->first + 1);
-		renderer->renderables.erase(renderer->renderables.begin() + it->first);
-	}
+	// stale handles (the scene was cleared under us) are ignored
+	for (auto handle : handles) renderer->removeRenderable(handle);
+	handles.clear();
 	plants.clear();
+
+	// a growth that is still running was started from the plants just dropped
+	if (growing) simulation->cancelGrowth();
+	growing = false;
+	queued_steps = 0;
+
+	for (auto& mesh : instanced_meshes) mesh.release();
+	instanced_meshes.clear();
+}
+
+void PlantManager::build_variants() {
+	if (!variants.empty()) return;
+	// reserved up front, the instanced meshes point into it
+	variants.reserve(2 * VARIANTS_PER_SPECIES);
+	for (auto data : {&data::known_plants.tree, &data::known_plants.bush}) {
+		for (int i = 0; i < VARIANTS_PER_SPECIES; i++) {
+			variants.push_back(Plant(*data, 2, std::minstd_rand::default_seed + i));
+		}
+	}
+}
+
+void PlantManager::refresh() {
+	auto inputs = last_inputs;
+	update_plants(inputs);
 }
 
 void PlantManager::update_plants(const std::vector<plants_manager_input>& inputs) {
 	this->clear();
+	last_inputs = inputs;
 	std::vector<Plant> temp_plants;
 
 	std::minstd_rand rng;
+	// the placements of every variant by tile
+	std::vector<std::map<std::pair<int, int>, std::vector<mat4>>> variant_tiles;
+	if (instanced) {
+		build_variants();
+		variant_tiles.resize(variants.size());
+	}
 
 	for (auto pt : inputs) {
 		data::PlantData *data;
@@ -108,25 +175,80 @@ void PlantManager::update_plants(const std::vector<plants_manager_input>& inputs
 				data = &data::known_plants.bush;
 				break;
 		}
+		if (instanced) {
+			int species = data == &data::known_plants.tree ? 0 : 1;
+			int variant = species * VARIANTS_PER_SPECIES + int(rng() % VARIANTS_PER_SPECIES);
+			std::pair<int, int> tile{int(floor(pt.pos.x / INSTANCE_TILE_SIZE)), int(floor(pt.pos.z / INSTANCE_TILE_SIZE))};
+			variant_tiles[variant][tile].push_back(translate(mat4(1), pt.pos));
+			continue;
+		}
 		Plant p = Plant(*data);
 		p.trunk.modelTransform = translate(p.trunk.modelTransform, pt.pos);
 		p.canopy.modelTransform = translate(p.canopy.modelTransform, pt.pos);
 		temp_plants.push_back(p);
 	}
 
-	// This is really unsafe but lol
-	auto base = renderer->renderables.size();
+	// reserved so the scene's pointers to the meshes stay valid
 	plants.reserve(temp_plants.size());
 	for (auto plant : temp_plants) {
-		plants.push_back({base, plant});
-		renderer->addRenderable(&plants.back().second.canopy);
-		renderer->addRenderable(&plants.back().second.trunk);
-		base += 2;
+		plants.push_back(plant);
+		handles.push_back(renderer->addRenderable(&plants.back().canopy));
+		handles.push_back(renderer->addRenderable(&plants.back().trunk));
+	}
+
+	// the instanced meshes are only ever added here, reserved so the renderer's pointers stay valid
+	size_t tiles = 0;
+	for (auto& variant : variant_tiles) tiles += variant.size();
+	instanced_meshes.reserve(tiles * 2);
+	for (size_t v = 0; v < variant_tiles.size(); v++) {
+		for (auto& [tile, instances] : variant_tiles[v]) {
+			instanced_meshes.emplace_back(&variants[v].canopy, instances);
+			handles.push_back(renderer->addRenderable(&instanced_meshes.back()));
+			instanced_meshes.emplace_back(&variants[v].trunk, instances);
+			handles.push_back(renderer->addRenderable(&instanced_meshes.back()));
+		}
 	}
 }
 
 void PlantManager::grow(int step) {
+	if (simulation) {
+		// growing from a state that is about to be replaced would lose the running growth's steps
+		if (growing) queued_steps += step;
+		else start_growth(step);
+		return;
+	}
 	for (auto& plant : plants) {
-		plant.second.grow(step);
+		plant.grow(step);
+	}
+	for (auto& variant : variants) {
+		variant.grow(step);
+	}
+}
+
+void PlantManager::start_growth(int steps) {
+	std::vector<PlantGrowth> inputs;
+	inputs.reserve(plants.size() + variants.size());
+	for (auto& plant : plants) inputs.push_back(plant.growth_input());
+	for (auto& variant : variants) inputs.push_back(variant.growth_input());
+	simulation->grow(std::move(inputs), steps);
+	growing = true;
+}
+
+bool PlantManager::update() {
+	if (!growing) return false;
+	const std::vector<PlantGrowth>* grown = simulation->pollGrowth();
+	if (!grown) return false;
+	growing = false;
+	if (grown->size() != plants.size() + variants.size()) return false;
+
+	// in the order start_growth() gave them
+	size_t i = 0;
+	for (auto& plant : plants) plant.apply_growth((*grown)[i++]);
+	for (auto& variant : variants) variant.apply_growth((*grown)[i++]);
+
+	if (queued_steps > 0) {
+		start_growth(queued_steps);
+		queued_steps = 0;
 	}
+	return true;
 }
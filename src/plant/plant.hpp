@@ -9,11 +9,25 @@
 #include "plant/mesh.hpp"
 #include "plant/data.hpp"
 
+class Simulation;
+
 namespace plant {
+	// growing a plant split from the GL uploads, so the derivation and the mesh building can run on the
+	// simulation thread. The first three are the input, derive() advances them and fills in the rest.
+	struct PlantGrowth {
+		lsystem::ruleset current;
+		std::minstd_rand rng;
+		float size;
+		cgra::mesh_builder trunk;
+		cgra::mesh_builder canopy;
+		std::vector<float> steps;
+
+		static void derive(PlantGrowth& growth, int steps);
+	};
+
 	class Plant {
 		std::minstd_rand rng;
 		lsystem::ruleset current;
-		void recalculate_mesh();
 		float size;
 
 		public:
@@ -21,8 +35,11 @@ namespace plant {
 		Mesh canopy;
 
 		Plant(lsystem::ruleset current, GLuint trunk_shader, GLuint canopy_shader, unsigned long rng_seed, int steps = 0);
-		Plant(data::PlantData data, int steps = 2);
+		Plant(data::PlantData data, int steps = 2, unsigned long rng_seed = std::minstd_rand::default_seed);
 		void grow(int steps = 1);
+		// the input of a derive(), and taking over a derived one (uploads the meshes, render thread only)
+		PlantGrowth growth_input() const;
+		void apply_growth(const PlantGrowth& growth);
 	};
 
 	struct plants_manager_input {
@@ -39,15 +56,39 @@ namespace plant {
 	// std::vector<Plant> create_plants(std::vector<create_plants_input> inputs);
 
 	class PlantManager {
-		std::vector<std::pair<unsigned int, Plant>> plants;
+		std::vector<Plant> plants;
 		Renderer *renderer;
+		// what was registered with the renderer's scene, plant meshes and instanced meshes alike
+		std::vector<SceneRegistry::Handle> handles;
+
+		// instanced path, a few pre-grown variants per species and one instanced trunk and canopy per variant and
+		// tile of the terrain the variant has placements in
+		static constexpr int VARIANTS_PER_SPECIES = 4;
+		static constexpr float INSTANCE_TILE_SIZE = 2.5f; // world units, the default terrain is 4x4 tiles
+		std::vector<Plant> variants; // tree variants, then bush variants
+		std::vector<InstancedMesh> instanced_meshes;
+		std::vector<plants_manager_input> last_inputs;
+		void build_variants();
+
+		// growth runs on the simulation thread, the result is taken over by update()
+		Simulation *simulation = nullptr;
+		bool growing = false;
+		int queued_steps = 0; // asked for while a growth was running
+		void start_growth(int steps);
 
 		public:
+		bool instanced = true;
+
 		PlantManager();
-		PlantManager(Renderer* renderer);
+		PlantManager(Renderer* renderer, Simulation* simulation = nullptr);
 
+		// grows in place without a simulation thread
 		void grow(int step = 1);
+		// takes over a growth the simulation thread finished, true if meshes changed. Once a frame
+		bool update();
 		void clear();
 		void update_plants(const std::vector<plants_manager_input>& inputs);
+		// places the last placements again, eg. after switching between the instanced and per plant paths
+		void refresh();
 	};
 }
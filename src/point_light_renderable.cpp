@@ -13,7 +13,7 @@ public:
         cgra::shader_builder sb;
         sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//example_vct_compatible_vert.glsl"));
         sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//point_light_frag.glsl"));
-        shader = sb.build();
+        shader = sb.submit();
 
         // Load mesh
         mesh = cgra::load_wavefront_data(CGRA_SRCDIR + std::string("//res//assets//ball2.obj")).build();
@@ -25,20 +25,19 @@ public:
 
     GLuint getShader() override { return shader; }
 
-    void setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const override {
-        glUseProgram(shader);
-
-        glm::mat4 modelview = view * modelTransform;
+    void onProgramReady() override {
+        modelLocation = glGetUniformLocation(shader, "uModelMatrix");
+        lightColorLocation = glGetUniformLocation(shader, "uLightColor");
+    }
 
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, GL_FALSE, glm::value_ptr(modelview));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, GL_FALSE, glm::value_ptr(modelTransform));
-        glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(proj));
+    void setObjectUniforms() const override {
+        cgra::gl_state::use_program(shader);
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(modelTransform));
     }
 
     void draw() override {
-        glUseProgram(shader);
-        glUniform3fv(glGetUniformLocation(shader, "uLightColor"),1 ,glm::value_ptr((lightColor * brightness)));
+        cgra::gl_state::use_program(shader);
+        glUniform3fv(lightColorLocation, 1, glm::value_ptr((lightColor * brightness)));
         mesh.draw();
     }
 
@@ -50,6 +49,7 @@ public:
     glm::vec3 lightColor = glm::vec3(1, 1, 1);
     float brightness = 100;
     GLuint shader;
+    GLint modelLocation = -1, lightColorLocation = -1;
     cgra::gl_mesh mesh;
 
 };
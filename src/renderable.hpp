@@ -3,19 +3,95 @@
 #include <glm/detail/type_mat.hpp>
 #include <glm/detail/type_gentype.hpp>
 #include <vector>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cgra/cgra_mesh.hpp>
 
+// material of a renderable drawn through the visibility buffer (see vct/visibilityBufferPass.hpp),
+// albedo = baseColour + texture.rgb * textureWeight + texture.g * greenWeight
+struct VisibilityMaterial {
+    glm::vec3 baseColour{0};
+    float textureWeight = 1;
+    float greenWeight = 0;
+    float metallic = 0;
+    float smoothness = 0;
+    int colourLayer = -1;  // layer in the material texture array (vct/materialTextures.hpp), -1 untextured
+    GLuint geometryId = 0; // must change whenever the geometry is rebuilt, it is captured again then
+};
+
+// geometry a renderable hands to the shared mesh arena (see vct/meshArena.hpp), the pointers must stay valid
+// until geometryId changes
+struct ArenaGeometry {
+    GLenum mode = GL_TRIANGLES;
+    const std::vector<cgra::mesh_vertex>* vertices = nullptr;
+    const std::vector<unsigned int>* indices = nullptr;
+    const std::vector<float>* extra = nullptr; // optional float per vertex, attribute 4
+    GLuint geometryId = 0; // must change whenever the geometry does
+    GLuint stateKey = 0;   // renderables with the same program and key are drawn by one call
+    glm::ivec4 material{-1}; // per draw material parameters, ObjectRecord.material (colour and normal layer for the plants)
+};
+
+// world space axis aligned bounds, renderables without valid bounds are never culled
+struct WorldBounds {
+    glm::vec3 min{0};
+    glm::vec3 max{0};
+    bool valid = false;
+
+    // the bounds of a model space box after the model transform
+    static WorldBounds transformed(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& model) {
+        WorldBounds out{glm::vec3(INFINITY), glm::vec3(-INFINITY), true};
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? localMax.x : localMin.x, (i & 2) ? localMax.y : localMin.y, (i & 4) ? localMax.z : localMin.z);
+            glm::vec3 p = glm::vec3(model * glm::vec4(corner, 1));
+            out.min = glm::min(out.min, p);
+            out.max = glm::max(out.max, p);
+        }
+        return out;
+    }
+};
 
 class Renderable {
 public:
+    virtual ~Renderable() = default;
+
     virtual GLuint getShader() = 0;  // return shader program to use
-    virtual std::vector<GLuint> getShaders() { return std::vector<GLuint> {getShader()}; }; // return shaders, override if more than 1 shader
+
+    // called once by the scene before anything is drawn, when the program of getShader() has linked. Programs from
+    // shader_builder::submit() link in the background and looking up a uniform would wait for them, so the
+    // uniforms are looked up (and the samplers set) here rather than in the constructor
+    virtual void onProgramReady() {}
     
-    // all projection, model and view related uniforms should be set here
-    virtual void setProjViewUniforms(const glm::mat4& view, const glm::mat4& proj) const = 0;
+    // the camera, voxel and render mode uniforms come from the FrameConstants block (see vct/frameConstants.hpp),
+    // only the per object ones (the model matrix) are set here, through locations looked up once
+    virtual void setObjectUniforms() const = 0;
 
     // all other shader uniforms may be set here, as well as of course a draw call, make sure to call useProgram
     virtual void draw() = 0; 
 
     // also needed for the voxelization process, can just return an identity matrix if no model transformations are made
     virtual glm::mat4 getModelTransform() = 0;
+
+    // static GI bake, renderables that return true here must rasterise in lightmap (uv) space when uRenderMode is 2
+    // and write the baked irradiance they are given to the G-buffer (see basic_terrain.vs/.fs)
+    virtual bool supportsLightmap() { return false; }
+    virtual void setBakedLightmap(GLuint /*texture*/) {}
+
+    // visibility buffer, renderables that return true here are captured to world space triangles once (drawn with
+    // identity view and projection under transform feedback, their programs must be linked with
+    // visibilityBufferPass::buildCapturable) and then skip the prepass, a full screen pass shades them instead
+    virtual bool supportsVisibilityBuffer() { return false; }
+    virtual VisibilityMaterial getVisibilityMaterial() { return {}; }
+
+    // culling, the bounds must contain everything draw() rasterises (including geometry shader expansion)
+    virtual WorldBounds getWorldBounds() { return {}; }
+
+    // the textures draw() binds, renderables with the same program and key are queued next to each other
+    virtual GLuint getTextureSetKey() { return 0; }
+
+    // multi draw indirect, renderables that return true here live in the shared mesh arena. Their programs take the
+    // model matrix and material from objects[aDrawIndex] while uMultiDraw is set (see plant_trunk_vert.glsl) and
+    // bindArenaState binds everything else draw() would, for the whole group of renderables with the same stateKey
+    virtual bool supportsMultiDraw() { return false; }
+    virtual ArenaGeometry getArenaGeometry() { return {}; }
+    virtual void bindArenaState() {}
 };
@@ -2,7 +2,28 @@
 #include <vector>
 #include <vct/gBufferPrepass.hpp>
 #include <vct/gBufferLightingPass.hpp>
+#include <vct/atrousDenoisePass.hpp>
 #include <vct/voxelizer.hpp>
+#include <vct/gpuTimer.hpp>
+#include <vct/frameBudgetController.hpp>
+#include <vct/lightmapBaker.hpp>
+#include <vct/clusteredLightPass.hpp>
+#include <vct/hiZPass.hpp>
+#include <vct/ssgiPass.hpp>
+#include <vct/voxelBouncePass.hpp>
+#include <vct/shadowedLightPass.hpp>
+#include <vct/temporalUpscalePass.hpp>
+#include <vct/tracerStats.hpp>
+#include <vct/visibilityBufferPass.hpp>
+#include <vct/cullingPass.hpp>
+#include <vct/renderGraph.hpp>
+#include <vct/meshArena.hpp>
+#include <vct/renderQueue.hpp>
+#include <vct/materialTextures.hpp>
+#include <vct/frameConstants.hpp>
+#include <vct/sceneRegistry.hpp>
+#include <algorithm>
+#include <cmath>
 #ifndef BAKINGBAD_RENDERER_H
 #define BAKINGBAD_RENDERER_H
 
@@ -17,14 +38,45 @@ class Renderer {
 public:
     gBufferPrepass* prepass;
     gBufferLightingPass* lightingPass; 
+    atrousDenoisePass* denoisePass;
+    clusteredLightPass* clusterPass;
+    hiZPass* hiZ;
+    ssgiPass* ssgi;
+    voxelBouncePass* bounce;
+    shadowedLightPass* primaryLight;
+    temporalUpscalePass* upscalePass;
+    visibilityBufferPass* visibility;
+    cullingPass* culling;
+    meshArena* arena;
     Voxelizer* voxelizer;
-    std::vector<Renderable*> renderables;
+    SceneRegistry scene;
     debug_parameters debug_params;
+    FrameBudgetController budgetController;
+    LightmapBaker lightmapBaker;
+    TracerStats tracerStats;
+    RenderGraph graph;
+    renderQueue queue;
+    gpuTimer prepassTimer;
+    gpuTimer lightingTimer;
 
     Renderer(int width, int height) {
         prepass = new gBufferPrepass(width, height);
-        voxelizer = new Voxelizer(512);
-        lightingPass = new gBufferLightingPass(prepass, voxelizer);
+        voxelizer = new Voxelizer(256); // the screen space near field covers the contact detail 512^3 was needed for
+        clusterPass = new clusteredLightPass();
+        hiZ = new hiZPass(width, height);
+        ssgi = new ssgiPass(width, height);
+        bounce = new voxelBouncePass(voxelizer);
+        primaryLight = new shadowedLightPass(voxelizer);
+        lightingPass = new gBufferLightingPass(prepass, voxelizer, clusterPass, hiZ, ssgi, bounce, primaryLight, &tracerStats, width, height);
+        denoisePass = new atrousDenoisePass(width, height);
+        upscalePass = new temporalUpscalePass(width, height);
+        visibility = new visibilityBufferPass();
+        culling = new cullingPass();
+        arena = new meshArena();
+        windowWidth = width;
+        windowHeight = height;
+        renderWidth = width;
+        renderHeight = height;
         currentProj = glm::mat4(1);
         currentView = glm::mat4(1);
     
@@ -35,27 +87,72 @@ public:
         debug_params.voxel_slice = 0;
     }
 
-    void addRenderable(Renderable* r) {
-        renderables.push_back(r);
+    // owned renderables are deleted by the scene once they are removed
+    SceneRegistry::Handle addRenderable(Renderable* r, bool owned = false) {
+        return scene.add(r, owned);
+    }
+
+    bool removeRenderable(SceneRegistry::Handle handle) {
+        return scene.remove(handle);
+    }
+
+    // the lightmaps are detached first, they belong to the renderer
+    void clearScene() {
+        lightmapBaker.clear(scene.getObjects());
+        scene.clear();
+    }
+
+    // something the voxels were built from was added, removed, moved or resized since the last refreshVoxels
+    bool voxelsStale() const {
+        if (scene.getRemovals() > 0) return true;
+        auto& dirty = scene.getDirty();
+        for (size_t i = 0; i < dirty.size(); i++) {
+            if (dirty[i] && !primaryLight->excludes(scene.getObjects()[i])) return true;
+        }
+        return false;
     }
 
     void resizeWindow(int w, int h) {
-        prepass->resize(w, h);
+        windowWidth = w;
+        windowHeight = h;
+        upscalePass->resize(w, h);
+        resizeRenderTargets();
+    }
+
+    // fraction of the window resolution the G-buffer and lighting are rendered at, the resolve upscales
+    void setRenderScale(float scale) {
+        renderScale = std::clamp(scale, 0.1f, 1.0f);
+        resizeRenderTargets();
     }
+    float getRenderScale() const { return renderScale; }
 
     // call if the scene changes
     void refreshVoxels(glm::mat4& view, glm::mat4& proj) {
-        auto shaders = getShaders();
-        auto modelMatricies = getModelMatricies();
-        voxelizer->voxelize([&]() { drawAllWithoutSetUniforms(); }, modelMatricies, shaders);
+        // first, renderables whose programs became ready are voxelized with the rest instead of flagged after it
+        scene.sync();
+        // the shadowed primary light is lit analytically, its own voxels would add its light a second time
+        std::vector<Renderable*> voxelized;
+        for (auto obj : scene.getObjects())
+            if (!primaryLight->excludes(obj)) voxelized.push_back(obj);
+        arena->update(scene.getObjects());
+        MaterialTextures::get().bind();
+        voxelizer->voxelize([&]() { arena->draw(voxelized); });
+        scene.clearDirty();
+        bounce->clear();
+        primaryLight->markDirty();
+        visibility->markDirty();
+    }
+
+    // bakes the indirect diffuse of renderables that support lightmaps, call after the voxels are refreshed
+    void bakeStaticGI() {
+        cgra::gl_state::disable(GL_CULL_FACE);
+        lightmapBaker.bake(scene.getObjects(), lightingPass);
     }
 
     void render(glm::mat4& view, glm::mat4& proj) {
-        glDisable(GL_CULL_FACE);
+        cgra::gl_state::disable(GL_CULL_FACE);
         cleanDebugParams();
-        auto shaders = getShaders();
-        auto modelMatricies = getModelMatricies();
-        currentProj = proj;
+        updateFrameBudget();
         currentView = view;
 
   
@@ -64,9 +161,174 @@ public:
             return;
         }
 
-        prepass->executePrepass(shaders, [&]() {drawAll(); });
+        // the temporal upscaler needs a different sub pixel jitter every frame, debug views are left unjittered
+        bool upscale = upscalePass->params.enabled && !debug_params.gbuffer_debug_mode_on;
+        glm::mat4 renderProj = proj;
+        if (upscale) {
+            upscalePass->nextJitter();
+            renderProj = upscalePass->jitterProjection(proj, renderWidth, renderHeight);
+        }
+        else
+            upscalePass->invalidate();
+        currentProj = renderProj;
+        // the one upload of the camera and voxel constants every scene program reads
+        frameConstants& frame = frameConstants::get();
+        frame.setVoxels(voxelizer->m_params.center, voxelizer->m_params.worldSize, voxelizer->m_params.resolution, voxelizer->m_params.voxelSplatRadius);
+        frame.setCamera(view, renderProj);
 
-        lightingPass->runPass(view ,debug_params.gbuffer_debug_mode_on ? debug_params.debug_channel_index : 0);
+        // the cached transforms, bounds and programs the passes below read
+        scene.sync();
+        // the visibility buffer draws its renderables after the prepass, against the depth of everything else
+        visibility->update(scene.getObjects());
+        arena->update(scene.getObjects());
+        // the one material texture bind of the frame, the draws only pick layers
+        MaterialTextures::get().bind();
+        culling->beginFrame(renderProj * view);
+        buildFrameGraph(view, proj, renderProj, upscale);
+        graph.compile();
+        graph.execute();
+    }
+
+    // the frame as a render graph, the passes keep their permanent targets as imported resources, the denoiser
+    // iterations write to transients. Features that are off aren't read by the lighting, so their passes are culled.
+    void buildFrameGraph(glm::mat4& view, glm::mat4& proj, glm::mat4& renderProj, bool upscale) {
+        using Access = RenderGraph::Access;
+        auto& lightParams = lightingPass->params;
+        // the denoiser only makes sense for the lit image, debug views are passed through as is
+        bool denoise = denoisePass->params.enabled && denoisePass->params.iterations > 0 && !debug_params.gbuffer_debug_mode_on;
+
+        graph.reset();
+        auto gBuffer = graph.importTexture("G-buffer", prepass->getDepthTexture());
+        auto pyramid = graph.importTexture("Hi-Z", hiZ->getTexture());
+        auto clusters = graph.importTexture("light clusters");
+        auto shadowed = graph.importTexture("shadowed light", primaryLight->getInjectTexture());
+        auto bounceVolume = graph.importTexture("bounce volume", bounce->getTexture());
+        auto ssgiTex = graph.importTexture("SSGI", ssgi->getTexture());
+        auto irradiance = graph.importTexture("irradiance", lightingPass->getTarget(1));
+        auto sceneColor = graph.importTexture("scene color");
+        auto upscaled = graph.importTexture("upscale history");
+
+        graph.addPass("prepass", [&](RenderGraph::PassBuilder& pass) {
+            pass.write(gBuffer);
+        }, [this, &renderProj, &view]() {
+            prepassTimer.begin();
+            prepass->executePrepass([&]() {drawAll(); }, renderProj * view);
+            visibility->run(prepass, [&](Renderable* obj) { return culling->isVisible(obj); });
+        });
+        graph.addPass("Hi-Z", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(gBuffer);
+            pass.write(pyramid);
+            pass.sideEffect(); // the culling of the next frames reads it back
+        }, [this, &renderProj, &view]() {
+            hiZ->build(prepass->getDepthTexture());
+            culling->readback(hiZ, renderProj * view);
+            prepassTimer.end();
+        });
+        graph.addPass("light clusters", [&](RenderGraph::PassBuilder& pass) {
+            pass.write(clusters, Access::STORAGE_BUFFER);
+        }, [this, &view, &renderProj]() { clusterPass->run(view, renderProj); });
+        // the volumes are written with image stores and then sampled through their mips, the mip passes read them
+        // back so the graph puts the barrier before them
+        graph.addPass("shadowed light", [&](RenderGraph::PassBuilder& pass) {
+            pass.write(shadowed, Access::IMAGE);
+        }, [this, &lightParams]() { primaryLight->update(scene.getObjects(), lightParams.uDiffuseBrightnessMultiplier); });
+        graph.addPass("shadowed light mips", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(shadowed);
+            pass.write(shadowed);
+        }, [this]() { primaryLight->generateMips(); });
+        graph.addPass("bounce", [&](RenderGraph::PassBuilder& pass) {
+            if (primaryLight->params.enabled) pass.read(shadowed);
+            pass.write(bounceVolume, Access::IMAGE);
+        }, [this, &lightParams]() {
+            bounce->run(lightParams.uConeAperture, lightParams.uStepMultiplier, lightParams.uMaxSteps,
+                lightParams.uTransmittanceNeededForConeTermination, lightParams.uDiffuseBrightnessMultiplier,
+                primaryLight->getInjectTexture(), primaryLight->getMipOffset());
+        });
+        graph.addPass("bounce mips", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(bounceVolume);
+            pass.write(bounceVolume);
+        }, [this]() { bounce->generateMips(); });
+        graph.addPass("SSGI", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(gBuffer);
+            pass.read(pyramid);
+            pass.read(sceneColor); // last frame's
+            pass.write(ssgiTex);
+        }, [this, &view, &renderProj]() {
+            ssgi->run(prepass, lightingPass->getSceneColor(), view, renderProj, lightingPass->getPrevViewProj());
+        });
+        graph.addPass("lighting", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(gBuffer);
+            pass.read(pyramid);
+            pass.read(clusters, Access::STORAGE_BUFFER);
+            if (primaryLight->params.enabled) pass.read(shadowed);
+            if (bounce->params.enabled) pass.read(bounceVolume);
+            if (ssgi->params.enabled) pass.read(ssgiTex);
+            pass.write(irradiance);
+        }, [this, &view, &renderProj, denoise]() {
+            lightingTimer.begin();
+            lightingPass->runPass(view, renderProj, debug_params.gbuffer_debug_mode_on ? debug_params.debug_channel_index : 0, denoise);
+            lightingTimer.end();
+            tracerStats.collect(lightingPass->params.uMaxSteps);
+        });
+
+        RenderGraph::Resource filtered = irradiance;
+        if (denoise) {
+            for (int i = 0; i < denoisePass->params.iterations; i++) {
+                RenderGraph::Resource source = filtered;
+                RenderGraph::Resource target = graph.createTexture("denoise " + std::to_string(i), denoisePass->getTargetDesc());
+                graph.addPass("denoise " + std::to_string(i), [&](RenderGraph::PassBuilder& pass) {
+                    pass.read(gBuffer);
+                    pass.read(source);
+                    pass.write(target);
+                }, [this, i, source, target]() {
+                    denoisePass->runIteration(i, graph.getTexture(source), graph.getTexture(target), prepass);
+                });
+                filtered = target;
+            }
+        }
+
+        graph.addPass("composite", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(irradiance);
+            pass.read(filtered);
+            pass.write(sceneColor);
+        }, [this, filtered, denoise]() { lightingPass->runComposite(graph.getTexture(filtered), denoise); });
+
+        RenderGraph::Resource finalColor = sceneColor;
+        if (upscale) {
+            graph.addPass("temporal upscale", [&](RenderGraph::PassBuilder& pass) {
+                pass.read(sceneColor);
+                pass.read(gBuffer);
+                pass.write(upscaled);
+            }, [this, &view, &proj]() { upscaledColor = upscalePass->run(lightingPass->getSceneColor(), prepass, view, proj); });
+            finalColor = upscaled;
+        }
+
+        graph.addPass("resolve", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(finalColor);
+            pass.sideEffect(); // draws to the window
+        }, [this, upscale]() {
+            GLuint color = upscale ? upscaledColor : lightingPass->getSceneColor();
+            cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+            lightingPass->runResolve(color, windowWidth, windowHeight, upscale ? upscalePass->params.sharpness : 0.0f);
+        });
+    }
+
+    // feeds last frames GPU timings to the budget controller and applies whatever it decided
+    void updateFrameBudget() {
+        auto& params = lightingPass->params;
+        FrameBudgetController::FrameTimings timings{
+            prepassTimer.getMs(),
+            lightingTimer.getMs() + ssgi->getLastPassMs(),
+            denoisePass->params.enabled ? denoisePass->getLastPassMs() : 0.0f };
+        FrameBudgetController::QualityState quality{ renderScale, params.uNumDiffuseCones, params.uMaxSteps, params.uStepMultiplier };
+
+        if (!budgetController.update(timings, quality)) return;
+
+        params.uNumDiffuseCones = quality.numDiffuseCones;
+        params.uMaxSteps = quality.maxSteps;
+        params.uStepMultiplier = quality.stepMultiplier;
+        if (quality.renderScale != renderScale)
+            setRenderScale(quality.renderScale);
     }
 
     void cleanDebugParams() { // make sure the params make sense, eg. only one debug mode is on
@@ -76,35 +338,51 @@ public:
 
     glm::mat4 currentView;
     glm::mat4 currentProj;
+    int windowWidth;
+    int windowHeight;
+    int renderWidth;
+    int renderHeight;
+    float renderScale = 1.0f;
+    GLuint upscaledColor = 0;
 
-    std::vector<glm::mat4> getModelMatricies() {
-        std::vector<glm::mat4> out{};
-        for (auto obj : renderables) {
-            auto shaders = obj->getShaders();
-            for(auto x : shaders)
-                out.push_back(obj->getModelTransform());
-        }
-        return out;
-    }
-    std::vector<GLuint> getShaders() {
-        std::vector<GLuint> out{};
-        for (auto obj : renderables) {
-            auto shaders = obj->getShaders();
-            for (auto s : shaders) 
-                out.push_back(s);
-        }
-        return out;
+    void resizeRenderTargets() {
+        renderWidth = std::max(1, int(std::round(windowWidth * renderScale)));
+        renderHeight = std::max(1, int(std::round(windowHeight * renderScale)));
+        prepass->resize(renderWidth, renderHeight);
+        hiZ->resize(renderWidth, renderHeight);
+        ssgi->resize(renderWidth, renderHeight);
+        lightingPass->resize(renderWidth, renderHeight);
+        denoisePass->resize(renderWidth, renderHeight);
+        graph.releasePool(); // the transients are sized to the render targets
     }
+
     void drawAllWithoutSetUniforms() {
-        for (auto obj : renderables) {
+        for (auto obj : scene.getObjects()) {
             obj->draw();
         }
     }
     void drawAll() {
-        for (auto obj : renderables) {
-            obj->setProjViewUniforms(currentView, currentProj);
-            obj->draw();
+        // sorted by program and textures, front to back inside a group
+        glm::mat4 viewProj = currentProj * currentView;
+        float farPlane = currentProj[3][2] / (currentProj[2][2] + 1); // of the perspective projection
+        queue.clear();
+        auto& objects = scene.getObjects();
+        auto& bounds = scene.getBounds();
+        auto& shaders = scene.getShaders();
+        for (size_t i = 0; i < objects.size(); i++) {
+            if (visibility->handles(objects[i]) || !culling->isVisible(bounds[i])) continue;
+            float depth = 0; // unbounded renderables (the terrain) go first, they hide the most
+            if (bounds[i].valid) {
+                glm::vec4 clip = viewProj * glm::vec4((bounds[i].min + bounds[i].max) * 0.5f, 1);
+                depth = clip.w / farPlane; // the view distance, linear unlike NDC depth so the key's bits spread evenly
+            }
+            queue.submit(renderQueue::PREPASS, objects[i], shaders[i], depth);
         }
+
+        // the camera is in the frame constants, the arena sets the model matrix of what it doesn't batch
+        std::vector<Renderable*> visible;
+        for (auto& item : queue.sort()) visible.push_back(item.obj);
+        arena->draw(visible);
     }
 };
 #endif
@@ -0,0 +1,127 @@
+#include "simulation.hpp"
+#include <algorithm>
+
+Simulation::~Simulation() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void Simulation::ensureStarted() {
+    if (!thread.joinable()) thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::startErosion(const std::vector<float>& heights, int width, int height, const Terrain::ErosionSettings& settings) {
+    ensureStarted();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        erosionRequested = true;
+        erosionAborted = false;
+        erosionHeights = heights;
+        erosionWidth = width;
+        erosionHeight = height;
+        erosionSettings = settings;
+        requestedErosionRun = ++erosionRun;
+    }
+    wake.notify_one();
+}
+
+void Simulation::abortErosion() {
+    std::lock_guard<std::mutex> lock(mutex);
+    erosionRequested = false;
+    erosionAborted = true;
+    erosionRun++; // whatever is still in flight is stale
+}
+
+const Simulation::ErosionSnapshot* Simulation::pollErosion() {
+    if (!erosionSnapshots.update()) return nullptr;
+    const ErosionSnapshot& snapshot = erosionSnapshots.front();
+    return snapshot.run == erosionRun ? &snapshot : nullptr;
+}
+
+void Simulation::grow(std::vector<plant::PlantGrowth> plants, int steps) {
+    ensureStarted();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        growthRequested = true;
+        growthPlants = std::move(plants);
+        growthSteps = steps;
+        requestedGrowthJob = ++growthJob;
+    }
+    wake.notify_one();
+}
+
+void Simulation::cancelGrowth() {
+    std::lock_guard<std::mutex> lock(mutex);
+    growthRequested = false;
+    growthPlants.clear();
+    growthJob++;
+}
+
+const std::vector<plant::PlantGrowth>* Simulation::pollGrowth() {
+    if (!growthSnapshots.update()) return nullptr;
+    const GrowthSnapshot& snapshot = growthSnapshots.front();
+    return snapshot.job == growthJob ? &snapshot.plants : nullptr;
+}
+
+void Simulation::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || erosionRequested || erosionAborted || growthRequested || eroding; });
+        if (stopping) return;
+
+        // take the requests over, the work is done without the lock
+        if (erosionAborted) {
+            eroding = false;
+            erosionAborted = false;
+        }
+        if (erosionRequested) {
+            erosion.settings = erosionSettings;
+            erosion.newSimulation(erosionHeights, erosionWidth, erosionHeight);
+            currentErosionRun = requestedErosionRun;
+            eroding = true;
+            erosionRequested = false;
+        }
+        bool growing = growthRequested;
+        std::vector<plant::PlantGrowth> plants;
+        int steps = growthSteps;
+        uint64_t job = requestedGrowthJob;
+        if (growing) {
+            plants = std::move(growthPlants);
+            growthPlants.clear();
+            growthRequested = false;
+        }
+        lock.unlock();
+
+        if (growing) {
+            for (auto& growth : plants) plant::PlantGrowth::derive(growth, steps);
+            GrowthSnapshot& snapshot = growthSnapshots.back();
+            snapshot.plants = std::move(plants);
+            snapshot.job = job;
+            growthSnapshots.publish();
+        }
+
+        if (eroding) {
+            erosion.stepSimulation();
+
+            ErosionSnapshot& snapshot = erosionSnapshots.back();
+            const std::vector<float>& heights = erosion.getHeightmap();
+            snapshot.heightmap = heights;
+            snapshot.pixels.resize(heights.size());
+            for (size_t i = 0; i < heights.size(); i++) {
+                snapshot.pixels[i] = static_cast<uint16_t>(std::clamp(heights[i], 0.0f, 1.0f) * UINT16_MAX);
+            }
+            snapshot.iterations_ran = erosion.iterations_ran;
+            snapshot.finished = erosion.iterations_ran >= erosion.settings.iterations;
+            snapshot.run = currentErosionRun;
+            erosionSnapshots.publish();
+            if (snapshot.finished) eroding = false;
+        }
+
+        lock.lock();
+    }
+}
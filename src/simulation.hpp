@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tripleBuffer.hpp"
+#include "terrain/HydraulicErosion.hpp"
+#include "plant/plant.hpp"
+
+// The thread real-time erosion and plant growth run on, so the render thread never waits on them. Requests come
+// in under a mutex (they are rare), results go out as snapshots through triple buffers: the render thread polls
+// once a frame, takes the latest snapshot and only uploads it. Erosion is stepped particles_per_frame droplets at
+// a time as fast as the thread goes, with a snapshot after every step, the renderer just shows the newest one.
+// The thread is started by the first request and stopped by the destructor.
+class Simulation {
+public:
+	struct ErosionSnapshot {
+		std::vector<float> heightmap;
+		std::vector<uint16_t> pixels; // the heightmap as Terrain::Noise uploads it, converted on the thread
+		int iterations_ran = 0;
+		bool finished = false;
+		uint64_t run = 0; // the startErosion() it belongs to
+	};
+
+	Simulation() = default;
+	~Simulation();
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	// replaces a running erosion
+	void startErosion(const std::vector<float>& heights, int width, int height, const Terrain::ErosionSettings& settings);
+	void abortErosion();
+	// the newest snapshot of the current erosion if there is one since the last call, nullptr otherwise
+	const ErosionSnapshot* pollErosion();
+
+	// derives the plants, replacing a growth that hasn't started yet
+	void grow(std::vector<plant::PlantGrowth> plants, int steps);
+	// drops the growth that is running, pollGrowth() won't return it
+	void cancelGrowth();
+	// the grown plants in the order grow() was given them, once they are done, nullptr until then
+	const std::vector<plant::PlantGrowth>* pollGrowth();
+
+private:
+	struct GrowthSnapshot {
+		std::vector<plant::PlantGrowth> plants;
+		uint64_t job = 0;
+	};
+
+	void run();
+	void ensureStarted();
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// requests, guarded by mutex
+	bool erosionRequested = false;
+	bool erosionAborted = false;
+	std::vector<float> erosionHeights;
+	int erosionWidth = 0, erosionHeight = 0;
+	Terrain::ErosionSettings erosionSettings;
+	bool growthRequested = false;
+	std::vector<plant::PlantGrowth> growthPlants;
+	int growthSteps = 0;
+
+	// render thread only
+	uint64_t erosionRun = 0;
+	uint64_t growthJob = 0;
+	// handed over with the requests, stamped on the snapshots, so results of an earlier request are dropped
+	uint64_t requestedErosionRun = 0;
+	uint64_t requestedGrowthJob = 0;
+
+	// simulation thread only
+	Terrain::HydraulicErosion erosion{0, 0};
+	bool eroding = false;
+	uint64_t currentErosionRun = 0;
+
+	TripleBuffer<ErosionSnapshot> erosionSnapshots;
+	TripleBuffer<GrowthSnapshot> growthSnapshots;
+};
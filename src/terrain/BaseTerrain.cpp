@@ -10,16 +10,19 @@
 #include <print>
 #include <functional>
 #include "opengl.hpp"
+#include "vct/materialTextures.hpp"
+#include "simulation.hpp"
+#include "vct/lightmapBaker.hpp"
 
 using namespace Terrain;
 using namespace glm;
 
 // TODO - not the nicest, maybe redo this lmao (why do i have to redefine them here...)
-GLuint Textures::water = 0;
-GLuint Textures::sand = 0;
-GLuint Textures::grass = 0;
-GLuint Textures::rock = 0;
-GLuint Textures::snow = 0;
+int Textures::water = 0;
+int Textures::sand = 0;
+int Textures::grass = 0;
+int Textures::rock = 0;
+int Textures::snow = 0;
 
 static PlaneTerrain CreateBasicPlane(int x_sub, int z_sub);
 
@@ -28,72 +31,76 @@ BaseTerrain::BaseTerrain() : t_erosion(t_noise.width, t_noise.height) {
 	cgra::shader_builder sb;
 	sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//terrain//basic_terrain.vs"));
 	sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//terrain//basic_terrain.fs"));
-	shader = sb.build();
+	shader = sb.submit();
 
 	t_mesh.updateTransformCentered(t_settings.model_scale);
 	loadTextures();
+}
 
+void BaseTerrain::onProgramReady() {
 	// Set up the texture uniforms cuz only need to do once
-	glUseProgram(shader);
+	cgra::gl_state::use_program(shader);
 	glUniform1i(glGetUniformLocation(shader, "heightMap"), 0);
-	glUniform1i(glGetUniformLocation(shader, "water_texture"), 1);
-	glUniform1i(glGetUniformLocation(shader, "sand_texture"), 2);
-	glUniform1i(glGetUniformLocation(shader, "grass_texture"), 3);
-	glUniform1i(glGetUniformLocation(shader, "rock_texture"), 4);
-	glUniform1i(glGetUniformLocation(shader, "snow_texture"), 5);
+	glUniform1i(glGetUniformLocation(shader, "lightmap"), 6);
+	// the material textures are layers of the registry's array, which stays bound to its own unit
+	MaterialTextures::setSampler(shader);
+	glUniform1i(glGetUniformLocation(shader, "water_layer"), water_texture);
+	glUniform1i(glGetUniformLocation(shader, "sand_layer"), sand_texture);
+	glUniform1i(glGetUniformLocation(shader, "grass_layer"), dirt_texture);
+	glUniform1i(glGetUniformLocation(shader, "rock_layer"), rock_texture);
+	glUniform1i(glGetUniformLocation(shader, "snow_layer"), snow_texture);
+
+	// the per draw uniforms, so draw() never looks a name up
+	static const char* names[UNIFORM_COUNT] = {
+		"uModelMatrix", "uColor", "max_height", "useTexturing",
+		"useFakedLighting", "subdivisions", "amplitude", "draw_from_min",
+		"min_height", "min_rock_slope", "max_grass_slope", "terrain_size_scalar",
+		"use_triplanar_mapping", "tex_base_scalar", "triplanar_sharpness", "useLightmap" };
+	for (int i = 0; i < UNIFORM_COUNT; i++) locations[i] = glGetUniformLocation(shader, names[i]);
+}
+
+BaseTerrain::~BaseTerrain() {
+	if (erosion_running && simulation) simulation->abortErosion();
 }
 
-void BaseTerrain::setProjViewUniforms(const glm::mat4 &view, const glm::mat4 &proj) const {
-	glUseProgram(shader);
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, value_ptr(proj));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, false, value_ptr(t_mesh.init_transform));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, false, value_ptr(view));
+void BaseTerrain::setObjectUniforms() const {
+	cgra::gl_state::use_program(shader);
+	glUniformMatrix4fv(locations[MODEL], 1, false, value_ptr(t_mesh.init_transform));
 }
 
 
 void BaseTerrain::draw() {
-	if (erosion_running) {
+	if (erosion_running && !simulation) {
 		stepErosion();
 	}
 
-	glUseProgram(shader);
-	glUniform3fv(glGetUniformLocation(shader, "uColor"), 1, value_ptr(vec3{1, 1, 1}));
-
-	glUniform1f(glGetUniformLocation(shader, "max_height"), t_settings.max_height);
-	glUniform1i(glGetUniformLocation(shader, "useTexturing"), useTexturing);
-	glUniform1i(glGetUniformLocation(shader, "useFakedLighting"), useFakedLighting);
-	glUniform1i(glGetUniformLocation(shader, "subdivisions"), plane_subs);
-	glUniform1f(glGetUniformLocation(shader, "amplitude"), t_settings.amplitude);
-	glUniform1i(glGetUniformLocation(shader, "draw_from_min"), draw_from_min);
-	glUniform1f(glGetUniformLocation(shader, "min_height"), t_noise.min_height);
-
-	glUniform1f(glGetUniformLocation(shader, "min_rock_slope"), t_settings.min_rock_slope);
-	glUniform1f(glGetUniformLocation(shader, "max_grass_slope"), t_settings.max_grass_slope);
-
-	glUniform1f(glGetUniformLocation(shader, "terrain_size_scalar"), t_settings.model_scale.x);
-	glUniform1i(glGetUniformLocation(shader, "use_triplanar_mapping"), t_settings.use_triplanar_mapping);
-	glUniform1f(glGetUniformLocation(shader, "tex_base_scalar"), t_settings.tex_base_scalar);
-	glUniform1f(glGetUniformLocation(shader, "triplanar_sharpness"), t_settings.triplanar_sharpness);
+	cgra::gl_state::use_program(shader);
+	glUniform3fv(locations[COLOR], 1, value_ptr(vec3{1, 1, 1}));
+
+	glUniform1f(locations[MAX_HEIGHT], t_settings.max_height);
+	glUniform1i(locations[USE_TEXTURING], useTexturing);
+	glUniform1i(locations[USE_FAKED_LIGHTING], useFakedLighting);
+	glUniform1i(locations[SUBDIVISIONS], plane_subs);
+	glUniform1f(locations[AMPLITUDE], t_settings.amplitude);
+	glUniform1i(locations[DRAW_FROM_MIN], draw_from_min);
+	glUniform1f(locations[MIN_HEIGHT], t_noise.min_height);
+
+	glUniform1f(locations[MIN_ROCK_SLOPE], t_settings.min_rock_slope);
+	glUniform1f(locations[MAX_GRASS_SLOPE], t_settings.max_grass_slope);
+
+	glUniform1f(locations[TERRAIN_SIZE_SCALAR], t_settings.model_scale.x);
+	glUniform1i(locations[USE_TRIPLANAR_MAPPING], t_settings.use_triplanar_mapping);
+	glUniform1f(locations[TEX_BASE_SCALAR], t_settings.tex_base_scalar);
+	glUniform1f(locations[TRIPLANAR_SHARPNESS], t_settings.triplanar_sharpness);
+	glUniform1i(locations[USE_LIGHTMAP], lightmap != 0);
 	
-	glActiveTexture(GL_TEXTURE0);
+	cgra::gl_state::active_texture(GL_TEXTURE0);
 	// glUniform1i(glGetUniformLocation(shader, "heightMap"), 0);
-	glBindTexture(GL_TEXTURE_2D, t_noise.texID);
-
-	// Water
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, water_texture);
-	// Sand
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, sand_texture);
-	// Grass
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, dirt_texture);
-	// Rock
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, rock_texture);
-	// Snow
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, snow_texture);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, t_noise.texID);
+
+	// Baked GI
+	cgra::gl_state::active_texture(GL_TEXTURE6);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, lightmap);
 
 	t_mesh.mesh.draw();
 }
@@ -159,12 +166,12 @@ void BaseTerrain::renderUI() {
 		if (ImGui::DragFloat("Sea size scalar", &water_plane->size_scalar, 0.01f, 2.5f)) {
 			water_plane->update_transform(vec3(t_settings.model_scale), t_settings.sea_level);
 		}
-		if (ImGui::Button("Make Water Reflective (FPS Heavy)")) {
+		if (ImGui::Button("Make Water Reflective")) {
 			water_plane->smoothness = WaterPlane::SHINY_SMOOTHNESS;
 		}
 		ImGui::DragFloat("Wave Speed", &water_plane->wave_speed, 0.0001f, 0.001f, 0.5f, "%.5f");
 		ImGui::SliderFloat("Water metallicness", &water_plane->metallic, 0.0f, 1.0f);
-		ImGui::SliderFloat("Water smoothness (fps heavy)", &water_plane->smoothness, 0.0f, 1.0f);
+		ImGui::SliderFloat("Water smoothness", &water_plane->smoothness, 0.0f, 1.0f);
 	}
 
 	ImGui::Separator();
@@ -194,7 +201,10 @@ void BaseTerrain::renderUI() {
 	if (!erosion_running) {
 		if (ImGui::Button("Start real-time erosion")) {
 			erosion_running = true;
+			// the heightmap changes every step, the bake no longer matches
+			if (lightmap_baker) lightmap_baker->invalidate(this);
 			t_erosion.newSimulation(t_noise.heightmap, t_noise.width, t_noise.height);
+			if (simulation) simulation->startErosion(t_noise.heightmap, t_noise.width, t_noise.height, t_erosion.settings);
 		}
 	} else {
 		ImGui::Text("Erosion sim running..");
@@ -203,6 +213,7 @@ void BaseTerrain::renderUI() {
 		ImGui::Text("Currently on iteration %d / %d", t_erosion.iterations_ran, t_erosion.settings.iterations);
 		if (ImGui::Button("Abort")) {
 			erosion_running = false;
+			if (simulation) simulation->abortErosion();
 		}
 	}
 
@@ -236,11 +247,12 @@ void BaseTerrain::loadTextures() {
 	static const std::string ROCK_PATH = CGRA_SRCDIR + std::string("//res//textures//terrain//rock.jpg");
 	static const std::string SNOW_PATH = CGRA_SRCDIR + std::string("//res//textures//terrain//snow.jpg");
 
-	Textures::water = cgra::rgba_image(WATER_PATH).uploadTexture();
-	Textures::sand = cgra::rgba_image(SAND_PATH).uploadTexture();
-	Textures::grass = cgra::rgba_image(GRASS_PATH).uploadTexture();
-	Textures::rock = cgra::rgba_image(ROCK_PATH).uploadTexture();
-	Textures::snow = cgra::rgba_image(SNOW_PATH).uploadTexture();
+	MaterialTextures& textures = MaterialTextures::get();
+	Textures::water = textures.load(WATER_PATH);
+	Textures::sand = textures.load(SAND_PATH);
+	Textures::grass = textures.load(GRASS_PATH);
+	Textures::rock = textures.load(ROCK_PATH);
+	Textures::snow = textures.load(SNOW_PATH);
 
 	water_texture = Textures::water;
 	sand_texture = Textures::sand;
@@ -257,8 +269,17 @@ mat4 BaseTerrain::getModelTransform() {
 	return t_mesh.init_transform;
 }
 
+bool BaseTerrain::supportsLightmap() {
+	return true;
+}
+
+void BaseTerrain::setBakedLightmap(GLuint texture) {
+	lightmap = texture;
+}
+
 // Get the heightmap from noise, apply erosion and then update the heightmap texture
 void BaseTerrain::applyErosion() {
+	if (lightmap_baker) lightmap_baker->invalidate(this); // heightmap changes, the bake no longer matches
 	t_erosion.newSimulation(t_noise.heightmap, t_noise.width, t_noise.height);
 	t_erosion.simulate();
 	t_noise.setHeightmap(t_erosion.getHeightmap());
@@ -272,6 +293,20 @@ void BaseTerrain::stepErosion() {
 	}
 }
 
+void BaseTerrain::updateErosion() {
+	if (!erosion_running || !simulation) return;
+	const Simulation::ErosionSnapshot* snapshot = simulation->pollErosion();
+	if (!snapshot) return;
+
+	// converted on the simulation thread already, only the copy and the upload are left
+	t_noise.heightmap = snapshot->heightmap;
+	t_noise.setHeightPixels(snapshot->pixels);
+	t_erosion.iterations_ran = snapshot->iterations_ran; // for the progress bar
+	if (snapshot->finished) {
+		erosion_running = false;
+	}
+}
+
 // TODO - implement the sending to the plant manager object thing
 void BaseTerrain::calculateAndSendTreePlacements(const int seed) {
 	std::mt19937 rng = (seed == -1) ? std::mt19937(std::random_device()()) : std::mt19937(seed);
@@ -8,6 +8,9 @@
 #include <functional>
 #include "cgra/cgra_mesh.hpp"
 
+class Simulation;
+class LightmapBaker;
+
 namespace Terrain {
 
 	struct TreePlacementSettings {
@@ -39,12 +42,13 @@ namespace Terrain {
 		void updateTransformCentered(glm::vec3 scale);
 	};
 
+	// layers in the material texture array (vct/materialTextures.hpp)
 	struct Textures {
-		static GLuint water;
-		static GLuint sand;
-		static GLuint grass;
-		static GLuint rock;
-		static GLuint snow;
+		static int water;
+		static int sand;
+		static int grass;
+		static int rock;
+		static int snow;
 	};
 	
 	class BaseTerrain : public Renderable {
@@ -62,22 +66,26 @@ namespace Terrain {
 
 		HydraulicErosion t_erosion;
 		bool erosion_running = false; // Whether or not the erosion sim is currently running (in real-time)
+		Simulation* simulation = nullptr; // Runs the real-time erosion off the render thread, stepped in draw() without one
 
 		bool useTexturing = true;
-		GLuint water_texture; // The first texture, bottom most (default water)
-		GLuint sand_texture; // The second texture (default sand)
-		GLuint dirt_texture; // Third texture (default dirt)
-		GLuint rock_texture; // Forth texture (default rock)
-		GLuint snow_texture; // Fifth texture (default snow)
+		int water_texture; // The first texture, bottom most (default water), a material array layer like the rest
+		int sand_texture; // The second texture (default sand)
+		int dirt_texture; // Third texture (default dirt)
+		int rock_texture; // Forth texture (default rock)
+		int snow_texture; // Fifth texture (default snow)
 
 		WaterPlane* water_plane = nullptr; // The water plane (passed as pointer so renderer can draw it and terrain can set settings)
 
+		GLuint lightmap = 0; // baked indirect diffuse, owned by the renderer's LightmapBaker, 0 = trace every frame
+		LightmapBaker* lightmap_baker = nullptr; // Told when the heightmap changes, so it frees the stale bake
 		bool useFakedLighting = false; // whether to use faked lighting for testing
 		bool draw_from_min = true; // Whether or not to get the terrain shader to draw with the min height at y=0
 
 		void renderUI();
 		void plantUI(std::function<void()>f);
 		BaseTerrain();
+		~BaseTerrain();
 		// Regenerate the plane mesh with a specific subdivision count
 		void changePlaneSubdivision(int subs);
 
@@ -85,22 +93,30 @@ namespace Terrain {
 		void applyErosion();
 		// Step real-time erosion simulation once
 		void stepErosion();
+		// Upload the newest real-time erosion snapshot of the simulation thread, if any. Once a frame
+		void updateErosion();
 
 		GLuint getShader() override;
-		void setProjViewUniforms(const glm::mat4 &view, const glm::mat4 &proj) const override;
+		void onProgramReady() override;
+		void setObjectUniforms() const override;
 		void draw() override;
 		glm::mat4 getModelTransform() override;
+		bool supportsLightmap() override;
+		void setBakedLightmap(GLuint texture) override;
 
 		// Calculate new tree placement positions based on tree_settings and send the data to the plant manager
 		void calculateAndSendTreePlacements(int seed = -1);
 		// Basic function to send a vector of tree positions to the tree manager, send empty to prevent trees maybe
 		void sendTreePlacements(std::vector<plant::plants_manager_input> &positions);
+		// Take a vec2 of x,z position from 0-1 and map it to the actual terrain position when rendered (using the size scalars and heightmap etc)
+		glm::vec3 normalizedXZToWorldPos(const glm::vec2& n_pos);
 
 	private:
+		enum Uniform { MODEL, COLOR, MAX_HEIGHT, USE_TEXTURING, USE_FAKED_LIGHTING, SUBDIVISIONS, AMPLITUDE, DRAW_FROM_MIN, MIN_HEIGHT, MIN_ROCK_SLOPE, MAX_GRASS_SLOPE, TERRAIN_SIZE_SCALAR, USE_TRIPLANAR_MAPPING, TEX_BASE_SCALAR, TRIPLANAR_SHARPNESS, USE_LIGHTMAP, UNIFORM_COUNT };
+		GLint locations[UNIFORM_COUNT]; // of the uniforms draw() sets, looked up in onProgramReady()
+
 		// Load the textures for the terrain and store them in the fields
 		void loadTextures();
-		// Take a vec2 of x,z position from 0-1 and map it to the actual terrain position when rendered (using the size scalars and heightmap etc)
-		glm::vec3 normalizedXZToWorldPos(const glm::vec2& n_pos);
 		// Approximate the y position at provided normalize 0-1 x,z point and return the float value
 		float approximateYAtPoint(const glm::vec2& pos);
 	};
@@ -274,7 +274,7 @@ void HydraulicErosion::renderUI(bool use_own_window) {
     
 	if (ImGui::CollapsingHeader("Basic Erosion Settings")) {
 		settingsChanged |= ImGui::SliderInt("Iterations", &erosionSettings.iterations, 1000, 500000);
-		ImGui::SliderInt("Iterations per frame (real-time)", &erosionSettings.particles_per_frame, 1, erosionSettings.iterations-1);
+		ImGui::SliderInt("Iterations per step (real-time)", &erosionSettings.particles_per_frame, 1, erosionSettings.iterations-1);
 		settingsChanged |= ImGui::SliderInt("Max Particle Lifetime", &erosionSettings.max_lifetime, 10, 100);
 		settingsChanged |= ImGui::SliderFloat("Inertia", &erosionSettings.inertia, 0.0f, 1.0f);
 		settingsChanged |= ImGui::SliderInt("Erosion Radius", &erosionSettings.erosion_radius, 1, 10);
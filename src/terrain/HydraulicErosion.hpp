@@ -30,7 +30,7 @@ namespace Terrain {
 		float start_water = 1.0f;        // Initial droplet water volume
 		int erosion_radius = 3;          // Radius of erosion brush
 
-		int particles_per_frame = 5000; // Number of particles/ iterations to simulate each frame when running in real-time
+		int particles_per_frame = 5000; // Number of particles/ iterations to simulate per step when running in real-time (a snapshot is published after each)
 	};
 
 	class HydraulicErosion {
@@ -215,12 +215,12 @@ void Noise::makeEditUI(bool use_own_window) {
 void Noise::updateTexture(bool reuse_old) {
 	if (!reuse_old) {throw std::runtime_error("not implemented");}
 
-	glBindTexture(GL_TEXTURE_2D, texID);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, texID);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
 					width, height, GL_RED, GL_UNSIGNED_SHORT,
 					pixels.data());
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, 0);
 }
 
 // Updates the heightmap vector using the noise generator (with values mapped to
@@ -323,7 +323,7 @@ void Noise::createTexture() {
 	if (texID == 0) { // Generate new texID if hasn't been created
 		glGenTextures(1, &texID);
 	}
-	glBindTexture(GL_TEXTURE_2D, texID);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, texID);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -339,7 +339,7 @@ void Noise::createTexture() {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, 0);
 }
 
 
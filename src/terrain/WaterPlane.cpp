@@ -28,15 +28,21 @@ WaterPlane::WaterPlane(GLuint texid) : plane_mesh(cgra::CREATE_PLANE(256, 256, 2
 		cgra::shader_builder sb;
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//terrain//water_plane.vs"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//terrain//water_plane.fs"));
-		shader = sb.build();
+		shader = sb.submit();
 	}
 
 	update_transform({5.0f, 2.5f, 5.0f}, 0.0f);
+}
 
-	glUseProgram(shader);
+void WaterPlane::onProgramReady() {
+	cgra::gl_state::use_program(shader);
 	glUniform1i(glGetUniformLocation(shader, "water_texture"), 0);
 	glUniform1i(glGetUniformLocation(shader, "water_normal_texture"), 1);
 	glUniform1i(glGetUniformLocation(shader, "water_dudv_texture"), 2);
+	model_location = glGetUniformLocation(shader, "uModelMatrix");
+	metallic_location = glGetUniformLocation(shader, "metallic");
+	smoothness_location = glGetUniformLocation(shader, "smoothness");
+	move_factor_location = glGetUniformLocation(shader, "move_factor");
 }
 
 void WaterPlane::update_transform(glm::vec3 model_scale, float sea_level) {
@@ -55,28 +61,26 @@ GLuint WaterPlane::getShader() {
 	return shader;
 }
 
-void WaterPlane::setProjViewUniforms(const glm::mat4 &view, const glm::mat4 &proj) const {
-	glUseProgram(shader);
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, false, value_ptr(proj));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, false, value_ptr(model_transform));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, false, value_ptr(view));
+void WaterPlane::setObjectUniforms() const {
+	cgra::gl_state::use_program(shader);
+	glUniformMatrix4fv(model_location, 1, false, value_ptr(model_transform));
 }
 
 void WaterPlane::draw() {
-	glUseProgram(shader);
+	cgra::gl_state::use_program(shader);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, water_texture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, water_normal_texture);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, water_dudv_texture);
+	cgra::gl_state::active_texture(GL_TEXTURE0);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, water_texture);
+	cgra::gl_state::active_texture(GL_TEXTURE1);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, water_normal_texture);
+	cgra::gl_state::active_texture(GL_TEXTURE2);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, water_dudv_texture);
 
-	glUniform1f(glGetUniformLocation(shader, "metallic"), metallic);
-	glUniform1f(glGetUniformLocation(shader, "smoothness"), smoothness);
+	glUniform1f(metallic_location, metallic);
+	glUniform1f(smoothness_location, smoothness);
 	move_factor += wave_speed;
 	move_factor = fmodf(move_factor, 1.0f);
-	glUniform1f(glGetUniformLocation(shader, "move_factor"), move_factor);
+	glUniform1f(move_factor_location, move_factor);
 
 	plane_mesh.draw();
 }
@@ -36,8 +36,16 @@ namespace Terrain {
 
 		// Renderable methods
 		GLuint getShader() override;
-		void setProjViewUniforms(const glm::mat4 &view, const glm::mat4 &proj) const override;
+		void onProgramReady() override;
+		void setObjectUniforms() const override;
 		void draw() override;
 		glm::mat4 getModelTransform() override; // Get the model transform,
+
+	private:
+		// uniform locations, looked up once the shader is built
+		GLint model_location = -1;
+		GLint metallic_location = -1;
+		GLint smoothness_location = -1;
+		GLint move_factor_location = -1;
 	};
 }
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without either waiting on the other. There are three
+// slots: the writer fills its back slot and publish() swaps it with the middle one, the reader's update() swaps the
+// middle one with its front slot if something was published since. Neither side ever touches a slot the other one
+// holds, and the reader always gets the latest value, earlier ones it never picked up are simply overwritten.
+// The slots are reused, so a value that keeps its allocations (vectors assigned to, not replaced) costs no
+// allocation after the first three.
+template <typename T>
+class TripleBuffer {
+public:
+	// writer side, the slot to fill before publish(). It holds whatever was in it last, not the last value published
+	T& back() { return slots[backIndex]; }
+
+	void publish() {
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader side, true if front() changed to a newer value
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& front() const { return slots[frontIndex]; }
+
+private:
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH = 4; // set in middle while it holds a value the reader hasn't seen
+
+	std::array<T, 3> slots;
+	int backIndex = 0;
+	std::atomic<int> middle{1};
+	int frontIndex = 2;
+};
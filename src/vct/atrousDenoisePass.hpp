@@ -0,0 +1,114 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <stdexcept>
+#include <string>
+#include <cgra/cgra_shader.hpp>
+#include "gBufferPrepass.hpp"
+#include "fullscreenQuad.hpp"
+#include "gpuTimer.hpp"
+#include "renderGraph.hpp"
+#include "uniformLocations.hpp"
+
+// Edge aware a-trous wavelet filter for the indirect diffuse buffer written by the lighting pass.
+// Each iteration applies a 5x5 B3 spline kernel with holes (step width doubles every iteration),
+// weights are attenuated by the G-buffer normal, position and the local luminance variance so
+// detail at geometric edges survives while the per pixel cone noise is smoothed out. The iterations write
+// to targets the caller provides (transients of the render graph), see getTargetDesc().
+class atrousDenoisePass {
+public:
+	struct denoise_params {
+		bool enabled;
+		int iterations;
+		float sigmaNormal;     // exponent applied to dot(n, nq), higher = sharper normal edges
+		float sigmaPosition;   // world space distance falloff
+		float sigmaLuminance;  // how many standard deviations of luminance difference are tolerated
+	};
+	denoise_params params;
+
+	atrousDenoisePass(int targetWidth, int targetHeight)
+		: width(targetWidth), height(targetHeight) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//atrous_denoise_frag.glsl"));
+		shader = sb.build();
+
+		cgra::gl_state::use_program(shader);
+		glUniform1i(glGetUniformLocation(shader, "uInput"), 0);
+		glUniform1i(glGetUniformLocation(shader, "gBufferDepth"), 1);
+		glUniform1i(glGetUniformLocation(shader, "gBufferNormal"), 2);
+
+		glGenFramebuffers(1, &fbo);
+		setDefaultParams();
+	}
+
+	~atrousDenoisePass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		cgra::gl_state::delete_framebuffers(1, &fbo);
+	}
+
+	void setDefaultParams() {
+		params.enabled = false;
+		params.iterations = 4;
+		params.sigmaNormal = 64.0;
+		params.sigmaPosition = 0.5;
+		params.sigmaLuminance = 4.0;
+	}
+
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+	}
+
+	// what each iteration writes to
+	RenderGraph::TextureDesc getTargetDesc() const { return { width, height, GL_RGBA16F }; }
+
+	// one iteration of the filter from source into target, iterations run in order from 0 to params.iterations - 1
+	void runIteration(int iteration, GLuint source, GLuint target, const gBufferPrepass* prepass) {
+		if (iteration == 0) timer.begin();
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Denoise framebuffer is not complete!");
+		}
+		cgra::gl_state::viewport(0, 0, width, height);
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		glUniform1f(u[SIGMA_NORMAL], params.sigmaNormal);
+		glUniform1f(u[SIGMA_POSITION], params.sigmaPosition);
+		glUniform1f(u[SIGMA_LUMINANCE], params.sigmaLuminance);
+		glUniformMatrix4fv(u[INVERSE_VIEW_PROJ], 1, GL_FALSE, glm::value_ptr(prepass->getInverseViewProj()));
+
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getDepthTexture());
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getAttachment(gBufferPrepass::NORMAL_MATERIAL));
+
+		glUniform1i(u[STEP_WIDTH], 1 << iteration);
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source);
+		quad.draw();
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+		if (iteration == params.iterations - 1) timer.end();
+	}
+
+	float getPassMs() const { return timer.getSmoothedMs(); }
+	float getLastPassMs() const { return timer.getMs(); }
+
+private:
+	GLuint shader = 0;
+	enum Uniform { SIGMA_NORMAL, SIGMA_POSITION, SIGMA_LUMINANCE, INVERSE_VIEW_PROJ, STEP_WIDTH };
+	uniformLocations<5> uniforms{{ "uSigmaNormal", "uSigmaPosition", "uSigmaLuminance", "uInverseViewProj",
+		"uStepWidth" }};
+	int width, height;
+	GLuint fbo = 0;
+	fullscreenQuad quad;
+	gpuTimer timer;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cgra/cgra_shader.hpp>
+#include "gpuTimer.hpp"
+#include "uniformLocations.hpp"
+
+// matches the PointLight struct in light_cluster_cull_comp.glsl and lighting_pass_frag.glsl (std430)
+struct point_light {
+	glm::vec4 positionRadius; // world position.xyz + radius of influence
+	glm::vec4 color;          // color * intensity, alpha unused
+};
+
+// Clustered (froxel) light culling for analytic point lights. Every frame a compute pass sorts the lights into
+// a grid of screen tiles x exponential depth slices, the lighting pass then only evaluates the lights in the
+// cluster of each pixel, so the cost is bounded by the lights per cluster and not the total light count.
+class clusteredLightPass {
+public:
+	static constexpr int MAX_LIGHTS = 4096;
+
+	struct cluster_params {
+		bool enabled;
+		int gridX, gridY, gridZ;
+		int maxLightsPerCluster;
+	};
+	cluster_params params;
+	std::vector<point_light> lights;
+
+	clusteredLightPass() {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_COMPUTE_SHADER, CGRA_SRCDIR + std::string("//res//shaders//light_cluster_cull_comp.glsl"));
+		shader = sb.build();
+
+		glGenBuffers(1, &lightBuffer);
+		glGenBuffers(1, &countBuffer);
+		glGenBuffers(1, &indexBuffer);
+		setDefaultParams();
+	}
+
+	~clusteredLightPass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		glDeleteBuffers(1, &lightBuffer);
+		glDeleteBuffers(1, &countBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+	}
+
+	void setDefaultParams() {
+		params.enabled = true;
+		params.gridX = 16;
+		params.gridY = 9;
+		params.gridZ = 24;
+		params.maxLightsPerCluster = 64;
+	}
+
+	bool isActive() const { return params.enabled && !lights.empty(); }
+
+	// uploads the lights and rebuilds the cluster lists for the given camera
+	void run(const glm::mat4& view, const glm::mat4& proj) {
+		if (!isActive()) return;
+		timer.begin();
+
+		int numLights = std::min<int>(lights.size(), MAX_LIGHTS);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, numLights * sizeof(point_light), lights.data(), GL_DYNAMIC_DRAW);
+
+		size_t clusterCount = size_t(params.gridX) * params.gridY * params.gridZ;
+		if (clusterCount != allocatedClusters || params.maxLightsPerCluster != allocatedLightsPerCluster) {
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount * params.maxLightsPerCluster * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+			allocatedClusters = clusterCount;
+			allocatedLightsPerCluster = params.maxLightsPerCluster;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		// planes of a standard perspective matrix
+		clusterNear = proj[3][2] / (proj[2][2] - 1.0f);
+		clusterFar = proj[3][2] / (proj[2][2] + 1.0f);
+
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		glUniformMatrix4fv(u[VIEW], 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(u[INVERSE_PROJECTION], 1, GL_FALSE, glm::value_ptr(glm::inverse(proj)));
+		glUniform3ui(u[GRID], params.gridX, params.gridY, params.gridZ);
+		glUniform1f(u[CLUSTER_NEAR], clusterNear);
+		glUniform1f(u[CLUSTER_FAR], clusterFar);
+		glUniform1ui(u[NUM_LIGHTS], numLights);
+		glUniform1ui(u[MAX_LIGHTS_PER_CLUSTER], params.maxLightsPerCluster);
+
+		bindBuffers();
+		// the render graph issues the storage barrier before the lighting pass reads the lists
+		glDispatchCompute(params.gridX, params.gridY, params.gridZ);
+		timer.end();
+	}
+
+	// binds the cluster lists and sets the cluster uniforms on the given (bound) lighting program
+	void bindForLighting(GLuint program) const {
+		const auto& u = uniforms.of(program);
+		glUniform1i(u[ENABLED], isActive());
+		if (!isActive()) return;
+		glUniform3ui(u[GRID], params.gridX, params.gridY, params.gridZ);
+		glUniform1f(u[CLUSTER_NEAR], clusterNear);
+		glUniform1f(u[CLUSTER_FAR], clusterFar);
+		glUniform1ui(u[MAX_LIGHTS_PER_CLUSTER], params.maxLightsPerCluster);
+		bindBuffers();
+	}
+
+	float getPassMs() const { return isActive() ? timer.getSmoothedMs() : 0.0f; }
+
+private:
+	enum Uniform { VIEW, INVERSE_PROJECTION, GRID, CLUSTER_NEAR, CLUSTER_FAR, NUM_LIGHTS, MAX_LIGHTS_PER_CLUSTER, ENABLED };
+	uniformLocations<8> uniforms{{ "uViewMatrix", "uInverseProjection", "uClusterGrid", "uClusterNear", "uClusterFar",
+		"uNumLights", "uMaxLightsPerCluster", "uClusteredLightsEnabled" }};
+
+	GLuint shader = 0;
+	GLuint lightBuffer = 0;
+	GLuint countBuffer = 0;
+	GLuint indexBuffer = 0;
+	size_t allocatedClusters = 0;
+	int allocatedLightsPerCluster = 0;
+	float clusterNear = 0.1f;
+	float clusterFar = 1000.0f;
+	gpuTimer timer;
+
+	void bindBuffers() const {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, countBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indexBuffer);
+	}
+};
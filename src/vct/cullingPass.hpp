@@ -0,0 +1,176 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include <renderable.hpp>
+#include "hiZPass.hpp"
+
+// Frustum and occlusion culling of the renderables drawn by the prepass. The frustum test uses the current
+// camera, the occlusion test the previous frame's Hi-Z pyramid: a coarse mip of it is read back without waiting
+// for the GPU and a renderable whose closest depth lies behind the farthest depth under its screen rectangle is
+// skipped. Renderables without world bounds are always drawn.
+class cullingPass {
+public:
+	struct culling_params {
+		bool frustumEnabled;
+		bool occlusionEnabled;
+		int readbackSize; // largest side of the pyramid mip read back for the occlusion test
+	};
+	culling_params params;
+
+	cullingPass() {
+		glGenBuffers(1, &pbo);
+		setDefaultParams();
+	}
+
+	~cullingPass() {
+		glDeleteBuffers(1, &pbo);
+		if (fence) glDeleteSync(fence);
+	}
+
+	void setDefaultParams() {
+		params.frustumEnabled = true;
+		params.occlusionEnabled = true;
+		params.readbackSize = 64;
+	}
+
+	// call before any isVisible() of a frame with the camera the frame is drawn with
+	void beginFrame(const glm::mat4& viewProj) {
+		tested = frustumCulled = occlusionCulled = visible = 0;
+		// the normalized planes of the frustum, a plane is (n, d) with dot(n, p) + d >= 0 inside
+		glm::mat4 m = glm::transpose(viewProj);
+		planes = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+		for (auto& plane : planes) plane /= glm::length(glm::vec3(plane));
+		collectReadback();
+	}
+
+	bool isVisible(Renderable* obj) {
+		return isVisible(obj->getWorldBounds());
+	}
+
+	bool isVisible(const WorldBounds& bounds) {
+		if (!bounds.valid || (!params.frustumEnabled && !params.occlusionEnabled)) {
+			visible++;
+			return true;
+		}
+		tested++;
+		if (params.frustumEnabled && outsideFrustum(bounds)) {
+			frustumCulled++;
+			return false;
+		}
+		if (params.occlusionEnabled && occluded(bounds)) {
+			occlusionCulled++;
+			return false;
+		}
+		visible++;
+		return true;
+	}
+
+	// starts the read back of the pyramid the next frames test against, call after it is built
+	void readback(const hiZPass* hiZ, const glm::mat4& viewProj) {
+		if (!params.occlusionEnabled) {
+			depth.clear();
+			return;
+		}
+		if (fence) return; // the last read back is still in flight
+
+		int level = 0;
+		while (level + 1 < hiZ->getLevels() && std::max(hiZ->getWidth() >> level, hiZ->getHeight() >> level) > params.readbackSize) level++;
+		pendingWidth = std::max(hiZ->getWidth() >> level, 1);
+		pendingHeight = std::max(hiZ->getHeight() >> level, 1);
+		pendingViewProj = viewProj;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size_t(pendingWidth) * pendingHeight * 2 * sizeof(float), nullptr, GL_STREAM_READ);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, hiZ->getTexture());
+		glGetTexImage(GL_TEXTURE_2D, level, GL_RG, GL_FLOAT, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	int getTested() const { return tested; }
+	int getFrustumCulled() const { return frustumCulled; }
+	int getOcclusionCulled() const { return occlusionCulled; }
+	int getVisible() const { return visible; }
+
+private:
+	GLuint pbo = 0;
+	GLsync fence = nullptr;
+	int pendingWidth = 0, pendingHeight = 0;
+	glm::mat4 pendingViewProj{1};
+
+	// the pyramid mip the occlusion test uses and the camera it was rendered with
+	std::vector<glm::vec2> depth; // closest, farthest
+	int depthWidth = 0, depthHeight = 0;
+	glm::mat4 depthViewProj{1};
+
+	std::array<glm::vec4, 6> planes;
+	int tested = 0;
+	int frustumCulled = 0;
+	int occlusionCulled = 0;
+	int visible = 0;
+
+	void collectReadback() {
+		if (!fence) return;
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+		glDeleteSync(fence);
+		fence = nullptr;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		const glm::vec2* mapped = (const glm::vec2*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+			size_t(pendingWidth) * pendingHeight * sizeof(glm::vec2), GL_MAP_READ_BIT);
+		if (mapped) {
+			depth.assign(mapped, mapped + size_t(pendingWidth) * pendingHeight);
+			depthWidth = pendingWidth;
+			depthHeight = pendingHeight;
+			depthViewProj = pendingViewProj;
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	bool outsideFrustum(const WorldBounds& bounds) const {
+		for (auto& plane : planes) {
+			// the corner furthest along the plane normal
+			glm::vec3 p(plane.x >= 0 ? bounds.max.x : bounds.min.x, plane.y >= 0 ? bounds.max.y : bounds.min.y, plane.z >= 0 ? bounds.max.z : bounds.min.z);
+			if (glm::dot(glm::vec3(plane), p) + plane.w < 0) return true;
+		}
+		return false;
+	}
+
+	bool occluded(const WorldBounds& bounds) const {
+		if (depth.empty()) return false;
+
+		// screen rectangle and closest depth of the box as the pyramid's camera saw it
+		glm::vec2 rectMin(INFINITY), rectMax(-INFINITY);
+		float closest = 1.0f;
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+			glm::vec4 clip = depthViewProj * glm::vec4(corner, 1);
+			if (clip.w <= 0) return false; // crosses the camera plane
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			rectMin = glm::min(rectMin, glm::vec2(ndc));
+			rectMax = glm::max(rectMax, glm::vec2(ndc));
+			closest = std::min(closest, ndc.z * 0.5f + 0.5f);
+		}
+		if (closest <= 0) return false;
+
+		// a texel of margin, the mip folds odd rows and columns into its last texel
+		glm::ivec2 size(depthWidth, depthHeight);
+		glm::ivec2 lo = glm::clamp(glm::ivec2(glm::floor((rectMin * 0.5f + 0.5f) * glm::vec2(size))) - 1, glm::ivec2(0), size - 1);
+		glm::ivec2 hi = glm::clamp(glm::ivec2(glm::floor((rectMax * 0.5f + 0.5f) * glm::vec2(size))) + 1, glm::ivec2(0), size - 1);
+		for (int y = lo.y; y <= hi.y; y++) {
+			for (int x = lo.x; x <= hi.x; x++) {
+				if (closest <= depth[size_t(y) * depthWidth + x].y) return false;
+			}
+		}
+		return true;
+	}
+};
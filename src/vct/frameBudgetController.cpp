@@ -0,0 +1,129 @@
+#include "frameBudgetController.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+FrameBudgetController::~FrameBudgetController() {
+    if (logFile.is_open()) logFile.close();
+}
+
+bool FrameBudgetController::update(const FrameTimings& timings, QualityState& state) {
+    frameIndex++;
+    framesSinceChange++;
+    lastMeasuredMs = timings.totalMs();
+
+    if (!params.enabled || lastMeasuredMs <= 0) return false;
+
+    // keep the state inside the bounds, the user may have tightened them since the last frame
+    QualityState clamped = state;
+    clamped.renderScale = std::clamp(state.renderScale, params.minRenderScale, params.maxRenderScale);
+    clamped.numDiffuseCones = std::clamp(state.numDiffuseCones, params.minDiffuseCones, params.maxDiffuseCones);
+    clamped.maxSteps = std::clamp(state.maxSteps, params.minMaxSteps, params.maxMaxSteps);
+    clamped.stepMultiplier = std::clamp(state.stepMultiplier, params.minStepMultiplier, params.maxStepMultiplier);
+    if (clamped.renderScale != state.renderScale || clamped.numDiffuseCones != state.numDiffuseCones
+        || clamped.maxSteps != state.maxSteps || clamped.stepMultiplier != state.stepMultiplier) {
+        state = clamped;
+        framesSinceChange = 0;
+        logDecision(timings, state, "clamp to bounds");
+        return true;
+    }
+
+    if (framesSinceChange < params.cooldownFrames) return false;
+
+    std::string action;
+    bool changed = false;
+    if (lastMeasuredMs > params.targetMs * (1.0f + params.tolerance))
+        changed = reduceQuality(state, action);
+    else if (lastMeasuredMs < params.targetMs * (1.0f - params.tolerance))
+        changed = increaseQuality(state, action);
+
+    if (changed) {
+        framesSinceChange = 0;
+        logDecision(timings, state, action);
+    }
+    return changed;
+}
+
+// Cheapest visual loss first: coarser cone steps, fewer cones (the denoiser hides most of it),
+// shorter cones and finally a lower internal resolution.
+bool FrameBudgetController::reduceQuality(QualityState& state, std::string& action) const {
+    if (state.stepMultiplier < params.maxStepMultiplier) {
+        state.stepMultiplier = std::min(state.stepMultiplier + 0.1f, params.maxStepMultiplier);
+        action = "increase step multiplier";
+        return true;
+    }
+    if (state.numDiffuseCones > params.minDiffuseCones) {
+        state.numDiffuseCones = std::max(int(state.numDiffuseCones * 0.75f), params.minDiffuseCones);
+        action = "reduce diffuse cones";
+        return true;
+    }
+    if (state.maxSteps > params.minMaxSteps) {
+        state.maxSteps = std::max(std::floor(state.maxSteps * 0.85f), params.minMaxSteps);
+        action = "reduce max steps";
+        return true;
+    }
+    if (state.renderScale > params.minRenderScale) {
+        state.renderScale = std::max(state.renderScale - RENDER_SCALE_STEP, params.minRenderScale);
+        action = "reduce render scale";
+        return true;
+    }
+    return false;
+}
+
+// Undo the reductions in reverse order
+bool FrameBudgetController::increaseQuality(QualityState& state, std::string& action) const {
+    if (state.renderScale < params.maxRenderScale) {
+        state.renderScale = std::min(state.renderScale + RENDER_SCALE_STEP, params.maxRenderScale);
+        action = "increase render scale";
+        return true;
+    }
+    if (state.maxSteps < params.maxMaxSteps) {
+        state.maxSteps = std::min(std::ceil(state.maxSteps / 0.85f), params.maxMaxSteps);
+        action = "increase max steps";
+        return true;
+    }
+    if (state.numDiffuseCones < params.maxDiffuseCones) {
+        state.numDiffuseCones = std::min(int(std::ceil(state.numDiffuseCones / 0.75f)), params.maxDiffuseCones);
+        action = "increase diffuse cones";
+        return true;
+    }
+    if (state.stepMultiplier > params.minStepMultiplier) {
+        state.stepMultiplier = std::max(state.stepMultiplier - 0.1f, params.minStepMultiplier);
+        action = "decrease step multiplier";
+        return true;
+    }
+    return false;
+}
+
+void FrameBudgetController::logDecision(const FrameTimings& timings, const QualityState& state, const std::string& action) {
+    std::ostringstream line;
+    line << frameIndex << ','
+        << timings.prepassMs << ',' << timings.lightingMs << ',' << timings.denoiseMs << ','
+        << timings.totalMs() << ',' << params.targetMs << ','
+        << action << ','
+        << state.renderScale << ',' << state.numDiffuseCones << ',' << state.maxSteps << ',' << state.stepMultiplier;
+
+    recentDecisions.push_back(line.str());
+    while (recentDecisions.size() > MAX_RECENT_DECISIONS) recentDecisions.pop_front();
+
+    if (!params.logToFile) return;
+
+    // (re)open the log when it is first enabled or the path changes
+    if (!logFile.is_open() || openLogPath != params.logPath) {
+        if (logFile.is_open()) logFile.close();
+        logFile.open(params.logPath, std::ios::out | std::ios::app);
+        openLogPath = params.logPath;
+        if (!logFile) {
+            std::cerr << "Could not open frame budget log " << params.logPath << std::endl;
+            params.logToFile = false;
+            return;
+        }
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        logFile << "# session started " << now << "\n";
+        logFile << "frame,prepass_ms,lighting_ms,denoise_ms,total_ms,target_ms,action,render_scale,diffuse_cones,max_steps,step_multiplier\n";
+    }
+    logFile << line.str() << '\n';
+    logFile.flush();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <string>
+
+// Closed loop quality controller, measures the GPU time of the deferred passes and trades render
+// resolution and cone parameters (within user set bounds) to keep the frame inside a time budget.
+// Only one knob is moved per decision and decisions are spaced out by a cooldown, since the GPU
+// timings lag the frame they were issued in by a few frames.
+class FrameBudgetController {
+public:
+	struct BudgetParams {
+		bool enabled = false;
+		float targetMs = 16.0f;          // GPU time budget for prepass + lighting (+ denoise)
+		float tolerance = 0.1f;          // fraction of the target inside which nothing is changed
+		int cooldownFrames = 8;          // frames to wait after a change before deciding again
+		float minRenderScale = 0.5f;
+		float maxRenderScale = 1.0f;
+		int minDiffuseCones = 4;
+		int maxDiffuseCones = 32;
+		float minMaxSteps = 64;
+		float maxMaxSteps = 256;
+		float minStepMultiplier = 0.6f;  // lower multiplier = smaller steps = higher quality
+		float maxStepMultiplier = 1.5f;
+		bool logToFile = false;
+		std::string logPath = "frame_budget_log.csv";
+	};
+
+	// the knobs the controller is allowed to move
+	struct QualityState {
+		float renderScale;
+		int numDiffuseCones;
+		float maxSteps;
+		float stepMultiplier;
+	};
+
+	struct FrameTimings {
+		float prepassMs;
+		float lightingMs;
+		float denoiseMs;
+		float totalMs() const { return prepassMs + lightingMs + denoiseMs; }
+	};
+
+	BudgetParams params;
+
+	FrameBudgetController() = default;
+	~FrameBudgetController();
+
+	// returns true if the quality state was changed this frame
+	bool update(const FrameTimings& timings, QualityState& state);
+
+	// most recent decisions, newest last, for display
+	const std::deque<std::string>& getRecentDecisions() const { return recentDecisions; }
+	float getLastMeasuredMs() const { return lastMeasuredMs; }
+
+private:
+	static constexpr size_t MAX_RECENT_DECISIONS = 16;
+	static constexpr float RENDER_SCALE_STEP = 0.05f;
+
+	unsigned long frameIndex = 0;
+	int framesSinceChange = 0;
+	float lastMeasuredMs = 0;
+	std::deque<std::string> recentDecisions;
+	std::ofstream logFile;
+	std::string openLogPath;
+
+	bool reduceQuality(QualityState& state, std::string& action) const;
+	bool increaseQuality(QualityState& state, std::string& action) const;
+	void logDecision(const FrameTimings& timings, const QualityState& state, const std::string& action);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// The per frame constants every scene program reads from the std140 FrameConstants block at uniform buffer
+// binding 0: the camera the scene is drawn with, the voxel volume and the render mode. The members keep the
+// names of the uniforms they replace, so shaders only declare the block (see plant_trunk_vert.glsl). The block
+// is uploaded when a pass changes the camera or the mode, a pass drawing from another camera (the shadow cube,
+// the visibility capture, the bake) puts the previous one back when it is done.
+class frameConstants {
+public:
+	static constexpr GLuint BINDING = 0;
+
+	struct block { // std140
+		glm::mat4 view{1};
+		glm::mat4 proj{1};
+		glm::vec3 cameraPos{0};
+		float voxelWorldSize = 0;
+		glm::vec3 voxelCenter{0};
+		GLint voxelRes = 0;
+		GLint voxelSplatRadius = 0;
+		GLint renderMode = 1; // 0 = write voxels, 1 = write to gbuffer, 2 = static GI bake
+		GLint padding[2] = { 0, 0 };
+	};
+
+	static frameConstants& get() {
+		static frameConstants constants;
+		return constants;
+	}
+
+	void setCamera(const glm::mat4& view, const glm::mat4& proj) {
+		data.view = view;
+		data.proj = proj;
+		data.cameraPos = glm::vec3(glm::inverse(view)[3]);
+		upload();
+	}
+
+	// the volume rarely changes, setting the same one again uploads nothing
+	void setVoxels(const glm::vec3& center, float worldSize, int resolution, int splatRadius) {
+		if (data.voxelCenter == center && data.voxelWorldSize == worldSize && data.voxelRes == resolution && data.voxelSplatRadius == splatRadius) return;
+		data.voxelCenter = center;
+		data.voxelWorldSize = worldSize;
+		data.voxelRes = resolution;
+		data.voxelSplatRadius = splatRadius;
+		upload();
+	}
+
+	void setRenderMode(int mode) {
+		if (data.renderMode == mode) return;
+		data.renderMode = mode;
+		upload();
+	}
+
+	// puts back a block saved with getBlock()
+	void setBlock(const block& saved) {
+		data = saved;
+		upload();
+	}
+
+	const block& getBlock() const { return data; }
+
+private:
+	GLuint ubo = 0;
+	block data;
+
+	frameConstants() {
+		glGenBuffers(1, &ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &data, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+	}
+
+	void upload() {
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+
+// Two triangle screen covering quad matching the layout expected by fullscreen_quad_vert.glsl
+// (location 0 = clip space position, location 1 = texture coordinate)
+class fullscreenQuad {
+public:
+	fullscreenQuad() {
+		float quadVertices[] = {
+			// positions   // texCoords
+			-1.0f,  1.0f,  0.0f, 1.0f,
+			-1.0f, -1.0f,  0.0f, 0.0f,
+			 1.0f, -1.0f,  1.0f, 0.0f,
+
+			-1.0f,  1.0f,  0.0f, 1.0f,
+			 1.0f, -1.0f,  1.0f, 0.0f,
+			 1.0f,  1.0f,  1.0f, 1.0f
+		};
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+
+		cgra::gl_state::bind_vertex_array(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		cgra::gl_state::bind_vertex_array(0);
+	}
+
+	~fullscreenQuad() {
+		glDeleteBuffers(1, &vbo);
+		cgra::gl_state::delete_vertex_arrays(1, &vao);
+	}
+
+	fullscreenQuad(const fullscreenQuad&) = delete;
+	fullscreenQuad& operator=(const fullscreenQuad&) = delete;
+
+	void draw() const {
+		cgra::gl_state::bind_vertex_array(vao);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+private:
+	GLuint vao = 0;
+	GLuint vbo = 0;
+};
@@ -1,16 +1,26 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
+#include <array>
 #include <stdexcept>
 #include <functional>
 #include "gBufferPrepass.hpp"
 #include <cgra/cgra_shader.hpp>
 #include <iostream>
 #include "voxelizer.hpp"
+#include "fullscreenQuad.hpp"
+#include "clusteredLightPass.hpp"
+#include "hiZPass.hpp"
+#include "ssgiPass.hpp"
+#include "voxelBouncePass.hpp"
+#include "shadowedLightPass.hpp"
+#include "tracerStats.hpp"
+#include "frameConstants.hpp"
 
 class gBufferLightingPass {
 public:
@@ -21,10 +31,8 @@ public:
 		float uEmissiveThreshold;
 		int   uNumDiffuseCones;
 		float uDiffuseBrightnessMultiplier;
-		float uOccludeThresholdForSecondaryCone;
 		float uTransmittanceNeededForConeTermination;
 		glm::vec3  uAmbientColor;
-		float uSecondaryConeMaxStepMultiplier;
 		float uReflectionBlendLowerBound;
 		float uReflectionBlendUpperBound;
 		glm::vec3 uHorizonColor;
@@ -34,25 +42,77 @@ public:
 		float uConeOffset;
 		float uAO;
 		float uContrast;
+		bool uUseBakedGI;
+		bool uSSREnabled;
+		int uSSRMaxIterations;
+		float uSSRMaxDistance;
+		float uSSRThickness;
 	};
 	light_pass_params params;
 
-	gBufferLightingPass(gBufferPrepass* prepassObj, Voxelizer* voxelizerObj) {
+	gBufferLightingPass(gBufferPrepass* prepassObj, Voxelizer* voxelizerObj, clusteredLightPass* clusterObj, hiZPass* hiZObj, ssgiPass* ssgiObj, voxelBouncePass* bounceObj, shadowedLightPass* shadowedLightObj, TracerStats* statsObj, int targetWidth, int targetHeight)
+		: width(targetWidth), height(targetHeight) {
 		prepass = prepassObj; 
 		voxelizer = voxelizerObj;
+		clusters = clusterObj;
+		hiZ = hiZObj;
+		ssgi = ssgiObj;
+		bounce = bounceObj;
+		shadowedLight = shadowedLightObj;
+		tracerStats = statsObj;
 
 		cgra::shader_builder sb;
 		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
 		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//lighting_pass_frag.glsl"));
 		shader = sb.build();
 
-		setupQuad();
+		cgra::shader_builder compositeBuilder;
+		compositeBuilder.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		compositeBuilder.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//lighting_composite_frag.glsl"));
+		compositeShader = compositeBuilder.build();
 
-		glUseProgram(shader);
+		cgra::shader_builder resolveBuilder;
+		resolveBuilder.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		resolveBuilder.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//lighting_resolve_frag.glsl"));
+		resolveShader = resolveBuilder.build();
+
+		cgra::gl_state::use_program(shader);
 		glUniform1i(glGetUniformLocation(shader, "voxelTex0"), 4);
 		glUniform1i(glGetUniformLocation(shader, "voxelTex1"), 5);
 		glUniform1i(glGetUniformLocation(shader, "voxelTex2"), 6);
+		glUniform1i(glGetUniformLocation(shader, "gBufferBakedIrradiance"), 7);
+		glUniform1i(glGetUniformLocation(shader, "uHiZ"), 8);
+		glUniform1i(glGetUniformLocation(shader, "uPrevSceneColor"), 9);
+		glUniform1i(glGetUniformLocation(shader, "uNearFieldGI"), 10);
+		glUniform1i(glGetUniformLocation(shader, "uBounceTex"), 11);
+		glUniform1i(glGetUniformLocation(shader, "uShadowMap"), 12);
+		glUniform1i(glGetUniformLocation(shader, "uDirectTex"), 13);
+		glUniform1i(glGetUniformLocation(shader, "gBufferDepth"), 0);
+		glUniform1i(glGetUniformLocation(shader, "gBufferNormal"), 1);
+		glUniform1i(glGetUniformLocation(shader, "gBufferAlbedo"), 2);
+		glUniform1i(glGetUniformLocation(shader, "gBufferEmissive"), 3);
+		glUniform1i(glGetUniformLocation(shader, "gBufferPosition"), 14);
+		clusteredLightsLocation = glGetUniformLocation(shader, "uClusteredLightsEnabled");
+
+		glGenBuffers(1, &lightingUbo);
+		glBindBuffer(GL_UNIFORM_BUFFER, lightingUbo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(lighting_block), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		cgra::gl_state::use_program(compositeShader);
+		glUniform1i(glGetUniformLocation(compositeShader, "uRadiance"), 0);
+		glUniform1i(glGetUniformLocation(compositeShader, "uIrradiance"), 1);
+		glUniform1i(glGetUniformLocation(compositeShader, "uDiffuseColour"), 2);
+		glUniform1i(glGetUniformLocation(compositeShader, "gBufferAlbedo"), 3);
+		compositeUniforms = { glGetUniformLocation(compositeShader, "uSplitDiffuse"), glGetUniformLocation(compositeShader, "uAmbientColor"),
+			glGetUniformLocation(compositeShader, "uAO") };
+
+		cgra::gl_state::use_program(resolveShader);
+		glUniform1i(glGetUniformLocation(resolveShader, "uSceneColor"), 0);
+		resolveUniforms = { glGetUniformLocation(resolveShader, "uToneMapEnable"), glGetUniformLocation(resolveShader, "uContrast"),
+			glGetUniformLocation(resolveShader, "uSharpness") };
 
+		setupTargets();
 		setDefaultParams();
 	}
 
@@ -64,10 +124,8 @@ public:
 		params.uEmissiveThreshold = 0.0;
 		params.uNumDiffuseCones = 32;
 		params.uDiffuseBrightnessMultiplier = 20000.0;
-		params.uOccludeThresholdForSecondaryCone = 0.8; // TODO unused
 		params.uTransmittanceNeededForConeTermination = 0.01;
 		params.uAmbientColor = glm::vec3(0.1);
-		params.uSecondaryConeMaxStepMultiplier = 0.25; // TODO unused
 		params.uReflectionBlendLowerBound = 0.75;
 		params.uReflectionBlendUpperBound = 1;
 		params.uHorizonColor = glm::vec3(0.5, 0.8, 0.9);
@@ -77,126 +135,312 @@ public:
 		params.uConeOffset = 3;
 		params.uAO = 0.5;
 		params.uContrast = 0.9;
+		params.uUseBakedGI = true;
+		params.uSSREnabled = true;
+		params.uSSRMaxIterations = 64;
+		params.uSSRMaxDistance = 30;
+		params.uSSRThickness = 0.5;
 	}
 
 	~gBufferLightingPass() {
-		glUseProgram(0);
+		cgra::gl_state::use_program(0);
 		if (shader != 0 && glIsProgram(shader)) {
-			glDeleteProgram(shader);
+			cgra::shader_builder::release(shader);
 			shader = 0;
 		}
-		if (quadVBO != 0) {
-			glDeleteBuffers(1, &quadVBO);
-			quadVBO = 0;
+		if (compositeShader != 0 && glIsProgram(compositeShader)) {
+			cgra::shader_builder::release(compositeShader);
+			compositeShader = 0;
 		}
-		if (quadVAO != 0) {
-			glDeleteVertexArrays(1, &quadVAO);
-			quadVAO = 0;
+		if (resolveShader != 0 && glIsProgram(resolveShader)) {
+			cgra::shader_builder::release(resolveShader);
+			resolveShader = 0;
 		}
+		glDeleteBuffers(1, &lightingUbo);
+		deleteTargets();
 	}
 
-	void runPass(glm::mat4& view, int debugMode = 0) {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);  // Render to screen
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		deleteTargets();
+		setupTargets();
+	}
+
+	// Traces the cones for every G-buffer pixel into the lighting targets (HDR, not yet tone mapped).
+	// When splitDiffuse is set the indirect diffuse term is written separately to the irradiance target
+	// (so it can be filtered) instead of being added to the radiance target.
+	void runPass(glm::mat4& view, glm::mat4& proj, int debugMode = 0, bool splitDiffuse = false) {
+		// last frame's scene colour becomes the reflection source
+		currentScene = 1 - currentScene;
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		cgra::gl_state::viewport(0, 0, width, height);
 		glClear(GL_COLOR_BUFFER_BIT);
+		trace(prepass, proj, debugMode, splitDiffuse, false, params.uNumDiffuseCones);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
 
-		glUseProgram(shader);
-
-		glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniform1f(glGetUniformLocation(shader, "uConeAperture"), params.uConeAperture);
-		glUniform1f(glGetUniformLocation(shader, "VOXEL_SIZE"), voxelizer->m_params.worldSize/float(voxelizer->m_params.resolution));
-		glUniform1f(glGetUniformLocation(shader, "uStepMultiplier"), params.uStepMultiplier);
-		glUniform1f(glGetUniformLocation(shader, "uMaxSteps"), params.uMaxSteps);
-		glUniform1f(glGetUniformLocation(shader, "uEmissiveThreshold"), params.uEmissiveThreshold);
-		glUniform1f(glGetUniformLocation(shader, "uDiffuseBrightnessMultiplier"), params.uDiffuseBrightnessMultiplier);
-		glUniform1f(glGetUniformLocation(shader, "uOccludeThresholdForSecondaryCone"), params.uOccludeThresholdForSecondaryCone);
-		glUniform1f(glGetUniformLocation(shader, "uTransmittanceNeededForConeTermination"), params.uTransmittanceNeededForConeTermination);
-		glUniform1f(glGetUniformLocation(shader, "uSecondaryConeMaxStepMultiplier"), params.uSecondaryConeMaxStepMultiplier);
-		glUniform1i(glGetUniformLocation(shader, "uNumDiffuseCones"), params.uNumDiffuseCones);
-		glUniform3fv(glGetUniformLocation(shader, "uAmbientColor"), 1, glm::value_ptr(params.uAmbientColor));
-		glUniform3fv(glGetUniformLocation(shader, "uVoxelCenter"), 1, value_ptr(voxelizer->m_params.center));
-		glUniform1f(glGetUniformLocation(shader, "uReflectionBlendLowerBound"), params.uReflectionBlendLowerBound);
-		glUniform1f(glGetUniformLocation(shader, "uReflectionBlendUpperBound"), params.uReflectionBlendUpperBound);
-		glUniform3fv(glGetUniformLocation(shader, "uHorizonColor"), 1, value_ptr(params.uHorizonColor));
-		glUniform3fv(glGetUniformLocation(shader, "uZenithColor"), 1, value_ptr(params.uZenithColor));
-		glUniform1i(glGetUniformLocation(shader, "uToneMapEnable"), params.uToneMapEnable);
-		glUniform1f(glGetUniformLocation(shader, "uReflectionAperture"), params.uReflectionAperture);
-		glUniform1f(glGetUniformLocation(shader, "uConeOffset"), params.uConeOffset);
-		glUniform1f(glGetUniformLocation(shader, "uAO"), params.uAO);
-		glUniform1f(glGetUniformLocation(shader, "uContrast"), params.uContrast);
-
-
-		auto invView = glm::inverse(view);
-		auto camPos = glm::vec3(invView[3]);
-		glUniform3fv(glGetUniformLocation(shader, "cameraPos"), 1, glm::value_ptr(camPos));
-		float mip = (float)voxelizer->m_params.mipLevels;
-		glUniform1f(glGetUniformLocation(shader, "uMipLevelCount"), mip);
-
-		// Bind debug mode
-		glUniform1i(glGetUniformLocation(shader, "uDebugIndex"), debugMode);
-
-		// Bind all G-buffer attachments
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, prepass->getAttachment(0)); // Position
-		glUniform1i(glGetUniformLocation(shader, "gBufferPosition"), 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, prepass->getAttachment(1)); // Normal
-		glUniform1i(glGetUniformLocation(shader, "gBufferNormal"), 1);
+		prevViewProj = proj * view;
+	}
 
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, prepass->getAttachment(2)); // Albedo
-		glUniform1i(glGetUniformLocation(shader, "gBufferAlbedo"), 2);
+	// Static GI bake, traces the diffuse cones for every texel of a G-buffer rendered in lightmap space and
+	// writes indirect diffuse + ambient occlusion to the second draw buffer of the target framebuffer.
+	void runBake(const gBufferPrepass* bakeBuffer, GLuint targetFbo, int targetWidth, int targetHeight, int numDiffuseCones) {
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, targetFbo);
+		cgra::gl_state::viewport(0, 0, targetWidth, targetHeight);
+		glClear(GL_COLOR_BUFFER_BIT);
+		trace(bakeBuffer, glm::mat4(1), 0, true, true, numDiffuseCones);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
 
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, prepass->getAttachment(3)); // Emissive
-		glUniform1i(glGetUniformLocation(shader, "gBufferEmissive"), 3);
+	// Adds the (filtered) indirect diffuse term back onto the radiance when it was split out and writes the
+	// HDR scene colour at render resolution, it is kept for a frame as the source for screen space reflections.
+	void runComposite(GLuint irradianceTex, bool splitDiffuse) {
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, sceneFbos[currentScene]);
+		cgra::gl_state::viewport(0, 0, width, height);
+		cgra::gl_state::use_program(compositeShader);
 
-		// voxels
-		glUniform1i(glGetUniformLocation(shader, "uVoxelRes"), voxelizer->m_params.resolution);
-		glUniform1f(glGetUniformLocation(shader, "uVoxelWorldSize"), voxelizer->m_params.worldSize);
+		glUniform1i(compositeUniforms[0], splitDiffuse);
+		glUniform3fv(compositeUniforms[1], 1, glm::value_ptr(params.uAmbientColor));
+		glUniform1f(compositeUniforms[2], params.uAO);
 
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_3D, voxelizer->m_voxelTex0);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_3D, voxelizer->m_voxelTex1);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_3D, voxelizer->m_voxelTex2); // no uniform setting needed, already done in constructor
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, targets[0]);
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, irradianceTex);
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, targets[2]);
+		cgra::gl_state::active_texture(GL_TEXTURE3);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getAttachment(gBufferPrepass::ALBEDO)); // Albedo
 
-		// Draw fullscreen quad
-		glBindVertexArray(quadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		quad.draw();
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Tone maps the given HDR colour (the scene colour, or the temporal upscaler's output) into the currently
+	// bound framebuffer, upscaling it to the output size. sharpness > 0 applies a sharpen after the tone map.
+	void runResolve(GLuint hdrColor, int outputWidth, int outputHeight, float sharpness = 0.0f) {
+		cgra::gl_state::viewport(0, 0, outputWidth, outputHeight);
+		cgra::gl_state::use_program(resolveShader);
+		glUniform1i(resolveUniforms[0], params.uToneMapEnable);
+		glUniform1f(resolveUniforms[1], params.uContrast);
+		glUniform1f(resolveUniforms[2], sharpness);
+
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, hdrColor);
+
+		quad.draw();
+	}
+
+	GLuint getSceneColor() const { return sceneColors[currentScene]; }
+	// view projection of the last frame that was lit, the scene colour above was rendered with it
+	const glm::mat4& getPrevViewProj() const { return prevViewProj; }
+
+	// 0: radiance.rgb + resolve flag, 1: indirect diffuse.rgb + ambient occlusion, 2: diffuse colour (kD * albedo)
+	GLuint getTarget(unsigned int index) const {
+		if (index >= targets.size()) throw std::out_of_range("Lighting target index");
+		return targets[index];
 	}
 private:
+	static constexpr GLuint LIGHTING_BINDING = 1; // uniform buffer binding, 0 is the frame constants
+
+	struct lighting_block { // std140 LightingParams in lighting_pass_frag.glsl, bools are ints
+		glm::mat4 inverseViewProj;
+		glm::mat4 projMatrix;
+		glm::mat4 prevViewProj;
+		glm::vec3 ambientColor;
+		float coneAperture;
+		glm::vec3 horizonColor;
+		float stepMultiplier;
+		glm::vec3 zenithColor;
+		float maxSteps;
+		float voxelSize;
+		float mipLevelCount;
+		float emissiveThreshold;
+		GLint numDiffuseCones;
+		float diffuseBrightnessMultiplier;
+		float transmittanceNeededForConeTermination;
+		GLint debugIndex;
+		float reflectionBlendLowerBound;
+		float reflectionBlendUpperBound;
+		float reflectionAperture;
+		float coneOffset;
+		float ao;
+		GLint hiZLevels;
+		GLint ssrEnabled;
+		GLint ssrMaxIterations;
+		float ssrMaxDistance;
+		float ssrThickness;
+		GLint ssgiEnabled;
+		float ssgiDistance;
+		GLint bounceEnabled;
+		float bounceMipOffset;
+		GLint splitDiffuse;
+		GLint useBakedGI;
+		GLint bakeMode;
+	};
+
 	Voxelizer* voxelizer;
 	gBufferPrepass* prepass;
+	clusteredLightPass* clusters;
+	hiZPass* hiZ;
+	ssgiPass* ssgi;
+	voxelBouncePass* bounce;
+	shadowedLightPass* shadowedLight;
+	TracerStats* tracerStats;
 	GLuint shader; 
-	GLuint quadVAO;
-	GLuint quadVBO;
-	void setupQuad() {
-		float quadVertices[] = {
-			// positions   // texCoords
-			-1.0f,  1.0f,  0.0f, 1.0f,
-			-1.0f, -1.0f,  0.0f, 0.0f,
-			 1.0f, -1.0f,  1.0f, 0.0f,
-
-			-1.0f,  1.0f,  0.0f, 1.0f,
-			 1.0f, -1.0f,  1.0f, 0.0f,
-			 1.0f,  1.0f,  1.0f, 1.0f
-		};
-
-		glGenVertexArrays(1, &quadVAO);
-		glGenBuffers(1, &quadVBO);
-
-		glBindVertexArray(quadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-
-		// Position attribute
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-
-		// Texture coordinate attribute  
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-		glEnableVertexAttribArray(1);
+	GLuint compositeShader;
+	GLuint resolveShader;
+	GLuint lightingUbo = 0;
+	GLint clusteredLightsLocation = -1;
+	std::array<GLint, 3> compositeUniforms{}; // uSplitDiffuse, uAmbientColor, uAO
+	std::array<GLint, 3> resolveUniforms{};   // uToneMapEnable, uContrast, uSharpness
+	GLuint fbo = 0;
+	std::array<GLuint, 3> targets{};
+	std::array<GLuint, 2> sceneFbos{};   // HDR scene colour of this and the previous frame
+	std::array<GLuint, 2> sceneColors{};
+	int currentScene = 0;
+	glm::mat4 prevViewProj = glm::mat4(1);
+	int width, height;
+	fullscreenQuad quad;
+
+	// fills the LightingParams block, sets the remaining uniforms and inputs for the cone tracing shader and draws
+	// it into the bound framebuffer. The camera and the voxel volume come from the frame constants.
+	void trace(const gBufferPrepass* source, const glm::mat4& proj, int debugMode, bool splitDiffuse, bool bakeMode, int numDiffuseCones) {
+		lighting_block block;
+		block.inverseViewProj = source->getInverseViewProj();
+		block.projMatrix = proj;
+		block.prevViewProj = prevViewProj;
+		block.ambientColor = params.uAmbientColor;
+		block.coneAperture = params.uConeAperture;
+		block.horizonColor = params.uHorizonColor;
+		block.stepMultiplier = params.uStepMultiplier;
+		block.zenithColor = params.uZenithColor;
+		block.maxSteps = params.uMaxSteps;
+		block.voxelSize = voxelizer->m_params.worldSize / float(voxelizer->m_params.resolution);
+		block.mipLevelCount = float(voxelizer->m_params.mipLevels);
+		block.emissiveThreshold = params.uEmissiveThreshold;
+		block.numDiffuseCones = numDiffuseCones;
+		block.diffuseBrightnessMultiplier = params.uDiffuseBrightnessMultiplier;
+		block.transmittanceNeededForConeTermination = params.uTransmittanceNeededForConeTermination;
+		block.debugIndex = debugMode;
+		block.reflectionBlendLowerBound = params.uReflectionBlendLowerBound;
+		block.reflectionBlendUpperBound = params.uReflectionBlendUpperBound;
+		block.reflectionAperture = params.uReflectionAperture;
+		block.coneOffset = params.uConeOffset;
+		block.ao = params.uAO;
+		// screen space reflections and near field, not possible in lightmap space
+		block.hiZLevels = hiZ->getLevels();
+		block.ssrEnabled = params.uSSREnabled && !bakeMode;
+		block.ssrMaxIterations = params.uSSRMaxIterations;
+		block.ssrMaxDistance = params.uSSRMaxDistance;
+		block.ssrThickness = params.uSSRThickness;
+		block.ssgiEnabled = ssgi->params.enabled && !bakeMode;
+		block.ssgiDistance = ssgi->params.handoffDistance;
+		block.bounceEnabled = bounce->params.enabled;
+		block.bounceMipOffset = bounce->getMipOffset();
+		block.splitDiffuse = splitDiffuse || bakeMode;
+		block.useBakedGI = params.uUseBakedGI && !bakeMode;
+		block.bakeMode = bakeMode;
+		glBindBuffer(GL_UNIFORM_BUFFER, lightingUbo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BINDING, lightingUbo);
+
+		cgra::gl_state::use_program(shader);
+		if (bakeMode) // the bake only stores the indirect term, direct light stays analytic
+			glUniform1i(clusteredLightsLocation, false);
+		else
+			clusters->bindForLighting(shader);
+		tracerStats->bindForLighting(shader, bakeMode);
+
+		// G-buffer attachments, positions come from the depth unless the buffer is in lightmap space
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->getDepthTexture()); // Depth
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->getAttachment(gBufferPrepass::NORMAL_MATERIAL)); // Normal + material
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->getAttachment(gBufferPrepass::ALBEDO)); // Albedo
+		cgra::gl_state::active_texture(GL_TEXTURE3);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->getAttachment(gBufferPrepass::EMISSIVE)); // Emissive
+		cgra::gl_state::active_texture(GL_TEXTURE7);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->getAttachment(gBufferPrepass::BAKED_IRRADIANCE)); // Baked irradiance
+		cgra::gl_state::active_texture(GL_TEXTURE14);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, source->hasPositionAttachment() ? source->getAttachment(gBufferPrepass::POSITION) : 0);
+
+		cgra::gl_state::active_texture(GL_TEXTURE8);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, hiZ->getTexture());
+		cgra::gl_state::active_texture(GL_TEXTURE9);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, sceneColors[1 - currentScene]);
+		cgra::gl_state::active_texture(GL_TEXTURE10);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, ssgi->getTexture());
+
+		// voxels
+		cgra::gl_state::active_texture(GL_TEXTURE4);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex0);
+		cgra::gl_state::active_texture(GL_TEXTURE5);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex1);
+		cgra::gl_state::active_texture(GL_TEXTURE6);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex2); // no uniform setting needed, already done in constructor
+
+		// re-injected bounce light
+		cgra::gl_state::active_texture(GL_TEXTURE11);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, bounce->getTexture());
+
+		// shadowed primary light, the bake still gathers its injected light but not the analytic direct term
+		shadowedLight->bindForLighting(shader, GL_TEXTURE12, GL_TEXTURE13);
+
+		// Draw fullscreen quad
+		quad.draw();
+	}
+
+	void setupTargets() {
+		glGenFramebuffers(1, &fbo);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		glGenTextures(targets.size(), targets.data());
+
+		const GLenum formats[3] = { GL_RGBA16F, GL_RGBA16F, GL_RGBA8 };
+		for (size_t i = 0; i < targets.size(); i++) {
+			cgra::gl_state::bind_texture(GL_TEXTURE_2D, targets[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+			// linear so the resolve can upscale when rendering below window resolution
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0);
+		}
+
+		GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glDrawBuffers(3, drawBuffers);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Lighting framebuffer is not complete!");
+		}
+
+		glGenFramebuffers(sceneFbos.size(), sceneFbos.data());
+		glGenTextures(sceneColors.size(), sceneColors.data());
+		for (size_t i = 0; i < sceneColors.size(); i++) {
+			cgra::gl_state::bind_texture(GL_TEXTURE_2D, sceneColors[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, sceneFbos[i]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColors[i], 0);
+			glClear(GL_COLOR_BUFFER_BIT);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				throw std::runtime_error("Scene colour framebuffer is not complete!");
+			}
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void deleteTargets() {
+		cgra::gl_state::delete_framebuffers(1, &fbo);
+		cgra::gl_state::delete_textures(targets.size(), targets.data());
+		cgra::gl_state::delete_framebuffers(sceneFbos.size(), sceneFbos.data());
+		cgra::gl_state::delete_textures(sceneColors.size(), sceneColors.data());
 	}
 };
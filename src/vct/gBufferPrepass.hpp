@@ -1,39 +1,53 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
 #include <stdexcept>
 #include <functional>
+#include "frameConstants.hpp"
 
+// Compact G-buffer, 26 bytes per pixel with depth (34 with the old position attachment). World positions are reconstructed from the depth buffer
+// and the view projection of the prepass, normals are octahedral encoded. G-buffers rasterised in lightmap
+// space have no camera to reconstruct from, they keep an explicit position attachment instead.
 class gBufferPrepass {
 public:
-    gBufferPrepass(int targetWidth, int targetHeight)
-        : width(targetWidth), height(targetHeight) {
+    enum Attachment {
+        NORMAL_MATERIAL = 0,  // octahedral normal.xy + metallic + smoothness
+        ALBEDO = 1,           // albedo.rgb + emissiveFactor
+        EMISSIVE = 2,         // emissive.rgb + spare channel
+        BAKED_IRRADIANCE = 3, // baked irradiance.rgb + ambient occlusion, only valid where the spare channel is set
+        POSITION = 4          // world position.xyz, only with storePosition
+    };
+
+    gBufferPrepass(int targetWidth, int targetHeight, bool storePosition = false)
+        : width(targetWidth), height(targetHeight), explicitPosition(storePosition) {
         setupGBuffer();
     }
 
     ~gBufferPrepass() {
-        glDeleteFramebuffers(1, &fbo);
-        glDeleteTextures(gAttachments.size(), gAttachments.data());
-        glDeleteRenderbuffers(1, &depthRBO);
+        cgra::gl_state::delete_framebuffers(1, &fbo);
+        cgra::gl_state::delete_textures(gAttachments.size(), gAttachments.data());
+        cgra::gl_state::delete_textures(1, &depthTex);
     }
 
-    void executePrepass(std::vector<GLuint> shaders, std::function<void()> drawScene) {
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glViewport(0, 0, width, height);
+    // viewProj is the projection * view the scene is drawn with, the positions are reconstructed with it.
+    // renderMode 2 is used by the static GI bake to rasterise lightmapped renderables in uv space. The camera must
+    // already be in the frame constants (see frameConstants.hpp), the render mode is set here
+    void executePrepass(std::function<void()> drawScene, const glm::mat4& viewProj, int renderMode = 1) {
+        this->viewProj = viewProj;
+        cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+        cgra::gl_state::viewport(0, 0, width, height);
 
         // Clear g buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        for (auto shader : shaders) {
-            glUseProgram(shader);
-            glUniform1i(glGetUniformLocation(shader, "uRenderMode"), 1); // set to draw to gbuffer
-        }
+        frameConstants::get().setRenderMode(renderMode); // set to draw to gbuffer
         drawScene(); // user-supplied function that draws geometry
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
     }
 
     GLuint getAttachment(unsigned int index) const {
@@ -42,83 +56,104 @@ public:
     }
 
     GLuint getFBO() const { return fbo; }
+    GLuint getDepthTexture() const { return depthTex; }
+    bool hasPositionAttachment() const { return explicitPosition; }
+    const glm::mat4& getViewProj() const { return viewProj; }
+    glm::mat4 getInverseViewProj() const { return glm::inverse(viewProj); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
 
     void resize(int w, int h) {
         width = w;
         height = h;
 
         // reset
-        glDeleteFramebuffers(1, &fbo);
-        glDeleteTextures(gAttachments.size(), gAttachments.data());
-        glDeleteRenderbuffers(1, &depthRBO);
+        cgra::gl_state::delete_framebuffers(1, &fbo);
+        cgra::gl_state::delete_textures(gAttachments.size(), gAttachments.data());
+        cgra::gl_state::delete_textures(1, &depthTex);
 
         setupGBuffer();
     }
 
 private:
     GLuint fbo = 0;
-    GLuint depthRBO = 0;
+    GLuint depthTex = 0;
     std::vector<GLuint> gAttachments;
     int width, height;
+    bool explicitPosition;
+    glm::mat4 viewProj = glm::mat4(1);
 
     void setupGBuffer() {
         glGenFramebuffers(1, &fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
 
-        gAttachments.resize(4);
+        gAttachments.resize(explicitPosition ? 5 : 4);
 
         glGenTextures(gAttachments.size(), gAttachments.data());
 
-        // G-Buffer 0: world position.xyz + metallic
-        glBindTexture(GL_TEXTURE_2D, gAttachments[0]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0,
-                     GL_RGBA, GL_FLOAT, nullptr);
+        // G-Buffer 0: octahedral normal.xy + metallic + smoothness, 16 bit unorm so the normal keeps its precision
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, gAttachments[NORMAL_MATERIAL]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, width, height, 0,
+                     GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
         setTextureParams();
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D, gAttachments[0], 0);
+                               GL_TEXTURE_2D, gAttachments[NORMAL_MATERIAL], 0);
 
-        // G-Buffer 1: world normal.xyz + smoothness
-        glBindTexture(GL_TEXTURE_2D, gAttachments[1]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0,
-                     GL_RGBA, GL_FLOAT, nullptr);
+        // G-Buffer 1: albedo.rgb + emissiveFactor
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, gAttachments[ALBEDO]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         setTextureParams();
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
-                               GL_TEXTURE_2D, gAttachments[1], 0);
+                               GL_TEXTURE_2D, gAttachments[ALBEDO], 0);
 
-        // G-Buffer 2: albedo.rgb + emissiveFactor
-        glBindTexture(GL_TEXTURE_2D, gAttachments[2]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+        // G-Buffer 2: emissive.rgb + spare channel
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, gAttachments[EMISSIVE]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA4, width, height, 0,
                      GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         setTextureParams();
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
-                               GL_TEXTURE_2D, gAttachments[2], 0);
+                               GL_TEXTURE_2D, gAttachments[EMISSIVE], 0);
 
-        // G-Buffer 3: emissive.rgb + spare channel
-        glBindTexture(GL_TEXTURE_2D, gAttachments[3]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA4, width, height, 0,
-                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        // G-Buffer 3: baked irradiance.rgb + ambient occlusion, only valid where the spare channel is set
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, gAttachments[BAKED_IRRADIANCE]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0,
+                     GL_RGBA, GL_FLOAT, nullptr);
         setTextureParams();
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3,
-                               GL_TEXTURE_2D, gAttachments[3], 0);
+                               GL_TEXTURE_2D, gAttachments[BAKED_IRRADIANCE], 0);
+
+        // G-Buffer 4: world position.xyz, full float as it is only used for (small) lightmap space buffers
+        if (explicitPosition) {
+            cgra::gl_state::bind_texture(GL_TEXTURE_2D, gAttachments[POSITION]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0,
+                         GL_RGBA, GL_FLOAT, nullptr);
+            setTextureParams();
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4,
+                                   GL_TEXTURE_2D, gAttachments[POSITION], 0);
+        }
 
         // Specify multiple draw buffers for MRT
-        GLenum drawBuffers[4] = {
+        GLenum drawBuffers[5] = {
             GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
-            GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
-        glDrawBuffers(4, drawBuffers);
-
-        // Depth buffer
-        glGenRenderbuffers(1, &depthRBO);
-        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                                  GL_RENDERBUFFER, depthRBO);
+            GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+            GL_COLOR_ATTACHMENT4};
+        glDrawBuffers(gAttachments.size(), drawBuffers);
+
+        // Depth buffer, a texture as the positions are reconstructed from it
+        glGenTextures(1, &depthTex);
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, depthTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        setTextureParams();
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D, depthTex, 0);
 
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
             throw std::runtime_error("G-Buffer framebuffer is not complete!");
         }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
     }
 
     void setTextureParams() {
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+
+// Measures GPU time between begin() and end() using timestamp queries.
+// Queries are kept in a small ring so reading a result never stalls the pipeline,
+// the reported time is therefore a couple of frames old. Timestamps (rather than
+// GL_TIME_ELAPSED) are used so timers can be nested around each other.
+class gpuTimer {
+public:
+	gpuTimer() {
+		glGenQueries(queries.size(), queries.data());
+	}
+
+	~gpuTimer() {
+		glDeleteQueries(queries.size(), queries.data());
+	}
+
+	gpuTimer(const gpuTimer&) = delete;
+	gpuTimer& operator=(const gpuTimer&) = delete;
+
+	void begin() {
+		collect();
+		glQueryCounter(queries[current * 2], GL_TIMESTAMP);
+	}
+
+	void end() {
+		glQueryCounter(queries[current * 2 + 1], GL_TIMESTAMP);
+		pending[current] = true;
+		current = (current + 1) % RING_SIZE;
+	}
+
+	// most recent resolved time in milliseconds
+	float getMs() const { return lastMs; }
+
+	// exponentially smoothed time in milliseconds, nicer for display and control loops
+	float getSmoothedMs() const { return smoothedMs; }
+
+private:
+	static constexpr int RING_SIZE = 4;
+	std::array<GLuint, RING_SIZE * 2> queries{};
+	std::array<bool, RING_SIZE> pending{};
+	int current = 0;
+	float lastMs = 0;
+	float smoothedMs = 0;
+
+	// read back every finished query pair without blocking
+	void collect() {
+		for (int i = 0; i < RING_SIZE; i++) {
+			if (!pending[i]) continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) continue;
+
+			GLuint64 start = 0, stop = 0;
+			glGetQueryObjectui64v(queries[i * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[i * 2 + 1], GL_QUERY_RESULT, &stop);
+			pending[i] = false;
+
+			lastMs = float(stop - start) / 1e6f;
+			smoothedMs = smoothedMs == 0 ? lastMs : smoothedMs * 0.9f + lastMs * 0.1f;
+		}
+	}
+};
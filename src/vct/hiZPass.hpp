@@ -0,0 +1,106 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <cgra/cgra_shader.hpp>
+#include "fullscreenQuad.hpp"
+#include "uniformLocations.hpp"
+
+// Hierarchical depth pyramid built from the G-buffer depth. Every mip stores the closest (r) and the farthest (g)
+// window space depth of the texels it covers, so screen space ray marches can skip whole empty regions.
+class hiZPass {
+public:
+	hiZPass(int targetWidth, int targetHeight)
+		: width(targetWidth), height(targetHeight) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//hiz_downsample_frag.glsl"));
+		shader = sb.build();
+
+		cgra::gl_state::use_program(shader);
+		glUniform1i(glGetUniformLocation(shader, "uDepth"), 0);
+		glUniform1i(glGetUniformLocation(shader, "uPrevLevel"), 1);
+
+		glGenFramebuffers(1, &fbo);
+		setupTexture();
+	}
+
+	~hiZPass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		cgra::gl_state::delete_framebuffers(1, &fbo);
+		cgra::gl_state::delete_textures(1, &texture);
+	}
+
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		cgra::gl_state::delete_textures(1, &texture);
+		setupTexture();
+	}
+
+	void build(GLuint depthTexture) {
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, depthTexture);
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, texture);
+
+		for (int level = 0; level < levels; level++) {
+			// read only the previous level so the level being written is not also being sampled
+			int source = std::max(level - 1, 0);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, source);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, source);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+			cgra::gl_state::viewport(0, 0, std::max(width >> level, 1), std::max(height >> level, 1));
+			glUniform1i(u[LEVEL], level);
+			quad.draw();
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	GLuint getTexture() const { return texture; }
+	int getLevels() const { return levels; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+private:
+	GLuint shader = 0;
+	enum Uniform { LEVEL };
+	uniformLocations<1> uniforms{{ "uLevel" }};
+	GLuint fbo = 0;
+	GLuint texture = 0;
+	int width, height;
+	int levels = 1;
+	fullscreenQuad quad;
+
+	void setupTexture() {
+		levels = 1 + int(std::floor(std::log2(float(std::max(width, height)))));
+		glGenTextures(1, &texture);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RG32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Hi-Z framebuffer is not complete!");
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+};
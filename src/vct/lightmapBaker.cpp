@@ -0,0 +1,187 @@
+#include "lightmapBaker.hpp"
+#include <cgra/cgra_state.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// file layout: header, then per lightmap its renderable index, resolution and RGBA32F texels (native endianness)
+static const char LIGHTMAP_MAGIC[8] = { 'V', 'C', 'T', 'L', 'M', 'A', 'P', '\0' };
+static const uint32_t LIGHTMAP_VERSION = 1;
+static const uint32_t MAX_LIGHTMAP_RESOLUTION = 8192;
+
+LightmapBaker::~LightmapBaker() {
+    for (auto& lightmap : lightmaps)
+        cgra::gl_state::delete_textures(1, &lightmap.texture);
+}
+
+void LightmapBaker::bake(const std::vector<Renderable*>& renderables, gBufferLightingPass* lightingPass) {
+    auto start = std::chrono::high_resolution_clock::now();
+    clear(renderables);
+
+    int resolution = params.resolution;
+    gBufferPrepass bakeBuffer(resolution, resolution, true); // no camera to reconstruct positions from
+
+    // the lighting shader writes the irradiance to its second output
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+
+    frameConstants& frame = frameConstants::get();
+    frameConstants::block saved = frame.getBlock();
+    auto targets = getLightmappedRenderables(renderables);
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        Renderable* obj = targets[i];
+        frame.setCamera(glm::mat4(1), glm::mat4(1));
+        bakeBuffer.executePrepass([&]() {
+            obj->setObjectUniforms();
+            obj->draw();
+        }, glm::mat4(1), 2);
+
+        GLuint texture = createTexture(resolution, nullptr);
+        cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        GLenum drawBuffers[2] = { GL_NONE, GL_COLOR_ATTACHMENT0 };
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            throw std::runtime_error("Lightmap framebuffer is not complete!");
+        }
+
+        lightingPass->runBake(&bakeBuffer, fbo, resolution, resolution, params.numDiffuseCones);
+
+        lightmaps.push_back({ i, obj, resolution, texture });
+        obj->setBakedLightmap(texture);
+    }
+
+    cgra::gl_state::delete_framebuffers(1, &fbo);
+    frame.setBlock(saved);
+    glFinish(); // so the time includes the tracing
+    lastBakeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightmapBaker::clear(const std::vector<Renderable*>& renderables) {
+    for (auto obj : getLightmappedRenderables(renderables))
+        obj->setBakedLightmap(0);
+    for (auto& lightmap : lightmaps)
+        cgra::gl_state::delete_textures(1, &lightmap.texture);
+    lightmaps.clear();
+}
+
+void LightmapBaker::invalidate(Renderable* renderable) {
+    for (auto it = lightmaps.begin(); it != lightmaps.end(); ++it) {
+        if (it->renderable != renderable) continue;
+        renderable->setBakedLightmap(0);
+        cgra::gl_state::delete_textures(1, &it->texture);
+        lightmaps.erase(it);
+        return;
+    }
+}
+
+bool LightmapBaker::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    uint32_t count = uint32_t(lightmaps.size());
+    file.write(LIGHTMAP_MAGIC, sizeof(LIGHTMAP_MAGIC));
+    file.write(reinterpret_cast<const char*>(&LIGHTMAP_VERSION), sizeof(LIGHTMAP_VERSION));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    std::vector<float> texels;
+    for (auto& lightmap : lightmaps) {
+        uint32_t index = lightmap.renderableIndex;
+        uint32_t resolution = uint32_t(lightmap.resolution);
+        texels.resize(size_t(resolution) * resolution * 4);
+
+        cgra::gl_state::bind_texture(GL_TEXTURE_2D, lightmap.texture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, texels.data());
+
+        file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+        file.write(reinterpret_cast<const char*>(&resolution), sizeof(resolution));
+        file.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(float));
+    }
+
+    if (!file) {
+        std::cerr << "Error: Failed to write lightmaps to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool LightmapBaker::load(const std::string& path, const std::vector<Renderable*>& renderables) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(LIGHTMAP_MAGIC)];
+    uint32_t version = 0, count = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, LIGHTMAP_MAGIC, sizeof(magic)) != 0 || version != LIGHTMAP_VERSION) {
+        std::cerr << "Error: " << path << " is not a lightmap file of version " << LIGHTMAP_VERSION << std::endl;
+        return false;
+    }
+
+    auto targets = getLightmappedRenderables(renderables);
+    if (count > targets.size()) {
+        std::cerr << "Error: " << path << " holds " << count << " lightmaps, the scene has room for " << targets.size() << std::endl;
+        return false;
+    }
+
+    // read everything before touching the current bake, so a bad file leaves it intact
+    std::vector<std::pair<uint32_t, std::vector<float>>> loaded;
+    std::vector<uint32_t> resolutions;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = 0, resolution = 0;
+        file.read(reinterpret_cast<char*>(&index), sizeof(index));
+        file.read(reinterpret_cast<char*>(&resolution), sizeof(resolution));
+        if (!file || index >= targets.size() || resolution == 0 || resolution > MAX_LIGHTMAP_RESOLUTION) {
+            std::cerr << "Error: Corrupt lightmap entry " << i << " in " << path << std::endl;
+            return false;
+        }
+        std::vector<float> texels(size_t(resolution) * resolution * 4);
+        file.read(reinterpret_cast<char*>(texels.data()), texels.size() * sizeof(float));
+        if (!file) {
+            std::cerr << "Error: Unexpected end of " << path << std::endl;
+            return false;
+        }
+        loaded.emplace_back(index, std::move(texels));
+        resolutions.push_back(resolution);
+    }
+
+    clear(renderables);
+    for (size_t i = 0; i < loaded.size(); i++) {
+        GLuint texture = createTexture(int(resolutions[i]), loaded[i].second.data());
+        lightmaps.push_back({ loaded[i].first, targets[loaded[i].first], int(resolutions[i]), texture });
+        targets[loaded[i].first]->setBakedLightmap(texture);
+    }
+    return true;
+}
+
+GLuint LightmapBaker::createTexture(int resolution, const float* data) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, resolution, resolution, 0, GL_RGBA, GL_FLOAT, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+std::vector<Renderable*> LightmapBaker::getLightmappedRenderables(const std::vector<Renderable*>& renderables) {
+    std::vector<Renderable*> out{};
+    for (auto obj : renderables) {
+        if (obj->supportsLightmap())
+            out.push_back(obj);
+    }
+    return out;
+}
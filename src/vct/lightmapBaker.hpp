@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <renderable.hpp>
+#include "gBufferLightingPass.hpp"
+
+// Static GI bake. Renders every renderable that supports lightmaps into a G-buffer in lightmap (uv) space,
+// traces the diffuse cones once per texel and hands the irradiance back to the renderable, so the lighting
+// pass only has to trace the view dependent terms for it. Bakes can be saved to and loaded from disk, a bake
+// is only meaningful for the scene (and voxelization) it was made in.
+class LightmapBaker {
+public:
+	struct BakeParams {
+		int resolution = 1024;
+		int numDiffuseCones = 128; // one-off cost, so far more than the per frame pass can afford
+		std::string path = "lightmaps.bin";
+	};
+	BakeParams params;
+
+	LightmapBaker() = default;
+	~LightmapBaker();
+	LightmapBaker(const LightmapBaker&) = delete;
+	LightmapBaker& operator=(const LightmapBaker&) = delete;
+
+	// the voxels must be up to date before baking
+	void bake(const std::vector<Renderable*>& renderables, gBufferLightingPass* lightingPass);
+	// detaches the lightmaps from the renderables and frees them
+	void clear(const std::vector<Renderable*>& renderables);
+	// the same for one renderable, when what its lightmap was baked from changes. It traces every frame again
+	void invalidate(Renderable* renderable);
+
+	bool save(const std::string& path) const;
+	// lightmaps are matched to the renderables by their order among the ones that support lightmaps, renderables
+	// without one (invalidated before saving) keep tracing
+	bool load(const std::string& path, const std::vector<Renderable*>& renderables);
+
+	size_t getLightmapCount() const { return lightmaps.size(); }
+	float getLastBakeMs() const { return lastBakeMs; }
+
+private:
+	struct Lightmap {
+		unsigned int renderableIndex;
+		Renderable* renderable;
+		int resolution;
+		GLuint texture;
+	};
+	std::vector<Lightmap> lightmaps;
+	float lastBakeMs = 0;
+
+	static GLuint createTexture(int resolution, const float* data);
+	static std::vector<Renderable*> getLightmappedRenderables(const std::vector<Renderable*>& renderables);
+};
@@ -0,0 +1,86 @@
+#include "materialTextures.hpp"
+#include <cgra/cgra_state.hpp>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "cgra/cgra_image.hpp"
+
+MaterialTextures& MaterialTextures::get() {
+    static MaterialTextures registry;
+    return registry;
+}
+
+int MaterialTextures::load(const std::string& path) {
+    requests++;
+    auto it = byPath.find(path);
+    if (it != byPath.end()) return it->second;
+
+    cgra::rgba_image image(path);
+    std::vector<unsigned char> pixels;
+    if (image.size.x == LAYER_SIZE && image.size.y == LAYER_SIZE) {
+        pixels = std::move(image.data);
+    } else {
+        pixels.resize(size_t(LAYER_SIZE) * LAYER_SIZE * 4);
+        stbir_resize_uint8(image.data.data(), image.size.x, image.size.y, 0, pixels.data(), LAYER_SIZE, LAYER_SIZE, 0, 4);
+    }
+
+    if (layers == capacity) grow(layers + 1);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D_ARRAY, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layers, LAYER_SIZE, LAYER_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+    bind();
+
+    byPath[path] = layers;
+    return layers++;
+}
+
+void MaterialTextures::setSampler(GLuint program, const char* name) {
+    cgra::gl_state::use_program(program);
+    glUniform1i(glGetUniformLocation(program, name), UNIT);
+}
+
+void MaterialTextures::bind() const {
+    cgra::gl_state::active_texture(GL_TEXTURE0 + UNIT);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D_ARRAY, texture);
+    cgra::gl_state::active_texture(GL_TEXTURE0);
+}
+
+size_t MaterialTextures::getBytes() const {
+    size_t bytes = 0;
+    for (int level = 0; level < levels(); level++) {
+        size_t side = std::max(LAYER_SIZE >> level, 1);
+        bytes += side * side * 4;
+    }
+    return bytes * capacity;
+}
+
+void MaterialTextures::grow(int needed) {
+    int newCapacity = std::max({needed, capacity * 2, 4});
+    GLuint grown = 0;
+    glGenTextures(1, &grown);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D_ARRAY, grown);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels(), GL_RGBA8, LAYER_SIZE, LAYER_SIZE, newCapacity);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    cgra::gl_state::bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if (texture) {
+        for (int level = 0; level < levels(); level++) {
+            int side = std::max(LAYER_SIZE >> level, 1);
+            glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, grown, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, side, side, layers);
+        }
+        cgra::gl_state::delete_textures(1, &texture);
+    }
+    texture = grown;
+    capacity = newCapacity;
+}
+
+int MaterialTextures::levels() {
+    int count = 1;
+    while ((LAYER_SIZE >> count) > 0) count++;
+    return count;
+}
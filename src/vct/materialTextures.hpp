@@ -0,0 +1,41 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <unordered_map>
+
+// Registry of the material textures of the scene (terrain layers, bark, leaves). Each path is loaded once and
+// resampled into a layer of one mipmapped GL_TEXTURE_2D_ARRAY that stays bound to texture unit UNIT, so
+// materials pick their textures by layer index instead of binding textures for every draw.
+class MaterialTextures {
+public:
+	static constexpr int LAYER_SIZE = 1024; // width and height of every layer
+	static constexpr GLuint UNIT = 15;      // no other pass binds this unit
+
+	static MaterialTextures& get();
+
+	// layer of the texture at path, loaded and packed into the array the first time it is asked for
+	int load(const std::string& path);
+
+	// points the program's sampler2DArray uniform at UNIT
+	static void setSampler(GLuint program, const char* name = "uMaterialArray");
+	// binds the array to UNIT, the active texture unit is left at 0
+	void bind() const;
+
+	GLuint getTexture() const { return texture; }
+	int getLayers() const { return layers; }
+	int getRequests() const { return requests; } // load() calls, the ones served from the cache included
+	size_t getBytes() const;
+
+private:
+	GLuint texture = 0;
+	int capacity = 0;
+	int layers = 0;
+	int requests = 0;
+	std::unordered_map<std::string, int> byPath;
+
+	MaterialTextures() = default;
+	// reallocates the array with room for at least the given layers and copies the existing ones over
+	void grow(int needed);
+	static int levels();
+};
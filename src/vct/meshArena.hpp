@@ -0,0 +1,249 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <renderable.hpp>
+
+// Shared vertex / index buffers for renderables that hand their geometry over (see Renderable::getArenaGeometry).
+// Their meshes are packed into one VAO and every group of draws with the same program, primitive and state is
+// submitted with a single glMultiDrawElementsIndirect. GL 4.4 has no gl_DrawID, so the draw index reaches the
+// shaders as an instanced attribute (location 5) read at the command's base instance, it indexes the per draw
+// object records (model matrix and material) in the storage buffer at binding 7.
+class meshArena {
+public:
+	struct arena_params {
+		bool enabled;
+	};
+	arena_params params;
+
+	struct arena_stats {
+		int meshes = 0;
+		int vertices = 0;
+		int indices = 0;
+		int draws = 0;     // renderables submitted by the last draw()
+		int drawCalls = 0; // multi draw calls they took
+		int rebuilds = 0;
+	};
+
+	meshArena() {
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ibo);
+		glGenBuffers(1, &drawIndexBuffer);
+		glGenBuffers(1, &indirectBuffer);
+		glGenBuffers(1, &objectBuffer);
+
+		cgra::gl_state::bind_vertex_array(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(arena_vertex), (void*)offsetof(arena_vertex, pos));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(arena_vertex), (void*)offsetof(arena_vertex, norm));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(arena_vertex), (void*)offsetof(arena_vertex, uv));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(arena_vertex), (void*)offsetof(arena_vertex, extra));
+		glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		glEnableVertexAttribArray(5);
+		glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+		glVertexAttribDivisor(5, 1);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		cgra::gl_state::bind_vertex_array(0);
+
+		setDefaultParams();
+	}
+
+	~meshArena() {
+		cgra::gl_state::delete_vertex_arrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ibo);
+		glDeleteBuffers(1, &drawIndexBuffer);
+		glDeleteBuffers(1, &indirectBuffer);
+		glDeleteBuffers(1, &objectBuffer);
+	}
+
+	void setDefaultParams() {
+		params.enabled = true;
+	}
+
+	// the geometry of the renderables changed, pack it again on the next update
+	void markDirty() { dirty = true; }
+
+	// packs the geometry of every renderable that supports the arena again if any of it changed
+	void update(const std::vector<Renderable*>& renderables) {
+		std::vector<Renderable*> current;
+		for (auto obj : renderables) {
+			if (params.enabled && obj->supportsMultiDraw()) current.push_back(obj);
+		}
+		if (!dirty && packed(current) && current.size() == slices.size()) return;
+		pack(current);
+	}
+
+	bool contains(Renderable* obj) const { return slices.count(obj) != 0; }
+
+	// draws the given renderables, the ones not packed by update() are drawn on their own, the camera must
+	// already be in the frame constants (see frameConstants.hpp)
+	void draw(const std::vector<Renderable*>& objs) {
+		stats.draws = 0;
+		stats.drawCalls = 0;
+
+		// group by program, primitive and state, the commands of a group are contiguous
+		std::map<std::tuple<GLuint, GLenum, GLuint>, std::vector<Renderable*>> groups;
+		for (auto obj : objs) {
+			if (!contains(obj)) {
+				obj->setObjectUniforms();
+				obj->draw();
+				continue;
+			}
+			ArenaGeometry geometry = obj->getArenaGeometry();
+			groups[{ obj->getShader(), geometry.mode, geometry.stateKey }].push_back(obj);
+		}
+
+		std::vector<indirect_command> commands;
+		std::vector<object_record> objects;
+		std::vector<std::pair<size_t, size_t>> ranges; // first command and count per group
+		for (auto& group : groups) {
+			ranges.push_back({ commands.size(), group.second.size() });
+			for (auto obj : group.second) {
+				const mesh_slice& slice = slices[obj];
+				GLuint drawIndex = GLuint(objects.size());
+				commands.push_back({ slice.indexCount, 1, slice.firstIndex, slice.baseVertex, drawIndex });
+				objects.push_back({ obj->getModelTransform(), obj->getArenaGeometry().material });
+			}
+		}
+		if (commands.empty()) return;
+		ensureDrawIndices(objects.size());
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(indirect_command), commands.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(object_record), objects.data(), GL_STREAM_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, objectBuffer);
+
+		cgra::gl_state::bind_vertex_array(vao);
+		size_t groupIndex = 0;
+		for (auto& group : groups) {
+			GLuint shader = std::get<0>(group.first);
+			GLenum mode = std::get<1>(group.first);
+			auto range = ranges[groupIndex++];
+			// the first renderable binds the state the whole group shares
+			group.second.front()->bindArenaState();
+			GLint multiDraw = multiDrawLocation(shader);
+			cgra::gl_state::use_program(shader);
+			glUniform1i(multiDraw, 1);
+			glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)(range.first * sizeof(indirect_command)), GLsizei(range.second), 0);
+			glUniform1i(multiDraw, 0);
+			stats.drawCalls++;
+		}
+		cgra::gl_state::bind_vertex_array(0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		stats.draws = int(commands.size());
+	}
+
+	const arena_stats& getStats() const { return stats; }
+
+private:
+	struct arena_vertex {
+		glm::vec3 pos;
+		glm::vec3 norm;
+		glm::vec2 uv;
+		float extra;
+	};
+	struct indirect_command { // DrawElementsIndirectCommand
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+	struct object_record { // std430 ObjectRecord
+		glm::mat4 model;
+		glm::ivec4 material;
+	};
+	struct mesh_slice {
+		GLuint geometryId;
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+	};
+
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ibo = 0;
+	GLuint drawIndexBuffer = 0; // 0, 1, 2, ... read per instance, so attribute 5 = base instance = draw index
+	GLuint indirectBuffer = 0;
+	GLuint objectBuffer = 0;
+	size_t drawIndexCount = 0;
+	std::map<Renderable*, mesh_slice> slices;
+	std::map<GLuint, GLint> multiDrawLocations; // uMultiDraw of every program seen, looked up once
+	bool dirty = true;
+	arena_stats stats;
+
+	// true if every renderable is in the arena with the geometry it has now
+	bool packed(const std::vector<Renderable*>& objs) const {
+		for (auto obj : objs) {
+			auto it = slices.find(obj);
+			if (it == slices.end() || it->second.geometryId != obj->getArenaGeometry().geometryId) return false;
+		}
+		return true;
+	}
+
+	// uploads the geometry of every renderable into fresh buffers, renderables that stopped being drawn drop out
+	void pack(const std::vector<Renderable*>& objs) {
+		slices.clear();
+		std::vector<arena_vertex> vertices;
+		std::vector<GLuint> indices;
+		for (auto obj : objs) {
+			if (slices.count(obj)) continue;
+			ArenaGeometry geometry = obj->getArenaGeometry();
+			mesh_slice slice{ geometry.geometryId, GLuint(indices.size()), 0, GLint(vertices.size()) };
+			if (geometry.vertices) {
+				for (size_t i = 0; i < geometry.vertices->size(); i++) {
+					const cgra::mesh_vertex& v = (*geometry.vertices)[i];
+					float extra = (geometry.extra && i < geometry.extra->size()) ? (*geometry.extra)[i] : 0.0f;
+					vertices.push_back({ v.pos, v.norm, v.uv, extra });
+				}
+			}
+			if (geometry.indices) indices.insert(indices.end(), geometry.indices->begin(), geometry.indices->end());
+			slice.indexCount = GLuint(indices.size()) - slice.firstIndex;
+			slices[obj] = slice;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(vertices.size(), 1) * sizeof(arena_vertex), vertices.empty() ? nullptr : vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		cgra::gl_state::bind_vertex_array(vao);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(GLuint), indices.empty() ? nullptr : indices.data(), GL_STATIC_DRAW);
+		cgra::gl_state::bind_vertex_array(0);
+
+		stats.meshes = int(slices.size());
+		stats.vertices = int(vertices.size());
+		stats.indices = int(indices.size());
+		stats.rebuilds++;
+		dirty = false;
+	}
+
+	GLint multiDrawLocation(GLuint program) {
+		auto it = multiDrawLocations.find(program);
+		if (it != multiDrawLocations.end()) return it->second;
+		return multiDrawLocations[program] = glGetUniformLocation(program, "uMultiDraw");
+	}
+
+	void ensureDrawIndices(size_t count) {
+		if (count <= drawIndexCount) return;
+		drawIndexCount = std::max(count, drawIndexCount * 2);
+		std::vector<GLuint> drawIndices(drawIndexCount);
+		std::iota(drawIndices.begin(), drawIndices.end(), 0u);
+		glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
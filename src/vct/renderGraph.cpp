@@ -0,0 +1,286 @@
+#include "renderGraph.hpp"
+#include <cgra/cgra_state.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+void RenderGraph::PassBuilder::read(Resource resource, Access access) {
+	graph.passes[pass].reads.push_back({resource, access});
+}
+
+void RenderGraph::PassBuilder::write(Resource resource, Access access) {
+	graph.passes[pass].writes.push_back({resource, access});
+}
+
+void RenderGraph::PassBuilder::sideEffect() {
+	graph.passes[pass].sideEffect = true;
+}
+
+RenderGraph::~RenderGraph() {
+	releasePool();
+}
+
+void RenderGraph::reset() {
+	resources.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const std::string& name, const TextureDesc& desc) {
+	ResourceNode node;
+	node.name = name;
+	node.transient = true;
+	node.desc = desc;
+	resources.push_back(node);
+	return Resource(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const std::string& name, GLuint texture) {
+	ResourceNode node;
+	node.name = name;
+	node.texture = texture;
+	resources.push_back(node);
+	return Resource(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(Resource resource) {
+	resources[resource].output = true;
+}
+
+void RenderGraph::addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const std::function<void()>& execute) {
+	PassNode node;
+	node.name = name;
+	node.execute = execute;
+	passes.push_back(node);
+	PassBuilder builder(*this, int(passes.size()) - 1);
+	setup(builder);
+}
+
+void RenderGraph::compile() {
+	sortPasses();
+	cullPasses();
+	computeBarriers();
+	assignTransients();
+	compiled = true;
+}
+
+void RenderGraph::execute() {
+	if (!compiled) compile();
+	passLog.clear();
+	for (int p : order) {
+		PassNode& pass = passes[p];
+		if (pass.culled) {
+			passLog.push_back("-" + pass.name);
+			continue;
+		}
+		if (pass.barrier) glMemoryBarrier(pass.barrier);
+		pass.execute();
+		passLog.push_back(pass.name);
+	}
+	// transients don't survive the frame, nothing may hold on to their textures
+	for (auto& resource : resources) {
+		if (resource.transient) resource.texture = 0;
+	}
+}
+
+GLuint RenderGraph::getTexture(Resource resource) const {
+	return resources[resource].texture;
+}
+
+void RenderGraph::releasePool() {
+	for (auto& pooled : pool) cgra::gl_state::delete_textures(1, &pooled.texture);
+	pool.clear();
+}
+
+// Kahn's algorithm over read-after-write, write-after-write and write-after-read edges, ties are broken by the
+// order the passes were added in
+void RenderGraph::sortPasses() {
+	int count = int(passes.size());
+	std::vector<std::vector<int>> successors(count);
+	std::vector<int> incoming(count, 0);
+	auto addEdge = [&](int from, int to) {
+		if (from < 0 || from == to) return;
+		successors[from].push_back(to);
+		incoming[to]++;
+	};
+
+	std::vector<int> lastWriter(resources.size(), -1);
+	std::vector<std::vector<int>> readersSinceWrite(resources.size());
+	for (int p = 0; p < count; p++) {
+		for (auto& use : passes[p].reads) {
+			addEdge(lastWriter[use.resource], p);
+			readersSinceWrite[use.resource].push_back(p);
+		}
+		for (auto& use : passes[p].writes) {
+			addEdge(lastWriter[use.resource], p);
+			for (int reader : readersSinceWrite[use.resource]) addEdge(reader, p);
+			lastWriter[use.resource] = p;
+			readersSinceWrite[use.resource].clear();
+		}
+	}
+
+	order.clear();
+	std::vector<bool> done(count, false);
+	for (int placed = 0; placed < count; placed++) {
+		int next = -1;
+		for (int p = 0; p < count && next < 0; p++) {
+			if (!done[p] && incoming[p] == 0) next = p;
+		}
+		if (next < 0) throw std::runtime_error("Render graph has a dependency cycle!");
+		done[next] = true;
+		order.push_back(next);
+		for (int s : successors[next]) incoming[s]--;
+	}
+}
+
+// walks the passes backwards keeping the resources someone still needs, a pass that writes none of them goes
+void RenderGraph::cullPasses() {
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t r = 0; r < resources.size(); r++) needed[r] = resources[r].output;
+
+	stats.culledPasses = 0;
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		PassNode& pass = passes[*it];
+		bool keep = pass.sideEffect;
+		for (auto& use : pass.writes) keep = keep || needed[use.resource];
+		pass.culled = !keep;
+		if (!keep) {
+			stats.culledPasses++;
+			continue;
+		}
+		// writes may be partial (eg. drawing into the G-buffer), earlier writers stay needed
+		for (auto& use : pass.reads) needed[use.resource] = true;
+	}
+	stats.passes = int(passes.size());
+}
+
+// image stores and storage buffer writes are incoherent, the next pass touching the resource needs a barrier
+// for the way it touches it. Framebuffer writes are ordered by GL and need none.
+void RenderGraph::computeBarriers() {
+	std::vector<bool> pending(resources.size(), false);
+	std::vector<GLbitfield> issued(resources.size(), 0);
+	stats.barriers = 0;
+	for (int p : order) {
+		PassNode& pass = passes[p];
+		pass.barrier = 0;
+		if (pass.culled) continue;
+
+		auto require = [&](const Use& use) {
+			if (!pending[use.resource]) return;
+			GLbitfield bits = barrierFor(use.access);
+			if ((issued[use.resource] & bits) == bits) return;
+			pass.barrier |= bits;
+			issued[use.resource] |= bits;
+		};
+		for (auto& use : pass.reads) require(use);
+		for (auto& use : pass.writes) require(use);
+
+		for (auto& use : pass.writes) {
+			pending[use.resource] = use.access != Access::ATTACHMENT;
+			issued[use.resource] = 0;
+		}
+		if (pass.barrier) stats.barriers++;
+	}
+}
+
+void RenderGraph::assignTransients() {
+	for (auto& resource : resources) {
+		resource.firstUse = resource.lastUse = -1;
+		resource.physical = -1;
+		if (resource.transient) resource.texture = 0;
+	}
+	for (int position = 0; position < int(order.size()); position++) {
+		const PassNode& pass = passes[order[position]];
+		if (pass.culled) continue;
+		auto touch = [&](const Use& use) {
+			ResourceNode& resource = resources[use.resource];
+			if (resource.firstUse < 0) resource.firstUse = position;
+			resource.lastUse = position;
+		};
+		for (auto& use : pass.reads) touch(use);
+		for (auto& use : pass.writes) touch(use);
+	}
+
+	std::vector<int> transients;
+	for (int r = 0; r < int(resources.size()); r++) {
+		ResourceNode& resource = resources[r];
+		if (!resource.transient || resource.firstUse < 0) continue;
+		// an output has to survive until the end of the frame
+		if (resource.output) resource.lastUse = int(order.size());
+		transients.push_back(r);
+	}
+	std::sort(transients.begin(), transients.end(), [&](int a, int b) { return resources[a].firstUse < resources[b].firstUse; });
+
+	for (auto& pooled : pool) pooled.busyUntil = -1;
+	stats.transientTextures = int(transients.size());
+	stats.unaliasedTransientBytes = 0;
+	std::vector<bool> usedPool;
+	for (int r : transients) {
+		ResourceNode& resource = resources[r];
+		resource.physical = acquire(resource.desc, resource.firstUse, resource.lastUse);
+		resource.texture = pool[resource.physical].texture;
+		stats.unaliasedTransientBytes += size_t(resource.desc.width) * resource.desc.height * bytesPerTexel(resource.desc.internalFormat);
+		usedPool.resize(pool.size(), false);
+		usedPool[resource.physical] = true;
+	}
+	stats.physicalTextures = int(std::count(usedPool.begin(), usedPool.end(), true));
+
+	// the most memory the transients hold at any point of the frame, aliased textures counted once
+	stats.peakTransientBytes = 0;
+	for (int position = 0; position < int(order.size()); position++) {
+		std::vector<bool> live(pool.size(), false);
+		for (int r : transients) {
+			if (resources[r].firstUse <= position && position <= resources[r].lastUse) live[resources[r].physical] = true;
+		}
+		size_t bytes = 0;
+		for (size_t i = 0; i < pool.size(); i++) {
+			if (live[i]) bytes += size_t(pool[i].desc.width) * pool[i].desc.height * bytesPerTexel(pool[i].desc.internalFormat);
+		}
+		stats.peakTransientBytes = std::max(stats.peakTransientBytes, bytes);
+	}
+	stats.pooledBytes = 0;
+	for (auto& pooled : pool) stats.pooledBytes += size_t(pooled.desc.width) * pooled.desc.height * bytesPerTexel(pooled.desc.internalFormat);
+}
+
+// a pooled texture of the same description that is free for the whole interval, or a new one
+int RenderGraph::acquire(const TextureDesc& desc, int from, int until) {
+	for (int i = 0; i < int(pool.size()); i++) {
+		if (pool[i].desc == desc && pool[i].busyUntil < from) {
+			pool[i].busyUntil = until;
+			return i;
+		}
+	}
+
+	PooledTexture pooled;
+	pooled.desc = desc;
+	pooled.busyUntil = until;
+	glGenTextures(1, &pooled.texture);
+	cgra::gl_state::bind_texture(GL_TEXTURE_2D, pooled.texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	pool.push_back(pooled);
+	return int(pool.size()) - 1;
+}
+
+GLbitfield RenderGraph::barrierFor(Access access) {
+	switch (access) {
+		case Access::ATTACHMENT: return GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+		case Access::IMAGE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+		case Access::STORAGE_BUFFER: return GL_SHADER_STORAGE_BARRIER_BIT;
+	}
+	return GL_ALL_BARRIER_BITS;
+}
+
+size_t RenderGraph::bytesPerTexel(GLenum internalFormat) {
+	switch (internalFormat) {
+		case GL_R8: return 1;
+		case GL_R16F: case GL_RG8: case GL_RGBA4: return 2;
+		case GL_RGBA8: case GL_R32F: case GL_R32UI: case GL_RG16F: case GL_DEPTH_COMPONENT32F: return 4;
+		case GL_RGBA16F: case GL_RGBA16: case GL_RG32F: return 8;
+		case GL_RGBA32F: return 16;
+	}
+	return 4;
+}
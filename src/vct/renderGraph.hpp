@@ -0,0 +1,134 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Per frame render graph. Passes are added every frame with the resources they read and write, compile()
+// orders them by their dependencies, drops passes nothing reads from, works out which glMemoryBarrier bits
+// are needed between a writer and its readers and assigns the transient textures to a pool of GL textures
+// that outlives the frame, textures whose lifetimes don't overlap share one. Imported resources (the
+// permanent targets of the passes) only take part in the ordering and the barriers.
+class RenderGraph {
+public:
+	using Resource = int;
+
+	// how a pass touches a resource, decides which barrier a later reader needs
+	enum class Access {
+		ATTACHMENT,     // framebuffer attachment, or a sampled read
+		IMAGE,          // image load / store
+		STORAGE_BUFFER, // shader storage buffer
+	};
+
+	struct TextureDesc {
+		int width = 1;
+		int height = 1;
+		GLenum internalFormat = GL_RGBA16F;
+		bool operator==(const TextureDesc& other) const {
+			return width == other.width && height == other.height && internalFormat == other.internalFormat;
+		}
+	};
+
+	class PassBuilder {
+	public:
+		void read(Resource resource, Access access = Access::ATTACHMENT);
+		void write(Resource resource, Access access = Access::ATTACHMENT);
+		// the pass must run even if nothing reads what it writes, eg. it draws to the window
+		void sideEffect();
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+		RenderGraph& graph;
+		int pass;
+	};
+
+	struct FrameStats {
+		int passes = 0;
+		int culledPasses = 0;
+		int barriers = 0;
+		int transientTextures = 0;          // logical transients this frame
+		int physicalTextures = 0;           // pool textures they were aliased onto
+		size_t peakTransientBytes = 0;      // most transient memory live at once
+		size_t unaliasedTransientBytes = 0; // what the transients would take with a texture each
+		size_t pooledBytes = 0;             // everything the pool holds
+	};
+
+	RenderGraph() = default;
+	~RenderGraph();
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// starts a new frame, all passes and resources of the last one are forgotten (the pool is kept)
+	void reset();
+
+	Resource createTexture(const std::string& name, const TextureDesc& desc);
+	Resource importTexture(const std::string& name, GLuint texture = 0);
+	// the resource is needed after the frame, its writers are never culled
+	void markOutput(Resource resource);
+
+	void addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const std::function<void()>& execute);
+
+	void compile();
+	void execute();
+
+	// the GL texture of a resource, transients only have one during execute()
+	GLuint getTexture(Resource resource) const;
+
+	const FrameStats& getStats() const { return stats; }
+	// names of the passes that ran last frame in order, culled ones are prefixed with '-'
+	const std::vector<std::string>& getPassLog() const { return passLog; }
+
+	// frees the pooled textures, eg. after a resize made them useless
+	void releasePool();
+
+private:
+	struct ResourceNode {
+		std::string name;
+		bool transient = false;
+		bool output = false;
+		TextureDesc desc;
+		GLuint texture = 0;
+		int physical = -1;  // pool index of a transient
+		int firstUse = -1;  // execution order positions
+		int lastUse = -1;
+	};
+
+	struct Use {
+		Resource resource;
+		Access access;
+	};
+
+	struct PassNode {
+		std::string name;
+		std::function<void()> execute;
+		std::vector<Use> reads;
+		std::vector<Use> writes;
+		bool sideEffect = false;
+		bool culled = false;
+		GLbitfield barrier = 0; // issued before the pass runs
+	};
+
+	struct PooledTexture {
+		TextureDesc desc;
+		GLuint texture = 0;
+		int busyUntil = -1; // last execution position of the transient using it this frame
+	};
+
+	std::vector<ResourceNode> resources;
+	std::vector<PassNode> passes;
+	std::vector<int> order;
+	std::vector<PooledTexture> pool;
+	std::vector<std::string> passLog;
+	FrameStats stats;
+	bool compiled = false;
+
+	void sortPasses();
+	void cullPasses();
+	void computeBarriers();
+	void assignTransients();
+	int acquire(const TextureDesc& desc, int from, int until);
+
+	static GLbitfield barrierFor(Access access);
+	static size_t bytesPerTexel(GLenum internalFormat);
+};
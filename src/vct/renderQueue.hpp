@@ -0,0 +1,108 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <renderable.hpp>
+
+// Sort key render queue. Every draw is submitted with a 64 bit key, most significant first:
+//   pass (4 bits) | program (16 bits) | texture set (16 bits) | depth (24 bits) | spare (4 bits)
+// so a radix sort of the keys groups the draws of a pass by program, then by textures, and orders them front to
+// back inside a group for early depth rejection. The queue counts the program and texture set switches of the
+// sorted order against the order the draws were submitted in.
+class renderQueue {
+public:
+	enum Pass : uint64_t {
+		PREPASS = 0,
+	};
+
+	struct queue_stats {
+		int draws = 0;
+		int programSwitches = 0;
+		int textureSwitches = 0;
+		int unsortedProgramSwitches = 0; // what the submission order would have taken
+		int unsortedTextureSwitches = 0;
+	};
+
+	struct item {
+		uint64_t key;
+		Renderable* obj;
+	};
+
+	void clear() {
+		items.clear();
+	}
+
+	// depth is the view distance normalised to the far plane, clamped to [0, 1], shader is the program obj draws with
+	void submit(Pass pass, Renderable* obj, GLuint shader, float depth) {
+		uint64_t program = index(programs, shader);
+		uint64_t textures = index(textureSets, obj->getTextureSetKey());
+		uint64_t quantized = uint64_t(std::min(std::max(depth, 0.0f), 1.0f) * float(DEPTH_MASK));
+		uint64_t key = (uint64_t(pass) << 60) | (program << 44) | (textures << 28) | (quantized << 4);
+		items.push_back({ key, obj });
+	}
+
+	// sorts the submitted draws and returns them in execution order
+	const std::vector<item>& sort() {
+		stats = queue_stats();
+		stats.draws = int(items.size());
+		countSwitches(stats.unsortedProgramSwitches, stats.unsortedTextureSwitches);
+		radixSort();
+		countSwitches(stats.programSwitches, stats.textureSwitches);
+		return items;
+	}
+
+	const queue_stats& getStats() const { return stats; }
+
+private:
+	static constexpr uint64_t DEPTH_MASK = (1ull << 24) - 1;
+	static constexpr uint64_t FIELD_MASK = (1ull << 16) - 1;
+
+	std::vector<item> items;
+	std::vector<item> scratch;
+	std::vector<uint32_t> counts;
+	// small stable indices for the programs and texture sets seen so far, their order is the sort order
+	std::unordered_map<GLuint, uint64_t> programs;
+	std::unordered_map<GLuint, uint64_t> textureSets;
+	queue_stats stats;
+
+	static uint64_t index(std::unordered_map<GLuint, uint64_t>& table, GLuint id) {
+		auto it = table.find(id);
+		if (it != table.end()) return it->second;
+		uint64_t next = std::min<uint64_t>(table.size(), FIELD_MASK); // overflow shares the last slot
+		table[id] = next;
+		return next;
+	}
+
+	void countSwitches(int& programSwitches, int& textureSwitches) const {
+		for (size_t i = 0; i < items.size(); i++) {
+			uint64_t program = (items[i].key >> 44) & FIELD_MASK;
+			uint64_t textures = (items[i].key >> 28) & FIELD_MASK;
+			if (i == 0 || program != ((items[i - 1].key >> 44) & FIELD_MASK)) programSwitches++;
+			if (i == 0 || program != ((items[i - 1].key >> 44) & FIELD_MASK) || textures != ((items[i - 1].key >> 28) & FIELD_MASK)) textureSwitches++;
+		}
+	}
+
+	// least significant digit first, 16 bit digits, digits that are the same for every key are skipped
+	void radixSort() {
+		if (items.size() < 2) return;
+		scratch.resize(items.size());
+		counts.resize(1 << 16);
+		for (int shift = 0; shift < 64; shift += 16) {
+			std::fill(counts.begin(), counts.end(), 0);
+			for (auto& it : items) counts[(it.key >> shift) & FIELD_MASK]++;
+			if (counts[(items[0].key >> shift) & FIELD_MASK] == items.size()) continue;
+
+			uint32_t offset = 0;
+			for (auto& count : counts) {
+				uint32_t c = count;
+				count = offset;
+				offset += c;
+			}
+			for (auto& it : items) scratch[counts[(it.key >> shift) & FIELD_MASK]++] = it;
+			items.swap(scratch);
+		}
+	}
+};
@@ -0,0 +1,186 @@
+#include "sceneRegistry.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cgra/cgra_shader.hpp>
+
+SceneRegistry::~SceneRegistry() {
+    clear();
+}
+
+SceneRegistry::Handle SceneRegistry::add(Renderable* obj, bool owns) {
+    uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        index = uint32_t(slots.size());
+        slots.push_back({});
+    }
+    if (!cgra::shader_builder::ready(obj->getShader())) {
+        slots[index].dense = WAITING_INDEX;
+        waiting.push_back({ index, obj, owns });
+    }
+    else {
+        obj->onProgramReady();
+        insert(index, obj, owns);
+    }
+    return { index, slots[index].generation };
+}
+
+void SceneRegistry::insert(uint32_t index, Renderable* obj, bool owns) {
+    Slot& slot = slots[index];
+    slot.dense = uint32_t(objects.size());
+
+    objects.push_back(obj);
+    transforms.push_back(obj->getModelTransform());
+    bounds.push_back(obj->getWorldBounds());
+    shaders.push_back(obj->getShader());
+    dirty.push_back(0);
+    owned.push_back(owns);
+    slotOf.push_back(index);
+    setDirty(slot.dense, DIRTY_ADDED);
+}
+
+bool SceneRegistry::remove(Handle handle) {
+    if (!contains(handle)) return false;
+    Slot& slot = slots[handle.index];
+
+    // never drawn, so nothing has to catch up on it
+    if (slot.dense == WAITING_INDEX) {
+        auto it = std::find_if(waiting.begin(), waiting.end(), [&](const Waiting& w) { return w.slot == handle.index; });
+        if (it->owns) delete it->obj;
+        waiting.erase(it);
+        slot.dense = INVALID_INDEX;
+        slot.generation++;
+        freeSlots.push_back(handle.index);
+        return true;
+    }
+
+    size_t dense = slot.dense;
+    size_t last = objects.size() - 1;
+    if (dirty[dense]) dirtyCount--;
+    if (owned[dense]) delete objects[dense];
+
+    // the last entry fills the hole
+    if (dense != last) {
+        objects[dense] = objects[last];
+        transforms[dense] = transforms[last];
+        bounds[dense] = bounds[last];
+        shaders[dense] = shaders[last];
+        dirty[dense] = dirty[last];
+        owned[dense] = owned[last];
+        slotOf[dense] = slotOf[last];
+        slots[slotOf[dense]].dense = uint32_t(dense);
+    }
+    objects.pop_back();
+    transforms.pop_back();
+    bounds.pop_back();
+    shaders.pop_back();
+    dirty.pop_back();
+    owned.pop_back();
+    slotOf.pop_back();
+
+    slot.dense = INVALID_INDEX;
+    slot.generation++;
+    freeSlots.push_back(handle.index);
+    removals++;
+    return true;
+}
+
+void SceneRegistry::clear() {
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (owned[i]) delete objects[i];
+    }
+    for (auto& w : waiting) {
+        if (w.owns) delete w.obj;
+    }
+    waiting.clear();
+    if (!objects.empty()) removals++;
+    objects.clear();
+    transforms.clear();
+    bounds.clear();
+    shaders.clear();
+    dirty.clear();
+    owned.clear();
+    slotOf.clear();
+    dirtyCount = 0;
+
+    // the slots are kept with a new generation, so no old handle matches again
+    freeSlots.clear();
+    for (uint32_t i = uint32_t(slots.size()); i-- > 0;) {
+        slots[i].dense = INVALID_INDEX;
+        slots[i].generation++;
+        freeSlots.push_back(i);
+    }
+}
+
+bool SceneRegistry::contains(Handle handle) const {
+    return handle.index < slots.size() && slots[handle.index].generation == handle.generation && slots[handle.index].dense != INVALID_INDEX;
+}
+
+Renderable* SceneRegistry::get(Handle handle) const {
+    if (!contains(handle)) return nullptr;
+    uint32_t dense = slots[handle.index].dense;
+    if (dense != WAITING_INDEX) return objects[dense];
+    for (auto& w : waiting) {
+        if (w.slot == handle.index) return w.obj;
+    }
+    return nullptr;
+}
+
+void SceneRegistry::sync() {
+    for (size_t i = 0; i < waiting.size();) {
+        Waiting w = waiting[i];
+        GLuint shader = w.obj->getShader();
+        if (!cgra::shader_builder::ready(shader)) {
+            if (cgra::shader_builder::failed(shader)) {
+                // it never becomes drawable, its handle goes stale as if it was removed
+                std::cerr << "Error: Dropped a renderable from the scene, its program did not compile or link" << std::endl;
+                remove({ w.slot, slots[w.slot].generation });
+            }
+            else i++;
+            continue;
+        }
+        waiting.erase(waiting.begin() + i);
+        w.obj->onProgramReady();
+        insert(w.slot, w.obj, w.owns);
+    }
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        Renderable* obj = objects[i];
+        uint8_t flags = 0;
+        glm::mat4 transform = obj->getModelTransform();
+        if (transform != transforms[i]) {
+            transforms[i] = transform;
+            flags |= DIRTY_TRANSFORM;
+        }
+        WorldBounds b = obj->getWorldBounds();
+        if (b.valid != bounds[i].valid || b.min != bounds[i].min || b.max != bounds[i].max) {
+            bounds[i] = b;
+            flags |= DIRTY_BOUNDS;
+        }
+        GLuint shader = obj->getShader();
+        if (shader != shaders[i]) {
+            shaders[i] = shader;
+            flags |= DIRTY_SHADER;
+        }
+        if (flags) setDirty(i, flags);
+    }
+}
+
+void SceneRegistry::markDirty(Handle handle, uint8_t flags) {
+    // a waiting renderable has no dense entry yet, it is flagged as added once it gets one
+    if (!contains(handle) || slots[handle.index].dense == WAITING_INDEX) return;
+    setDirty(slots[handle.index].dense, flags);
+}
+
+void SceneRegistry::clearDirty() {
+    std::fill(dirty.begin(), dirty.end(), 0);
+    dirtyCount = 0;
+    removals = 0;
+}
+
+void SceneRegistry::setDirty(size_t dense, uint8_t flags) {
+    if (!dirty[dense]) dirtyCount++;
+    dirty[dense] |= flags;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include <renderable.hpp>
+
+// The renderables of the scene. add() returns a generational handle that stays valid until the renderable is
+// removed, a freed slot is reused with the next generation so a stale handle is recognised instead of reaching
+// whatever took its place. The per renderable data lives in parallel dense arrays (renderable, model transform,
+// world bounds, program, dirty flags): remove() moves the last entry into the hole, so insert and remove are O(1)
+// and walking the scene never skips a gap. The dense order is not the insertion order.
+// sync() caches the transforms, bounds and programs once a frame and flags the entries whose values changed,
+// together with the added ones and any removal that is what a voxelization has to catch up on.
+// A renderable whose program is still linking (cgra::shader_builder::submit) waits outside the dense arrays, so
+// no pass sees it, until a sync() finds the program ready. It gets its onProgramReady() then and is added. If
+// the program fails instead, sync() drops the renderable as remove() would.
+class SceneRegistry {
+public:
+	static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+	static constexpr uint32_t WAITING_INDEX = UINT32_MAX - 1; // the slot's renderable waits for its program
+
+	struct Handle {
+		uint32_t index = INVALID_INDEX; // slot, not dense position
+		uint32_t generation = 0;
+		bool operator==(const Handle& other) const = default;
+	};
+
+	enum DirtyFlags : uint8_t {
+		DIRTY_ADDED = 1,
+		DIRTY_TRANSFORM = 2,
+		DIRTY_BOUNDS = 4,
+		DIRTY_SHADER = 8,
+	};
+
+	SceneRegistry() = default;
+	~SceneRegistry();
+	SceneRegistry(const SceneRegistry&) = delete;
+	SceneRegistry& operator=(const SceneRegistry&) = delete;
+
+	// an owned renderable is deleted when it is removed or the registry is cleared
+	Handle add(Renderable* obj, bool owns = false);
+	// false if the handle is stale
+	bool remove(Handle handle);
+	// removes everything, every handle handed out so far becomes stale
+	void clear();
+
+	bool contains(Handle handle) const;
+	Renderable* get(Handle handle) const;
+
+	// adds the waiting renderables whose program is ready, then reads the transform, bounds and program of every
+	// renderable and flags what changed since the last sync
+	void sync();
+	// does nothing for a renderable still waiting for its program
+	void markDirty(Handle handle, uint8_t flags);
+	// something was added, removed or flagged since clearDirty()
+	bool changed() const { return removals > 0 || dirtyCount > 0; }
+	size_t getRemovals() const { return removals; }
+	void clearDirty();
+
+	// dense arrays, index i of each belongs to the same renderable, transforms, bounds and programs as of the last sync
+	size_t size() const { return objects.size(); }
+	const std::vector<Renderable*>& getObjects() const { return objects; }
+	const std::vector<glm::mat4>& getTransforms() const { return transforms; }
+	const std::vector<WorldBounds>& getBounds() const { return bounds; }
+	const std::vector<GLuint>& getShaders() const { return shaders; }
+	const std::vector<uint8_t>& getDirty() const { return dirty; }
+	// added, but not in the dense arrays yet
+	size_t getWaiting() const { return waiting.size(); }
+
+private:
+	struct Slot {
+		uint32_t dense = INVALID_INDEX; // position in the dense arrays, INVALID_INDEX while free
+		uint32_t generation = 0;
+	};
+
+	struct Waiting {
+		uint32_t slot;
+		Renderable* obj;
+		bool owns;
+	};
+	std::vector<Waiting> waiting;
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+
+	std::vector<Renderable*> objects;
+	std::vector<glm::mat4> transforms;
+	std::vector<WorldBounds> bounds;
+	std::vector<GLuint> shaders;
+	std::vector<uint8_t> dirty;
+	std::vector<uint8_t> owned;
+	std::vector<uint32_t> slotOf; // dense position -> slot
+
+	size_t dirtyCount = 0; // entries with any dirty flag
+	size_t removals = 0;   // since clearDirty()
+
+	void setDirty(size_t dense, uint8_t flags);
+	void insert(uint32_t slot, Renderable* obj, bool owns);
+};
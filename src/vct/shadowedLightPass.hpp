@@ -0,0 +1,275 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cgra/cgra_shader.hpp>
+#include <renderable.hpp>
+#include "gBufferPrepass.hpp"
+#include "frameConstants.hpp"
+#include "fullscreenQuad.hpp"
+#include "voxelizer.hpp"
+#include "gpuTimer.hpp"
+#include "uniformLocations.hpp"
+
+// Analytic direct light for the primary point light with a cube shadow map. The faces are rendered with the
+// G-buffer prepass from the light (so every material shader works unchanged) and reduced to distances. The
+// shadowed light is also injected into a volume over the voxels, the light's own voxels are left out, so the
+// cones only carry its bounced light and the direct part no longer depends on the cone count.
+// Both are only rebuilt when the light, the voxels or the parameters change.
+class shadowedLightPass {
+public:
+	struct shadow_params {
+		bool enabled;
+		glm::vec3 position;
+		glm::vec3 color;
+		float intensity;
+		float radius;          // range of the light, also the far plane of the shadow faces
+		int shadowResolution;  // per cube face
+		float shadowBias;
+		int injectResolution;  // cells per axis of the injection volume, rounded down to a power of two
+	};
+	shadow_params params;
+	Renderable* lightRenderable = nullptr; // not drawn into the shadow map or the voxels
+
+	shadowedLightPass(Voxelizer* voxelizerObj) : voxelizer(voxelizerObj) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//shadow_distance_frag.glsl"));
+		distanceShader = sb.build();
+
+		cgra::shader_builder injectBuilder;
+		injectBuilder.set_shader(GL_COMPUTE_SHADER, CGRA_SRCDIR + std::string("//res//shaders//direct_light_inject_comp.glsl"));
+		injectShader = injectBuilder.build();
+
+		cgra::gl_state::use_program(distanceShader);
+		glUniform1i(glGetUniformLocation(distanceShader, "gBufferDepth"), 0);
+		cgra::gl_state::use_program(injectShader);
+		glUniform1i(glGetUniformLocation(injectShader, "voxelTex1"), 0);
+		glUniform1i(glGetUniformLocation(injectShader, "voxelTex2"), 1);
+		glUniform1i(glGetUniformLocation(injectShader, "uShadowMap"), 2);
+
+		glGenFramebuffers(1, &cubeFbo);
+		setDefaultParams();
+	}
+
+	~shadowedLightPass() {
+		cgra::gl_state::use_program(0);
+		if (distanceShader != 0 && glIsProgram(distanceShader)) {
+			cgra::shader_builder::release(distanceShader);
+			distanceShader = 0;
+		}
+		if (injectShader != 0 && glIsProgram(injectShader)) {
+			cgra::shader_builder::release(injectShader);
+			injectShader = 0;
+		}
+		cgra::gl_state::delete_framebuffers(1, &cubeFbo);
+		cgra::gl_state::delete_textures(1, &shadowCube);
+		cgra::gl_state::delete_textures(1, &injectTex);
+		delete faceBuffer;
+	}
+
+	void setDefaultParams() {
+		params.enabled = false;
+		params.position = glm::vec3(0);
+		params.color = glm::vec3(1);
+		params.intensity = 200;
+		params.radius = 60;
+		params.shadowResolution = 512;
+		params.shadowBias = 0.05;
+		params.injectResolution = 128;
+	}
+
+	// the voxels changed, rebuild on the next update
+	void markDirty() { dirty = true; }
+
+	// skips the light's own geometry while it is evaluated analytically
+	bool excludes(const Renderable* obj) const { return params.enabled && obj == lightRenderable; }
+
+	// rebuilds the shadow cube and the injection volume if anything they depend on changed
+	void update(const std::vector<Renderable*>& renderables, float diffuseBrightnessMultiplier) {
+		if (!params.enabled) return;
+		if (params.position != built.position || params.color != built.color || params.intensity != built.intensity
+			|| params.radius != built.radius || params.shadowBias != built.shadowBias
+			|| params.shadowResolution != built.shadowResolution || params.injectResolution != built.injectResolution
+			|| diffuseBrightnessMultiplier != builtMultiplier)
+			dirty = true;
+		if (!dirty) return;
+
+		timer.begin();
+		GLint previousViewport[4];
+		cgra::gl_state::get_viewport(previousViewport);
+		if (params.shadowResolution != built.shadowResolution || shadowCube == 0) setupShadowCube();
+		if (getInjectResolution() != built.injectResolution || injectTex == 0) setupInjectTexture();
+		renderShadowCube(renderables);
+		inject(diffuseBrightnessMultiplier);
+		cgra::gl_state::viewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		timer.end();
+
+		built = params;
+		built.injectResolution = getInjectResolution();
+		builtMultiplier = diffuseBrightnessMultiplier;
+		dirty = false;
+	}
+
+	// sets the light uniforms and binds the shadow cube and the injection volume for the (bound) lighting program
+	void bindForLighting(GLuint program, GLenum shadowUnit, GLenum injectUnit) const {
+		bool active = params.enabled && shadowCube != 0 && injectTex != 0;
+		const auto& u = lightingUniforms.of(program);
+		glUniform1i(u[ENABLED], active);
+		if (!active) return;
+		glUniform3fv(u[POSITION], 1, glm::value_ptr(params.position));
+		glUniform3fv(u[COLOR], 1, glm::value_ptr(params.color * params.intensity));
+		glUniform1f(u[RADIUS], params.radius);
+		glUniform1f(u[BIAS], params.shadowBias);
+		glUniform1f(u[MIP_OFFSET], getMipOffset());
+		cgra::gl_state::active_texture(shadowUnit);
+		cgra::gl_state::bind_texture(GL_TEXTURE_CUBE_MAP, shadowCube);
+		cgra::gl_state::active_texture(injectUnit);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, injectTex);
+	}
+
+	// the mips of the injection volume, run as a pass of its own after update() so the render graph puts the
+	// barrier for the image stores in between. Nothing to do if update() didn't inject
+	void generateMips() {
+		if (!mipsStale) return;
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, injectTex);
+		glGenerateMipmap(GL_TEXTURE_3D);
+		mipsStale = false;
+	}
+
+	GLuint getInjectTexture() const { return params.enabled ? injectTex : 0; }
+	// mip of the voxel volume that matches the injection resolution
+	float getMipOffset() const { return std::log2(float(voxelizer->m_params.resolution) / float(std::max(built.injectResolution, 1))); }
+	float getLastUpdateMs() const { return timer.getMs(); }
+
+private:
+	enum LightingUniform { ENABLED, POSITION, COLOR, RADIUS, BIAS, MIP_OFFSET };
+	uniformLocations<6> lightingUniforms{{ "uShadowedLightEnabled", "uShadowedLightPos", "uShadowedLightColor",
+		"uShadowedLightRadius", "uShadowBias", "uDirectMipOffset" }};
+
+	Voxelizer* voxelizer;
+	GLuint distanceShader = 0;
+	GLuint injectShader = 0;
+	GLuint cubeFbo = 0;
+	GLuint shadowCube = 0;
+	GLuint injectTex = 0;
+	gBufferPrepass* faceBuffer = nullptr;
+	shadow_params built{};
+	float builtMultiplier = 0;
+	bool dirty = true;
+	bool mipsStale = false; // injected since the last generateMips()
+	fullscreenQuad quad;
+	gpuTimer timer;
+
+	int getInjectResolution() const {
+		int resolution = 1;
+		while (resolution * 2 <= std::min(params.injectResolution, voxelizer->m_params.resolution)) resolution *= 2;
+		return resolution;
+	}
+
+	void renderShadowCube(const std::vector<Renderable*>& renderables) {
+		static const std::array<glm::vec3, 6> directions = {
+			glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+		static const std::array<glm::vec3, 6> ups = {
+			glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+		glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, params.radius);
+
+		frameConstants& frame = frameConstants::get();
+		frameConstants::block saved = frame.getBlock();
+		for (int face = 0; face < 6; face++) {
+			glm::mat4 view = glm::lookAt(params.position, params.position + directions[face], ups[face]);
+			frame.setCamera(view, proj);
+			faceBuffer->executePrepass([&]() {
+				for (auto obj : renderables) {
+					if (obj == lightRenderable) continue;
+					obj->setObjectUniforms();
+					obj->draw();
+				}
+			}, proj * view);
+
+			cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, cubeFbo);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, shadowCube, 0);
+			cgra::gl_state::viewport(0, 0, params.shadowResolution, params.shadowResolution);
+			cgra::gl_state::use_program(distanceShader);
+			glUniform3fv(glGetUniformLocation(distanceShader, "uLightPos"), 1, glm::value_ptr(params.position));
+			glUniformMatrix4fv(glGetUniformLocation(distanceShader, "uInverseViewProj"), 1, GL_FALSE, glm::value_ptr(faceBuffer->getInverseViewProj()));
+			cgra::gl_state::active_texture(GL_TEXTURE0);
+			cgra::gl_state::bind_texture(GL_TEXTURE_2D, faceBuffer->getDepthTexture());
+			quad.draw();
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+		frame.setBlock(saved);
+	}
+
+	void inject(float diffuseBrightnessMultiplier) {
+		int resolution = getInjectResolution();
+		cgra::gl_state::use_program(injectShader);
+		glUniform1i(glGetUniformLocation(injectShader, "uResolution"), resolution);
+		glUniform1f(glGetUniformLocation(injectShader, "uMipOffset"), std::log2(float(voxelizer->m_params.resolution) / float(resolution)));
+		glUniform1f(glGetUniformLocation(injectShader, "uVoxelWorldSize"), voxelizer->m_params.worldSize);
+		glUniform3fv(glGetUniformLocation(injectShader, "uVoxelCenter"), 1, glm::value_ptr(voxelizer->m_params.center));
+		glUniform3fv(glGetUniformLocation(injectShader, "uLightPos"), 1, glm::value_ptr(params.position));
+		glUniform3fv(glGetUniformLocation(injectShader, "uLightColor"), 1, glm::value_ptr(params.color * params.intensity));
+		glUniform1f(glGetUniformLocation(injectShader, "uLightRadius"), params.radius);
+		glUniform1f(glGetUniformLocation(injectShader, "uShadowBias"), params.shadowBias);
+		glUniform1f(glGetUniformLocation(injectShader, "uDiffuseBrightnessMultiplier"), diffuseBrightnessMultiplier);
+
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex1);
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex2);
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_CUBE_MAP, shadowCube);
+		glBindImageTexture(0, injectTex, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+		int groups = (resolution + 3) / 4;
+		glDispatchCompute(groups, groups, groups);
+		mipsStale = true;
+	}
+
+	void setupShadowCube() {
+		cgra::gl_state::delete_textures(1, &shadowCube);
+		glGenTextures(1, &shadowCube);
+		cgra::gl_state::bind_texture(GL_TEXTURE_CUBE_MAP, shadowCube);
+		for (int face = 0; face < 6; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_R32F, params.shadowResolution, params.shadowResolution, 0, GL_RED, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, cubeFbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, shadowCube, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Shadow cube framebuffer is not complete!");
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+		delete faceBuffer;
+		faceBuffer = new gBufferPrepass(params.shadowResolution, params.shadowResolution);
+	}
+
+	void setupInjectTexture() {
+		cgra::gl_state::delete_textures(1, &injectTex);
+		int resolution = getInjectResolution();
+		int levels = 1 + int(std::floor(std::log2(float(resolution))));
+		glGenTextures(1, &injectTex);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, injectTex);
+		glTexStorage3D(GL_TEXTURE_3D, levels, GL_RGBA16F, resolution, resolution, resolution);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+	}
+};
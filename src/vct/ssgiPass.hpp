@@ -0,0 +1,137 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <stdexcept>
+#include <string>
+#include <cgra/cgra_shader.hpp>
+#include "gBufferPrepass.hpp"
+#include "fullscreenQuad.hpp"
+#include "gpuTimer.hpp"
+#include "uniformLocations.hpp"
+
+// Screen space diffuse GI for the near field (contact lighting in creases and under plants). Writes the
+// irradiance gathered within the handoff distance and the hemisphere fraction still open beyond it, the
+// lighting pass starts its diffuse cones at the handoff distance and only fills that open part.
+class ssgiPass {
+public:
+	struct ssgi_params {
+		bool enabled;
+		float handoffDistance; // world space distance where the voxel cones take over
+		int directions;
+		int steps;
+		float strength;
+	};
+	ssgi_params params;
+
+	ssgiPass(int targetWidth, int targetHeight)
+		: width(targetWidth), height(targetHeight) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//ssgi_frag.glsl"));
+		shader = sb.build();
+
+		cgra::gl_state::use_program(shader);
+		glUniform1i(glGetUniformLocation(shader, "gBufferDepth"), 0);
+		glUniform1i(glGetUniformLocation(shader, "gBufferNormal"), 1);
+		glUniform1i(glGetUniformLocation(shader, "uPrevSceneColor"), 2);
+
+		setDefaultParams();
+		setupTargets();
+	}
+
+	~ssgiPass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		deleteTargets();
+	}
+
+	void setDefaultParams() {
+		params.enabled = true;
+		params.handoffDistance = 1.0;
+		params.directions = 4;
+		params.steps = 8;
+		params.strength = 1.0;
+	}
+
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		deleteTargets();
+		setupTargets();
+	}
+
+	// gathers the near field from the G-buffer, the radiance comes from last frame's scene colour
+	void run(const gBufferPrepass* prepass, GLuint prevSceneColor, const glm::mat4& view, const glm::mat4& proj, const glm::mat4& prevViewProj) {
+		if (!params.enabled) return;
+		timer.begin();
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		cgra::gl_state::viewport(0, 0, width, height);
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		glUniformMatrix4fv(u[VIEW_MATRIX], 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(u[PROJ_MATRIX], 1, GL_FALSE, glm::value_ptr(proj));
+		glUniformMatrix4fv(u[PREV_VIEW_PROJ], 1, GL_FALSE, glm::value_ptr(prevViewProj));
+		glUniformMatrix4fv(u[INVERSE_VIEW_PROJ], 1, GL_FALSE, glm::value_ptr(prepass->getInverseViewProj()));
+		glUniform1f(u[RADIUS], params.handoffDistance);
+		glUniform1i(u[DIRECTIONS], params.directions);
+		glUniform1i(u[STEPS], params.steps);
+		glUniform1f(u[STRENGTH], params.strength);
+
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getDepthTexture());
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getAttachment(gBufferPrepass::NORMAL_MATERIAL));
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prevSceneColor);
+
+		quad.draw();
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+		timer.end();
+	}
+
+	// near field irradiance.rgb + open hemisphere fraction
+	GLuint getTexture() const { return texture; }
+	float getPassMs() const { return params.enabled ? timer.getSmoothedMs() : 0.0f; }
+	float getLastPassMs() const { return params.enabled ? timer.getMs() : 0.0f; }
+
+private:
+	GLuint shader = 0;
+	enum Uniform { VIEW_MATRIX, PROJ_MATRIX, PREV_VIEW_PROJ, INVERSE_VIEW_PROJ, RADIUS, DIRECTIONS, STEPS, STRENGTH };
+	uniformLocations<8> uniforms{{ "uViewMatrix", "uProjMatrix", "uPrevViewProj", "uInverseViewProj", "uRadius",
+		"uDirections", "uSteps", "uStrength" }};
+	GLuint fbo = 0;
+	GLuint texture = 0;
+	int width, height;
+	fullscreenQuad quad;
+	gpuTimer timer;
+
+	void setupTargets() {
+		glGenFramebuffers(1, &fbo);
+		glGenTextures(1, &texture);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("SSGI framebuffer is not complete!");
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void deleteTargets() {
+		cgra::gl_state::delete_framebuffers(1, &fbo);
+		cgra::gl_state::delete_textures(1, &texture);
+	}
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <cgra/cgra_shader.hpp>
+#include "gBufferPrepass.hpp"
+#include "fullscreenQuad.hpp"
+#include "gpuTimer.hpp"
+#include "uniformLocations.hpp"
+
+// Temporal upscaler for the final frame. The renderer jitters the projection by a sub pixel offset every
+// frame, this pass reprojects its history with the G-buffer positions and accumulates the low resolution
+// scene colour into a history at output resolution. The resolve sharpens the result.
+class temporalUpscalePass {
+public:
+	struct upscale_params {
+		bool enabled;
+		float feedback;   // history weight, higher = smoother and more stable, lower = less ghosting
+		float clampGamma; // width of the neighbourhood clamp in standard deviations
+		float sharpness;  // strength of the sharpen in the resolve
+	};
+	upscale_params params;
+
+	temporalUpscalePass(int outputWidth, int outputHeight)
+		: width(outputWidth), height(outputHeight) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//temporal_upscale_frag.glsl"));
+		shader = sb.build();
+
+		cgra::gl_state::use_program(shader);
+		glUniform1i(glGetUniformLocation(shader, "uCurrent"), 0);
+		glUniform1i(glGetUniformLocation(shader, "uHistory"), 1);
+		glUniform1i(glGetUniformLocation(shader, "gBufferDepth"), 2);
+
+		setDefaultParams();
+		setupTargets();
+	}
+
+	~temporalUpscalePass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		deleteTargets();
+	}
+
+	void setDefaultParams() {
+		params.enabled = false;
+		params.feedback = 0.9;
+		params.clampGamma = 1.25;
+		params.sharpness = 0.2;
+	}
+
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		deleteTargets();
+		setupTargets();
+	}
+
+	// drop the history, eg. after a cut or when the pass was off
+	void invalidate() { historyValid = false; }
+
+	// sub pixel offset (in render pixels, -0.5 to 0.5) for the next frame, a Halton(2, 3) sequence
+	glm::vec2 nextJitter() {
+		frameIndex = (frameIndex + 1) % JITTER_PHASES;
+		jitter = glm::vec2(halton(frameIndex + 1, 2), halton(frameIndex + 1, 3)) - 0.5f;
+		return jitter;
+	}
+
+	// the projection with the current jitter applied, for a target of the given render size
+	glm::mat4 jitterProjection(glm::mat4 proj, int renderWidth, int renderHeight) const {
+		proj[2][0] += 2.0f * jitter.x / float(renderWidth);
+		proj[2][1] += 2.0f * jitter.y / float(renderHeight);
+		return proj;
+	}
+
+	// accumulates the render resolution scene colour into the history, returns the output resolution result
+	GLuint run(GLuint sceneColor, const gBufferPrepass* prepass, const glm::mat4& view, const glm::mat4& proj) {
+		timer.begin();
+		glm::mat4 viewProj = proj * view;
+		int target = 1 - current;
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbos[target]);
+		cgra::gl_state::viewport(0, 0, width, height);
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		glUniformMatrix4fv(u[INVERSE_VIEW_PROJ], 1, GL_FALSE, glm::value_ptr(prepass->getInverseViewProj()));
+		glUniformMatrix4fv(u[PREV_VIEW_PROJ], 1, GL_FALSE, glm::value_ptr(prevViewProj));
+		glUniform2f(u[JITTER], jitter.x, jitter.y);
+		glUniform1f(u[FEEDBACK], params.feedback);
+		glUniform1f(u[CLAMP_GAMMA], params.clampGamma);
+		glUniform1i(u[HISTORY_VALID], historyValid);
+
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, sceneColor);
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, textures[current]);
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, prepass->getDepthTexture());
+
+		quad.draw();
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+		current = target;
+		prevViewProj = viewProj;
+		historyValid = true;
+		timer.end();
+		return textures[current];
+	}
+
+	float getPassMs() const { return params.enabled ? timer.getSmoothedMs() : 0.0f; }
+
+private:
+	static constexpr int JITTER_PHASES = 8;
+
+	GLuint shader = 0;
+	enum Uniform { INVERSE_VIEW_PROJ, PREV_VIEW_PROJ, JITTER, FEEDBACK, CLAMP_GAMMA, HISTORY_VALID };
+	uniformLocations<6> uniforms{{ "uInverseViewProj", "uPrevViewProj", "uJitter", "uFeedback", "uClampGamma",
+		"uHistoryValid" }};
+	int width, height;
+	std::array<GLuint, 2> fbos{};
+	std::array<GLuint, 2> textures{}; // history ping-pong at output resolution
+	int current = 0;
+	bool historyValid = false;
+	int frameIndex = 0;
+	glm::vec2 jitter = glm::vec2(0);
+	glm::mat4 prevViewProj = glm::mat4(1);
+	fullscreenQuad quad;
+	gpuTimer timer;
+
+	static float halton(int index, int base) {
+		float result = 0.0f;
+		float fraction = 1.0f;
+		while (index > 0) {
+			fraction /= float(base);
+			result += fraction * float(index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	void setupTargets() {
+		glGenFramebuffers(fbos.size(), fbos.data());
+		glGenTextures(textures.size(), textures.data());
+
+		for (size_t i = 0; i < textures.size(); i++) {
+			cgra::gl_state::bind_texture(GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbos[i]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				throw std::runtime_error("Temporal upscale framebuffer is not complete!");
+			}
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+		historyValid = false;
+	}
+
+	void deleteTargets() {
+		cgra::gl_state::delete_framebuffers(fbos.size(), fbos.data());
+		cgra::gl_state::delete_textures(textures.size(), textures.data());
+	}
+};
@@ -0,0 +1,111 @@
+#include "tracerStats.hpp"
+#include <iostream>
+
+// matches TracerStatsBuffer in lighting_pass_frag.glsl (std430)
+struct GpuTracerStats {
+    GLuint pixels;
+    GLuint cones;
+    GLuint stepsLow;
+    GLuint stepsHigh;
+    GLuint terminatedOccluded;
+    GLuint terminatedLeftVolume;
+    GLuint terminatedMaxSteps;
+    GLuint padding;
+    GLuint stepHistogram[TracerStats::STEP_BUCKETS];
+    GLuint mipHistogram[TracerStats::MIP_BUCKETS];
+};
+
+static const GLuint TRACER_STATS_BINDING = 3;
+
+TracerStats::TracerStats() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuTracerStats), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+TracerStats::~TracerStats() {
+    glDeleteBuffers(1, &buffer);
+    if (logFile.is_open()) logFile.close();
+}
+
+void TracerStats::bindForLighting(GLuint program, bool bakeMode) {
+    bool stats = params.enabled && !bakeMode;
+    const auto& u = lightingUniforms.of(program);
+    glUniform1i(u[STATS], stats);
+    glUniform1i(u[HEATMAP], params.heatmap && !bakeMode);
+    glUniform1f(u[HEATMAP_MAX_STEPS], params.heatmapMaxSteps);
+    if (!stats) return;
+
+    GpuTracerStats zero{};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRACER_STATS_BINDING, buffer);
+}
+
+void TracerStats::collect(float maxSteps) {
+    if (!params.enabled) return;
+    frameIndex++;
+    lastMaxSteps = maxSteps;
+
+    GpuTracerStats gpu{};
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(gpu), &gpu);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    summary.pixels = gpu.pixels;
+    summary.cones = gpu.cones;
+    summary.steps = double(gpu.stepsHigh) * 4294967296.0 + double(gpu.stepsLow);
+    summary.conesPerPixel = gpu.pixels > 0 ? float(gpu.cones) / float(gpu.pixels) : 0.0f;
+    summary.meanStepsPerCone = gpu.cones > 0 ? float(summary.steps / gpu.cones) : 0.0f;
+    float cones = gpu.cones > 0 ? float(gpu.cones) : 1.0f;
+    summary.occludedPercent = 100.0f * gpu.terminatedOccluded / cones;
+    summary.leftVolumePercent = 100.0f * gpu.terminatedLeftVolume / cones;
+    summary.maxStepsPercent = 100.0f * gpu.terminatedMaxSteps / cones;
+    for (int i = 0; i < STEP_BUCKETS; i++) stepHistogram[i] = float(gpu.stepHistogram[i]);
+    for (int i = 0; i < MIP_BUCKETS; i++) mipHistogram[i] = float(gpu.mipHistogram[i]);
+
+    if (params.logToFile) logFrame();
+}
+
+bool TracerStats::dumpCsv(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    file << "pixels,cones,steps,cones per pixel,mean steps per cone,occluded %,left volume %,max steps %\n";
+    file << summary.pixels << ',' << summary.cones << ',' << summary.steps << ',' << summary.conesPerPixel << ','
+        << summary.meanStepsPerCone << ',' << summary.occludedPercent << ',' << summary.leftVolumePercent << ','
+        << summary.maxStepsPercent << "\n\n";
+
+    file << "mean steps per cone from,to,pixels\n";
+    float bucketSize = lastMaxSteps / STEP_BUCKETS;
+    for (int i = 0; i < STEP_BUCKETS; i++)
+        file << i * bucketSize << ',' << (i + 1) * bucketSize << ',' << stepHistogram[i] << '\n';
+
+    file << "\nmax mip,pixels\n";
+    for (int i = 0; i < MIP_BUCKETS; i++)
+        file << i << ',' << mipHistogram[i] << '\n';
+    return bool(file);
+}
+
+void TracerStats::logFrame() {
+    if (!logFile.is_open() || openLogPath != params.logPath) {
+        if (logFile.is_open()) logFile.close();
+        logFile.open(params.logPath, std::ios::out | std::ios::trunc);
+        openLogPath = params.logPath;
+        if (!logFile) {
+            std::cerr << "Error: Could not open " << params.logPath << " for writing" << std::endl;
+            params.logToFile = false;
+            return;
+        }
+        logFile << "frame,pixels,cones,cones per pixel,mean steps per cone,occluded %,left volume %,max steps %\n";
+    }
+    logFile << frameIndex << ',' << summary.pixels << ',' << summary.cones << ',' << summary.conesPerPixel << ','
+        << summary.meanStepsPerCone << ',' << summary.occludedPercent << ',' << summary.leftVolumePercent << ','
+        << summary.maxStepsPercent << '\n';
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+#include <fstream>
+#include <string>
+#include "uniformLocations.hpp"
+
+// Instrumentation for the cone tracer. While enabled the lighting shader adds the steps, cones, termination
+// reasons and highest mip of every pixel to a storage buffer, which is read back after the lighting pass.
+// The read back waits for the GPU, so it is only meant for tuning sessions.
+class TracerStats {
+public:
+	static constexpr int STEP_BUCKETS = 32;
+	static constexpr int MIP_BUCKETS = 16;
+
+	struct StatsParams {
+		bool enabled = false;
+		bool heatmap = false;
+		float heatmapMaxSteps = 2000.0f; // steps per pixel shown as full red
+		bool logToFile = false;
+		std::string logPath = "tracer_stats.csv";
+	};
+
+	struct Summary {
+		unsigned int pixels = 0;
+		unsigned int cones = 0;
+		double steps = 0;
+		float conesPerPixel = 0;
+		float meanStepsPerCone = 0;
+		float occludedPercent = 0;    // transmittance threshold or first hit
+		float leftVolumePercent = 0;
+		float maxStepsPercent = 0;
+	};
+
+	StatsParams params;
+
+	TracerStats();
+	~TracerStats();
+
+	// sets the statistics uniforms on the given (bound) lighting program and resets the counters
+	void bindForLighting(GLuint program, bool bakeMode);
+	// reads the counters of the last lighting pass back, maxSteps is the cone step limit it ran with
+	void collect(float maxSteps);
+
+	const Summary& getSummary() const { return summary; }
+	// pixel counts, as floats for plotting
+	const std::array<float, STEP_BUCKETS>& getStepHistogram() const { return stepHistogram; }
+	const std::array<float, MIP_BUCKETS>& getMipHistogram() const { return mipHistogram; }
+
+	// writes the summary and both histograms of the last collected frame
+	bool dumpCsv(const std::string& path) const;
+
+private:
+	enum LightingUniform { STATS, HEATMAP, HEATMAP_MAX_STEPS };
+	uniformLocations<3> lightingUniforms{{ "uTracerStats", "uTracerHeatmap", "uHeatmapMaxSteps" }};
+
+	GLuint buffer = 0;
+	Summary summary;
+	std::array<float, STEP_BUCKETS> stepHistogram{};
+	std::array<float, MIP_BUCKETS> mipHistogram{};
+	float lastMaxSteps = 0;
+	unsigned long frameIndex = 0;
+	std::ofstream logFile;
+	std::string openLogPath;
+
+	void logFrame();
+};
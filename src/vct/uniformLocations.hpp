@@ -0,0 +1,27 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+
+// Locations of a fixed list of uniforms, looked up once per program so per frame code never passes names to
+// GL. Passes index the result with an enum in the order of the names, programs without a uniform get -1 for it
+// (which glUniform ignores), so one list can serve a pass's own program and the lighting program it binds to.
+template <size_t N>
+class uniformLocations {
+public:
+	explicit uniformLocations(const std::array<const char*, N>& names) : names(names) {}
+
+	const std::array<GLint, N>& of(GLuint program) const {
+		auto it = cache.find(program);
+		if (it != cache.end()) return it->second;
+		std::array<GLint, N> found;
+		for (size_t i = 0; i < N; i++) found[i] = glGetUniformLocation(program, names[i]);
+		return cache.emplace(program, found).first->second;
+	}
+
+private:
+	std::array<const char*, N> names;
+	mutable std::unordered_map<GLuint, std::array<GLint, N>> cache;
+};
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cgra/cgra_shader.hpp>
+#include <renderable.hpp>
+#include "gBufferPrepass.hpp"
+#include "fullscreenQuad.hpp"
+#include "gpuTimer.hpp"
+#include "materialTextures.hpp"
+#include "frameConstants.hpp"
+
+// Visibility buffer for renderables whose geometry is expanded by geometry shaders (the plants). Their
+// geometry shader output is captured to world space triangles once, every frame those are drawn with depth
+// and a packed (draw, primitive) id only, then a single full screen pass reconstructs the attributes of the
+// visible triangle and writes the G-buffer, so overdraw in dense canopies costs an id write instead of a
+// geometry shader and material evaluation per layer.
+class visibilityBufferPass {
+public:
+	struct visibility_params {
+		bool enabled;
+	};
+	visibility_params params;
+
+	static constexpr int MAX_DRAWS = 4095;            // 12 bits of the id, 0 is kept for "nothing"
+	static constexpr int MAX_PRIMITIVES = 1 << 20;    // 20 bits of the id
+	static constexpr int FLOATS_PER_VERTEX = 9;       // captured gl_Position.xyzw, normal.xyz, uvCoord.xy
+
+	// links a material program so its geometry shader output can be captured, use instead of sb.submit()
+	static GLuint buildCapturable(cgra::shader_builder& sb) {
+		sb.set_transform_feedback_varyings({ "gl_Position", "normal", "uvCoord" }, GL_INTERLEAVED_ATTRIBS);
+		return sb.submit();
+	}
+
+	visibilityBufferPass() {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//visibility_vert.glsl"));
+		sb.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//visibility_frag.glsl"));
+		visibilityShader = sb.build();
+
+		cgra::shader_builder resolveBuilder;
+		resolveBuilder.set_shader(GL_VERTEX_SHADER, CGRA_SRCDIR + std::string("//res//shaders//fullscreen_quad_vert.glsl"));
+		resolveBuilder.set_shader(GL_FRAGMENT_SHADER, CGRA_SRCDIR + std::string("//res//shaders//visibility_resolve_frag.glsl"));
+		resolveShader = resolveBuilder.build();
+
+		cgra::gl_state::use_program(resolveShader);
+		glUniform1i(glGetUniformLocation(resolveShader, "uVisibility"), 0);
+		MaterialTextures::setSampler(resolveShader);
+		viewProjLocation = glGetUniformLocation(visibilityShader, "uViewProj");
+		drawIndexLocation = glGetUniformLocation(visibilityShader, "uDrawIndex");
+		inverseViewProjLocation = glGetUniformLocation(resolveShader, "uInverseViewProj");
+
+		glGenBuffers(1, &arenaBuffer);
+		glGenBuffers(1, &drawBuffer);
+		glGenBuffers(1, &materialBuffer);
+		glGenVertexArrays(1, &vao);
+		cgra::gl_state::bind_vertex_array(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, arenaBuffer);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		cgra::gl_state::bind_vertex_array(0);
+		glGenQueries(1, &primitiveQuery);
+
+		setDefaultParams();
+	}
+
+	~visibilityBufferPass() {
+		cgra::gl_state::use_program(0);
+		if (visibilityShader != 0 && glIsProgram(visibilityShader)) {
+			cgra::shader_builder::release(visibilityShader);
+			visibilityShader = 0;
+		}
+		if (resolveShader != 0 && glIsProgram(resolveShader)) {
+			cgra::shader_builder::release(resolveShader);
+			resolveShader = 0;
+		}
+		glDeleteBuffers(1, &arenaBuffer);
+		glDeleteBuffers(1, &drawBuffer);
+		glDeleteBuffers(1, &materialBuffer);
+		cgra::gl_state::delete_vertex_arrays(1, &vao);
+		glDeleteQueries(1, &primitiveQuery);
+		deleteTargets();
+	}
+
+	void setDefaultParams() {
+		params.enabled = false;
+	}
+
+	// the scene changed, capture again before the next frame
+	void markDirty() { dirty = true; }
+
+	// true if obj is drawn by this pass and has to be left out of the prepass
+	bool handles(const Renderable* obj) const {
+		return params.enabled && std::find(captured.begin(), captured.end(), obj) != captured.end();
+	}
+
+	// captures the supported renderables again if they changed
+	void update(const std::vector<Renderable*>& renderables) {
+		if (!params.enabled) return;
+		std::vector<std::pair<Renderable*, GLuint>> current;
+		for (auto obj : renderables) {
+			if (!obj->supportsVisibilityBuffer()) continue;
+			if (int(current.size()) == MAX_DRAWS) break; // the rest stays in the prepass
+			current.push_back({ obj, obj->getVisibilityMaterial().geometryId });
+		}
+		if (!dirty && current == signature) return;
+		signature = current;
+		capture();
+		dirty = false;
+	}
+
+	// draws the captured geometry into the visibility buffer against the prepass depth and resolves it into the G-buffer,
+	// draws whose renderable fails isVisible are skipped
+	void run(const gBufferPrepass* prepass, const std::function<bool(Renderable*)>& isVisible = {}) {
+		if (!params.enabled || draws.empty()) return;
+		timer.begin();
+		if (prepass->getDepthTexture() != attachedDepth || prepass->getWidth() != width || prepass->getHeight() != height)
+			setupTargets(prepass);
+
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		cgra::gl_state::viewport(0, 0, width, height);
+		const GLuint nothing[4] = { 0, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 0, nothing);
+		cgra::gl_state::use_program(visibilityShader);
+		glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, glm::value_ptr(prepass->getViewProj()));
+		cgra::gl_state::bind_vertex_array(vao);
+		for (size_t i = 0; i < draws.size(); i++) {
+			if (draws[i].vertexCount == 0 || (isVisible && !isVisible(captured[i]))) continue;
+			glUniform1ui(drawIndexLocation, GLuint(i));
+			glDrawArrays(GL_TRIANGLES, draws[i].firstVertex, draws[i].vertexCount);
+		}
+		cgra::gl_state::bind_vertex_array(0);
+
+		// shade every covered pixel once, the depth is already in place
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, prepass->getFBO());
+		cgra::gl_state::disable(GL_DEPTH_TEST);
+		cgra::gl_state::use_program(resolveShader);
+		glUniformMatrix4fv(inverseViewProjLocation, 1, GL_FALSE, glm::value_ptr(prepass->getInverseViewProj()));
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, visibilityTex);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, arenaBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, drawBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, materialBuffer);
+		quad.draw();
+		cgra::gl_state::enable(GL_DEPTH_TEST);
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+		timer.end();
+	}
+
+	int getDrawCount() const { return int(draws.size()); }
+	int getTriangleCount() const { return totalVertices / 3; }
+	float getPassMs() const { return params.enabled ? timer.getSmoothedMs() : 0.0f; }
+
+private:
+	struct draw_range {
+		GLint firstVertex;
+		GLsizei vertexCount;
+	};
+	struct gpu_material { // std430, see visibility_resolve_frag.glsl
+		glm::vec4 baseSmoothness;
+		glm::vec4 weights; // texture rgb weight, texture green weight, metallic, texture slot
+	};
+
+	GLuint visibilityShader = 0;
+	GLuint resolveShader = 0;
+	GLint viewProjLocation = -1;
+	GLint drawIndexLocation = -1;
+	GLint inverseViewProjLocation = -1;
+	GLuint fbo = 0;
+	GLuint visibilityTex = 0;
+	GLuint attachedDepth = 0;
+	int width = 0, height = 0;
+	GLuint arenaBuffer = 0;   // captured vertices of every draw
+	GLuint drawBuffer = 0;    // per draw first vertex + material
+	GLuint materialBuffer = 0;
+	GLuint vao = 0;
+	GLuint primitiveQuery = 0;
+	std::vector<std::pair<Renderable*, GLuint>> signature;
+	std::vector<Renderable*> captured;
+	std::vector<draw_range> draws;
+	int totalVertices = 0;
+	bool dirty = true;
+	fullscreenQuad quad;
+	gpuTimer timer;
+
+	// the renderables draw with identity view and projection, so their geometry shaders emit world positions
+	void capture() {
+		captured.clear();
+		draws.clear();
+		std::vector<gpu_material> materials;
+		std::vector<GLuint> drawRecords;
+		for (auto& entry : signature) captured.push_back(entry.first);
+
+		cgra::gl_state::enable(GL_RASTERIZER_DISCARD);
+		frameConstants& frame = frameConstants::get();
+		frameConstants::block saved = frame.getBlock();
+		frame.setCamera(glm::mat4(1), glm::mat4(1));
+		frame.setRenderMode(1);
+
+		// count first so the arena can be sized exactly
+		std::vector<GLuint> primitiveCounts;
+		for (auto obj : captured) {
+			obj->setObjectUniforms();
+			glBeginQuery(GL_PRIMITIVES_GENERATED, primitiveQuery);
+			obj->draw();
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+			GLuint count = 0;
+			glGetQueryObjectuiv(primitiveQuery, GL_QUERY_RESULT, &count);
+			if (count > GLuint(MAX_PRIMITIVES)) {
+				std::cerr << "Warning: visibility buffer draw with " << count << " triangles truncated to " << MAX_PRIMITIVES << std::endl;
+				count = MAX_PRIMITIVES;
+			}
+			primitiveCounts.push_back(count);
+		}
+
+		totalVertices = 0;
+		for (auto count : primitiveCounts) totalVertices += int(count) * 3;
+		glBindBuffer(GL_ARRAY_BUFFER, arenaBuffer);
+		glBufferData(GL_ARRAY_BUFFER, std::max(totalVertices, 1) * FLOATS_PER_VERTEX * sizeof(float), nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		GLint first = 0;
+		for (size_t i = 0; i < captured.size(); i++) {
+			Renderable* obj = captured[i];
+			GLsizei vertexCount = GLsizei(primitiveCounts[i] * 3);
+			if (vertexCount > 0) {
+				glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, arenaBuffer,
+					GLintptr(first) * FLOATS_PER_VERTEX * sizeof(float), GLsizeiptr(vertexCount) * FLOATS_PER_VERTEX * sizeof(float));
+				// the renderable binds the same program again in draw(), which is rejected while capturing and changes nothing
+				cgra::gl_state::use_program(obj->getShader());
+				glBeginTransformFeedback(GL_TRIANGLES);
+				obj->draw();
+				glEndTransformFeedback();
+			}
+
+			VisibilityMaterial material = obj->getVisibilityMaterial();
+			draws.push_back({ first, vertexCount });
+			drawRecords.insert(drawRecords.end(), { GLuint(first), GLuint(i), 0u, 0u });
+			materials.push_back({ glm::vec4(material.baseColour, material.smoothness),
+				glm::vec4(material.textureWeight, material.greenWeight, material.metallic, float(material.colourLayer)) });
+			first += vertexCount;
+		}
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		cgra::gl_state::disable(GL_RASTERIZER_DISCARD);
+		frame.setBlock(saved);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(drawRecords.size(), 4) * sizeof(GLuint), drawRecords.empty() ? nullptr : drawRecords.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(materials.size(), 1) * sizeof(gpu_material), materials.empty() ? nullptr : materials.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void setupTargets(const gBufferPrepass* prepass) {
+		deleteTargets();
+		width = prepass->getWidth();
+		height = prepass->getHeight();
+		attachedDepth = prepass->getDepthTexture();
+
+		glGenFramebuffers(1, &fbo);
+		glGenTextures(1, &visibilityTex);
+		cgra::gl_state::bind_texture(GL_TEXTURE_2D, visibilityTex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		// shares the prepass depth, the plants are tested against the rest of the scene and write their depth into it
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibilityTex, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachedDepth, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Visibility buffer framebuffer is not complete!");
+		}
+		cgra::gl_state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void deleteTargets() {
+		cgra::gl_state::delete_framebuffers(1, &fbo);
+		cgra::gl_state::delete_textures(1, &visibilityTex);
+		fbo = 0;
+		visibilityTex = 0;
+	}
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cgra/cgra_state.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cgra/cgra_shader.hpp>
+#include "voxelizer.hpp"
+#include "gpuTimer.hpp"
+#include "uniformLocations.hpp"
+
+// Amortised multi-bounce GI. A coarse volume over the voxel grid stores a fraction of the irradiance each
+// occupied cell gathered (times its albedo), the lighting cones add it to the voxel emission. Only a slab of
+// the volume is re-gathered per frame and the gather sees the volume itself, so every pass over the volume
+// adds a bounce at a fixed per frame cost.
+class voxelBouncePass {
+public:
+	struct bounce_params {
+		bool enabled;
+		int resolution;     // cells per axis, a power of two no larger than the voxel resolution
+		int slicesPerFrame; // z slices of the bounce volume updated each frame
+		int numCones;
+		float fraction;     // share of the gathered irradiance re-injected
+	};
+	bounce_params params;
+
+	voxelBouncePass(Voxelizer* voxelizerObj) : voxelizer(voxelizerObj) {
+		cgra::shader_builder sb;
+		sb.set_shader(GL_COMPUTE_SHADER, CGRA_SRCDIR + std::string("//res//shaders//voxel_bounce_comp.glsl"));
+		shader = sb.build();
+
+		cgra::gl_state::use_program(shader);
+		glUniform1i(glGetUniformLocation(shader, "voxelTex1"), 0);
+		glUniform1i(glGetUniformLocation(shader, "voxelTex2"), 1);
+		glUniform1i(glGetUniformLocation(shader, "uBounceTex"), 2);
+		glUniform1i(glGetUniformLocation(shader, "uDirectTex"), 3);
+
+		setDefaultParams();
+		setupTexture();
+	}
+
+	~voxelBouncePass() {
+		cgra::gl_state::use_program(0);
+		if (shader != 0 && glIsProgram(shader)) {
+			cgra::shader_builder::release(shader);
+			shader = 0;
+		}
+		cgra::gl_state::delete_textures(1, &texture);
+	}
+
+	void setDefaultParams() {
+		params.enabled = false;
+		params.resolution = 64;
+		params.slicesPerFrame = 4;
+		params.numCones = 6;
+		params.fraction = 0.5;
+	}
+
+	// forget the bounces, call when the voxels change
+	void clear() {
+		cgra::gl_state::delete_textures(1, &texture);
+		setupTexture();
+		nextSlice = 0;
+	}
+
+	// re-gathers the next slab of the volume using the lighting pass' cone settings, directTex is the injected
+	// light of the shadowed primary light (0 if it is off) which the voxels don't emit themselves
+	void run(float coneAperture, float stepMultiplier, float maxSteps, float transmittanceForTermination, float diffuseBrightnessMultiplier,
+		GLuint directTex = 0, float directMipOffset = 0) {
+		if (!params.enabled) return;
+		if (getResolution() != allocatedResolution) clear();
+		timer.begin();
+
+		int resolution = allocatedResolution;
+		int slices = std::clamp(params.slicesPerFrame, 1, resolution);
+		const auto& u = uniforms.of(shader);
+		cgra::gl_state::use_program(shader);
+		glUniform1i(u[BOUNCE_RES], resolution);
+		glUniform1i(u[VOXEL_RES], voxelizer->m_params.resolution);
+		glUniform1i(u[SLICE_OFFSET], nextSlice);
+		glUniform1i(u[SLICE_COUNT], slices);
+		glUniform1f(u[MIP_LEVEL_COUNT], float(voxelizer->m_params.mipLevels));
+		glUniform1f(u[BOUNCE_MIP_OFFSET], getMipOffset());
+		glUniform1f(u[BOUNCE_FRACTION], params.fraction);
+		glUniform1f(u[DIFFUSE_BRIGHTNESS_MULTIPLIER], diffuseBrightnessMultiplier);
+		glUniform1i(u[NUM_CONES], params.numCones);
+		glUniform1f(u[CONE_APERTURE], coneAperture);
+		glUniform1f(u[STEP_MULTIPLIER], stepMultiplier);
+		glUniform1f(u[MAX_STEPS], maxSteps);
+		glUniform1f(u[TRANSMITTANCE_NEEDED_FOR_CONE_TERMINATION], transmittanceForTermination);
+		glUniform1i(u[DIRECT_ENABLED], directTex != 0);
+		glUniform1f(u[DIRECT_MIP_OFFSET], directMipOffset);
+
+		cgra::gl_state::active_texture(GL_TEXTURE0);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex1);
+		cgra::gl_state::active_texture(GL_TEXTURE1);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, voxelizer->m_voxelTex2);
+		cgra::gl_state::active_texture(GL_TEXTURE2);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, texture);
+		cgra::gl_state::active_texture(GL_TEXTURE3);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, directTex);
+		glBindImageTexture(0, texture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+		int groups = (resolution + 3) / 4;
+		glDispatchCompute(groups, groups, (slices + 3) / 4);
+		mipsStale = true;
+
+		nextSlice = (nextSlice + slices) % resolution;
+		timer.end();
+	}
+
+	// the mips of the volume, run as a pass of its own after run() so the render graph puts the barrier for the
+	// image stores in between
+	void generateMips() {
+		if (!mipsStale) return;
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, texture);
+		glGenerateMipmap(GL_TEXTURE_3D);
+		mipsStale = false;
+	}
+
+	GLuint getTexture() const { return texture; }
+	// mip of the voxel volume that matches the bounce resolution
+	float getMipOffset() const { return std::log2(float(voxelizer->m_params.resolution) / float(allocatedResolution)); }
+	float getPassMs() const { return params.enabled ? timer.getSmoothedMs() : 0.0f; }
+
+private:
+	Voxelizer* voxelizer;
+	GLuint shader = 0;
+	enum Uniform { BOUNCE_RES, VOXEL_RES, SLICE_OFFSET, SLICE_COUNT, MIP_LEVEL_COUNT, BOUNCE_MIP_OFFSET,
+		BOUNCE_FRACTION, DIFFUSE_BRIGHTNESS_MULTIPLIER, NUM_CONES, CONE_APERTURE, STEP_MULTIPLIER, MAX_STEPS,
+		TRANSMITTANCE_NEEDED_FOR_CONE_TERMINATION, DIRECT_ENABLED, DIRECT_MIP_OFFSET };
+	uniformLocations<15> uniforms{{ "uBounceRes", "uVoxelRes", "uSliceOffset", "uSliceCount", "uMipLevelCount",
+		"uBounceMipOffset", "uBounceFraction", "uDiffuseBrightnessMultiplier", "uNumCones", "uConeAperture",
+		"uStepMultiplier", "uMaxSteps", "uTransmittanceNeededForConeTermination", "uDirectEnabled",
+		"uDirectMipOffset" }};
+	GLuint texture = 0;
+	int allocatedResolution = 0;
+	int nextSlice = 0;
+	bool mipsStale = false; // gathered since the last generateMips()
+	gpuTimer timer;
+
+	int getResolution() const {
+		int resolution = 1;
+		while (resolution * 2 <= std::min(params.resolution, voxelizer->m_params.resolution)) resolution *= 2;
+		return resolution;
+	}
+
+	void setupTexture() {
+		allocatedResolution = getResolution();
+		int levels = 1 + int(std::floor(std::log2(float(allocatedResolution))));
+		glGenTextures(1, &texture);
+		cgra::gl_state::bind_texture(GL_TEXTURE_3D, texture);
+		glTexStorage3D(GL_TEXTURE_3D, levels, GL_RGBA16F, allocatedResolution, allocatedResolution, allocatedResolution);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+		// immutable storage is undefined until written, start without any bounce
+		std::vector<float> zeros(size_t(allocatedResolution) * allocatedResolution * allocatedResolution * 4, 0.0f);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, allocatedResolution, allocatedResolution, allocatedResolution, GL_RGBA, GL_FLOAT, zeros.data());
+		glGenerateMipmap(GL_TEXTURE_3D);
+	}
+};
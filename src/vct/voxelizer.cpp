@@ -1,5 +1,7 @@
 #include "voxelizer.hpp"
+#include <cgra/cgra_state.hpp>
 #include "cgra/cgra_shader.hpp"
+#include "frameConstants.hpp"
 #include <iostream>
 #include <array>
 
@@ -29,34 +31,34 @@ Voxelizer::Voxelizer(int resolution)
 }
 
 Voxelizer::~Voxelizer() {
-    glUseProgram(0);
+    cgra::gl_state::use_program(0);
 
     if (m_quadVBO != 0) {
         glDeleteBuffers(1, &m_quadVBO);
         m_quadVBO = 0;
     }
     if (m_quadVAO != 0) {
-        glDeleteVertexArrays(1, &m_quadVAO);
+        cgra::gl_state::delete_vertex_arrays(1, &m_quadVAO);
         m_quadVAO = 0;
     }
     if (m_voxelTex0 != 0) {
-        glDeleteTextures(1, &m_voxelTex0);
+        cgra::gl_state::delete_textures(1, &m_voxelTex0);
         m_voxelTex0 = 0;
     }
     if (m_voxelTex1 != 0) {
-        glDeleteTextures(1, &m_voxelTex1);
+        cgra::gl_state::delete_textures(1, &m_voxelTex1);
         m_voxelTex1 = 0;
     }
     if (m_voxelTex2 != 0) {
-        glDeleteTextures(1, &m_voxelTex2);
+        cgra::gl_state::delete_textures(1, &m_voxelTex2);
         m_voxelTex2 = 0;
     }
     if (m_voxelShader != 0 && glIsProgram(m_voxelShader)) {
-        glDeleteProgram(m_voxelShader);
+        cgra::shader_builder::release(m_voxelShader);
         m_voxelShader = 0;
     }
     if (m_debugShader != 0 && glIsProgram(m_debugShader)) {
-        glDeleteProgram(m_debugShader);
+        cgra::shader_builder::release(m_debugShader);
         m_debugShader = 0;
     }
     m_initialized = false;
@@ -65,7 +67,7 @@ Voxelizer::~Voxelizer() {
 void Voxelizer::initializeTextures() {
     auto make3DTex = [&](GLuint& tex) {
         glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_3D, tex);
+        cgra::gl_state::bind_texture(GL_TEXTURE_3D, tex);
         int mipLevels = static_cast<int>(std::floor(std::log2(m_params.resolution))) + 1;
         m_params.mipLevels = mipLevels;
 
@@ -85,7 +87,7 @@ void Voxelizer::initializeTextures() {
         glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
         glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
 
-        glBindTexture(GL_TEXTURE_3D, 0);
+        cgra::gl_state::bind_texture(GL_TEXTURE_3D, 0);
         };
 
     make3DTex(m_voxelTex0);
@@ -93,7 +95,7 @@ void Voxelizer::initializeTextures() {
     make3DTex(m_voxelTex2);
 
     // bind sampler uniforms to texture units
-    glUseProgram(m_debugShader);
+    cgra::gl_state::use_program(m_debugShader);
     glUniform1i(glGetUniformLocation(m_debugShader, "voxelTex0"), 4);
     glUniform1i(glGetUniformLocation(m_debugShader, "voxelTex1"), 5);
     glUniform1i(glGetUniformLocation(m_debugShader, "voxelTex2"), 6);
@@ -121,7 +123,7 @@ void Voxelizer::initializeQuad() {
     glGenVertexArrays(1, &m_quadVAO);
     glGenBuffers(1, &m_quadVBO);
 
-    glBindVertexArray(m_quadVAO);
+    cgra::gl_state::bind_vertex_array(m_quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
@@ -131,28 +133,28 @@ void Voxelizer::initializeQuad() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    glBindVertexArray(0);
+    cgra::gl_state::bind_vertex_array(0);
 }
 
-void Voxelizer::voxelize(std::function<void()> drawMainGeometry, std::vector<glm::mat4> modelTransforms, std::vector<GLuint> shaders) {
+void Voxelizer::voxelize(std::function<void()> drawMainGeometry) {
     if (!m_initialized) {
         std::cerr << "Voxelizer not properly initialized!" << std::endl;
         return;
     } 
 
     if(m_params.conservativeRaster)
-        glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
+        cgra::gl_state::enable(GL_CONSERVATIVE_RASTERIZATION_NV);
 
     clearVoxelTexture();
 
     // Store current viewport
     GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    cgra::gl_state::get_viewport(viewport);
     m_currentViewportWidth = viewport[2];
     m_currentViewportHeight = viewport[3];
 
     setupVoxelizationState();
-    performVoxelization(drawMainGeometry, modelTransforms, shaders);
+    performVoxelization(drawMainGeometry);
     restoreRenderingState(m_currentViewportWidth, m_currentViewportHeight);
 
     // Memory barrier to ensure writes are complete
@@ -164,11 +166,11 @@ void Voxelizer::voxelize(std::function<void()> drawMainGeometry, std::vector<glm
         std::cerr << "OpenGL error after voxelization: " << error << std::endl;
     }
 
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex0);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex0);
     glGenerateMipmap(GL_TEXTURE_3D);
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex1);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex1);
     glGenerateMipmap(GL_TEXTURE_3D);
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex2);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex2);
     glGenerateMipmap(GL_TEXTURE_3D);
 
 }
@@ -183,7 +185,7 @@ void Voxelizer::clearVoxelTexture() {
 void Voxelizer::setupVoxelizationState() {
 
     // Use higher resolution viewport for better fragment coverage
-    glViewport(0, 0, m_params.voxelizeRes, m_params.voxelizeRes);
+    cgra::gl_state::viewport(0, 0, m_params.voxelizeRes, m_params.voxelizeRes);
 
     // Bind voxel texture for writing
     glBindImageTexture(0, m_voxelTex0, 0, GL_TRUE, 0, GL_WRITE_ONLY, VOXEL_IMAGE_TYPE);
@@ -192,22 +194,29 @@ void Voxelizer::setupVoxelizationState() {
 
     // Disable framebuffer rendering since we're writing directly to 3D texture
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    cgra::gl_state::disable(GL_DEPTH_TEST);
+    cgra::gl_state::disable(GL_CULL_FACE);
 }
 
 void Voxelizer::restoreRenderingState(int width, int height) {
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glViewport(0, 0, width, height);
-    glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
+    cgra::gl_state::enable(GL_DEPTH_TEST);
+    cgra::gl_state::enable(GL_CULL_FACE);
+    cgra::gl_state::viewport(0, 0, width, height);
+    cgra::gl_state::disable(GL_CONSERVATIVE_RASTERIZATION_NV);
 }
 
-void Voxelizer::performVoxelization(std::function<void()> drawMainGeometry, std::vector<glm::mat4> modelTransforms, std::vector<GLuint> usingShaders) {
+void Voxelizer::performVoxelization(std::function<void()> drawMainGeometry) {
     mat4 orthoProj = createOrthographicProjection();
     auto views = createOrthographicViews();
 
+    // the programs read the voxel parameters and the views from the frame constants, the camera of the frame is
+    // put back afterwards
+    frameConstants& frame = frameConstants::get();
+    frameConstants::block saved = frame.getBlock();
+    frame.setVoxels(m_params.center, m_params.worldSize, m_params.resolution, m_params.voxelSplatRadius);
+    frame.setRenderMode(0);
+
     const int numSamples = 4;
     const float jitterAmount = 0.5f / float(m_params.resolution);
 
@@ -216,36 +225,13 @@ void Voxelizer::performVoxelization(std::function<void()> drawMainGeometry, std:
         float jitterY = ((sample / 2) - 0.5f) * jitterAmount;
         mat4 jitterProj = translate(mat4(1.0f), vec3(jitterX, jitterY, 0.0f)) * orthoProj;
 
-        for (int i = 0; i < usingShaders.size(); i++) {
-            auto shader = usingShaders[i];
-            auto modelTransform = modelTransforms[i];
-
-            glUseProgram(shader);
-            glUniform3fv(glGetUniformLocation(shader, "uVoxelCenter"), 1, value_ptr(m_params.center));
-            glUniformMatrix4fv(glGetUniformLocation(shader, "uModelMatrix"), 1, GL_FALSE, value_ptr(modelTransform));
-            glUniformMatrix4fv(glGetUniformLocation(shader, "uProjectionMatrix"), 1, GL_FALSE, value_ptr(jitterProj));
-            glUniform1i(glGetUniformLocation(shader, "uVoxelRes"), m_params.resolution);
-            glUniform1f(glGetUniformLocation(shader, "uVoxelWorldSize"), m_params.worldSize);
-            glUniform1i(glGetUniformLocation(shader, "uRenderMode"), 0);
-            glUniform1i(glGetUniformLocation(shader, "uVoxelSplatRadius"), m_params.voxelSplatRadius);
-
-        }
-
         // Now loop through 6 views instead of 3
         for (int i = 0; i < 6; ++i) {
-            for (int ii = 0; ii < usingShaders.size(); ii++) {
-                auto shader = usingShaders[ii];
-                auto modelTransform = modelTransforms[ii];
-                glm::mat4 modelView = views[i] * modelTransform;
-
-                glUseProgram(shader);
-                glUniformMatrix4fv(glGetUniformLocation(shader, "uModelViewMatrix"), 1, GL_FALSE, value_ptr(views[i]));
-                glUniformMatrix4fv(glGetUniformLocation(shader, "uViewMatrix"), 1, GL_FALSE, value_ptr(modelView));
-            }
-
+            frame.setCamera(views[i], jitterProj);
             drawMainGeometry();
         }
     }
+    frame.setBlock(saved);
 }
 mat4 Voxelizer::createOrthographicProjection() const {
     float halfSize = m_params.worldSize / 2.0f;
@@ -281,23 +267,23 @@ void Voxelizer::renderDebugSlice(float sliceValue, int debugMode) {
         return;
     }
 
-    glUseProgram(m_debugShader);
+    cgra::gl_state::use_program(m_debugShader);
     glUniform1i(glGetUniformLocation(m_debugShader, "uVoxelRes"), m_params.resolution);
     glUniform1f(glGetUniformLocation(m_debugShader, "uVoxelWorldSize"), m_params.worldSize);
     glUniform1i(glGetUniformLocation(m_debugShader, "uDebugIndex"), debugMode);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex0);
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex1);
-    glActiveTexture(GL_TEXTURE6);
-    glBindTexture(GL_TEXTURE_3D, m_voxelTex2);
+    cgra::gl_state::active_texture(GL_TEXTURE4);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex0);
+    cgra::gl_state::active_texture(GL_TEXTURE5);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex1);
+    cgra::gl_state::active_texture(GL_TEXTURE6);
+    cgra::gl_state::bind_texture(GL_TEXTURE_3D, m_voxelTex2);
 
 
     glUniform1f(glGetUniformLocation(m_debugShader, "uSlice"), sliceValue);
 
-    glBindVertexArray(m_quadVAO);
+    cgra::gl_state::bind_vertex_array(m_quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    cgra::gl_state::bind_vertex_array(0);
 
     restoreRenderingState(m_currentViewportWidth, m_currentViewportHeight);
 }
@@ -306,9 +292,9 @@ void Voxelizer::setResolution(int resolution) {
     if (resolution != m_params.resolution) {
         m_params.resolution = resolution;
         // Recreate texture with new resolution
-        glDeleteTextures(1, &m_voxelTex0);
-        glDeleteTextures(1, &m_voxelTex1);
-        glDeleteTextures(1, &m_voxelTex2);
+        cgra::gl_state::delete_textures(1, &m_voxelTex0);
+        cgra::gl_state::delete_textures(1, &m_voxelTex1);
+        cgra::gl_state::delete_textures(1, &m_voxelTex2);
         initializeTextures();
     }
 }
@@ -10,7 +10,7 @@
 class Voxelizer {
 public:
     struct VoxelParams {
-        int resolution = 512;
+        int resolution = 256;
         float worldSize = 30.0f;
         glm::vec3 center = glm::vec3(0.0f);
         int mipLevels = 0;
@@ -19,11 +19,12 @@ public:
         int voxelSplatRadius = 1;
     };
 
-    Voxelizer(int resolution = 512);
+    Voxelizer(int resolution = 256);
     ~Voxelizer();
 
     // Main interface 
-    void voxelize(std::function<void()> drawMainGeometry, std::vector<glm::mat4> modelTransforms, std::vector<GLuint> shaders);
+    // drawMainGeometry draws every renderable with its object uniforms, the views come from the frame constants
+    void voxelize(std::function<void()> drawMainGeometry);
     void renderDebugSlice(float sliceValue, int debugMode = 0);
     void clearVoxelTexture(); 
 
@@ -45,7 +46,7 @@ private:
     // Voxelization steps
     void setupVoxelizationState();
     void restoreRenderingState(int width, int height);
-    void performVoxelization(std::function<void()> drawMainGeometry, std::vector<glm::mat4> modelTransforms, std::vector<GLuint> usingShaders);
+    void performVoxelization(std::function<void()> drawMainGeometry);
 
     // Helper methods
     glm::mat4 createOrthographicProjection() const;